@@ -0,0 +1,46 @@
+#version 330 core
+
+struct Light {
+  int type; // 0: Global, 1: Point
+  vec3 position;
+  float intensity;
+  vec3 color;
+  float falloff;
+  float volumetric_intensity;
+};
+
+const int MAX_LIGHTS = 64;
+in vec2 TexCoord;
+// Summed over batches of lights by additive blending
+layout (location = 0) out vec4 Diffuse;
+layout (location = 1) out vec4 Volumetric;
+uniform sampler2D normal_buffer;
+uniform int light_count;
+uniform Light lights[MAX_LIGHTS];
+
+// The static part of deferred_fragment.glsl's lighting, without the albedo:
+// the deferred pass adds albedo * Diffuse + Volumetric.
+void main() {
+  vec3 normal = texture(normal_buffer, TexCoord).rgb * 2.0 - 1.0;
+  normal = normalize(normal);
+  vec3 diffuse = vec3(0.0);
+  vec3 volumetric_total = vec3(0.0);
+  for (int i = 0; i < light_count && i < MAX_LIGHTS; i++) {
+    if (lights[i].type == 0) {
+      diffuse += lights[i].color * lights[i].intensity;
+    }
+    else if (lights[i].type == 1) {
+      vec2 light_offset = lights[i].position.xy - TexCoord;
+      vec3 light_dir = normalize(vec3(light_offset, lights[i].position.z));
+      float distance = length(light_offset);
+      float attenuation = lights[i].intensity / (1.0 + lights[i].falloff * distance * distance);
+      attenuation = max(attenuation, 0.0);
+      float diff = max(dot(normal, light_dir), 0.0);
+      diffuse += lights[i].color * diff * attenuation;
+      float volumetric = lights[i].volumetric_intensity / (1.0 + distance * distance);
+      volumetric_total += lights[i].color * volumetric * attenuation;
+    }
+  }
+  Diffuse = vec4(diffuse, 1.0);
+  Volumetric = vec4(volumetric_total, 1.0);
+}
@@ -16,11 +16,33 @@ uniform sampler2D color_buffer;
 uniform sampler2D normal_buffer;
 uniform int light_count;
 uniform Light lights[MAX_LIGHTS];
+// Light from static lights, see bake_fragment.glsl
+uniform sampler2D baked_diffuse;
+uniform sampler2D baked_volumetric;
+// One row per light: distance to the nearest occluder in each direction
+uniform sampler2D shadow_atlas;
+const float PI = 3.14159265;
 
 vec3 CalculateGlobalLight(Light light, vec3 albedo) {
   return albedo * light.color * light.intensity;
 }
 
+// 1.0 where light i reaches `offset` (from the light) unblocked. Neighbouring
+// directions are averaged, more of them further out, for a soft penumbra.
+float ShadowFactor(int i, vec2 offset) {
+  float resolution = float(textureSize(shadow_atlas, 0).x);
+  float u = (atan(offset.y, offset.x) + PI) / (2.0 * PI);
+  float v = (float(i) + 0.5) / float(MAX_LIGHTS);
+  float distance = length(offset);
+  float spread = (1.0 + distance * 8.0) / resolution;
+  float lit = 0.0;
+  for (int tap = -2; tap <= 2; tap++) {
+    float occluder = texture(shadow_atlas, vec2(u + float(tap) * spread, v)).r;
+    lit += step(distance, occluder);
+  }
+  return lit / 5.0;
+}
+
 void main() {
   vec4 sample = texture(color_buffer, TexCoord);
   if (sample.a == 0.0) {
@@ -29,17 +51,20 @@ void main() {
   vec3 albedo = sample.rgb;
   vec3 normal = texture(normal_buffer, TexCoord).rgb * 2.0 - 1.0;
   normal = normalize(normal);
-  vec3 total_lighting = vec3(0.0);
+  vec3 total_lighting = albedo * texture(baked_diffuse, TexCoord).rgb +
+                        texture(baked_volumetric, TexCoord).rgb;
   for (int i = 0; i < light_count && i < MAX_LIGHTS; i++) {
     if (lights[i].type == 0) {
       total_lighting += CalculateGlobalLight(lights[i], albedo);
     }
     else if (lights[i].type == 1) {
       vec2 light_offset = lights[i].position.xy - TexCoord;
+      float shadow = ShadowFactor(i, -light_offset);
       vec3 light_dir = normalize(vec3(light_offset, lights[i].position.z));
       float distance = length(light_offset);
       float attenuation = lights[i].intensity / (1.0 + lights[i].falloff * distance * distance);
       attenuation = max(attenuation, 0.0);
+      attenuation *= shadow;
       float diff = max(dot(normal, light_dir), 0.0);
       total_lighting += albedo * lights[i].color * diff * attenuation;
       float volumetric = lights[i].volumetric_intensity / (1.0 + distance * distance);
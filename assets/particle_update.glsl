@@ -0,0 +1,48 @@
+#version 330 core
+// One particle per vertex, written back by transform feedback
+layout (location = 0) in vec2 aPosition;
+layout (location = 1) in vec2 aVelocity;
+layout (location = 2) in float aAge;
+layout (location = 3) in float aGeneration;
+
+out vec2 Position;
+out vec2 Velocity;
+out float Age;
+out float Generation;
+
+uniform float delta;
+uniform vec2 origin;
+uniform float direction;
+uniform float spread;
+uniform float speed;
+uniform vec2 gravity;
+uniform float lifetime;
+
+// Uniform in [0, 1) from a seed
+float Random(uint seed) {
+  seed ^= seed >> 16u;
+  seed *= 0x7FEB352Du;
+  seed ^= seed >> 15u;
+  seed *= 0x846CA68Bu;
+  seed ^= seed >> 16u;
+  return float(seed >> 8u) / 16777216.0;
+}
+
+void main() {
+  float age = aAge + delta;
+  Position = aPosition + aVelocity * delta;
+  Velocity = aVelocity + gravity * delta;
+  Generation = aGeneration;
+  // Particles start unborn (negative age) and are reborn when they expire,
+  // keeping their place in the cycle so emission stays even
+  if ((aAge < 0.0 && age >= 0.0) || age >= lifetime) {
+    age = mod(age, lifetime);
+    Generation += 1.0;
+    uint seed = uint(gl_VertexID) * 0x9E3779B9u + uint(Generation);
+    float angle = direction + (Random(seed) - 0.5) * spread;
+    float particle_speed = speed * (0.5 + 0.5 * Random(seed ^ 0x68E31DA4u));
+    Velocity = vec2(-sin(angle), cos(angle)) * particle_speed;
+    Position = origin + Velocity * age;
+  }
+  Age = age;
+}
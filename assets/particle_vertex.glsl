@@ -0,0 +1,23 @@
+#version 330 core
+// The sprite quad, instanced once per particle
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec2 aPosition;
+layout (location = 3) in float aAge;
+
+out vec2 TexCoord;
+
+layout (std140) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+uniform float size;
+uniform float layer;
+
+void main() {
+  // Unborn particles collapse to a point, which draws nothing
+  float scale = aAge >= 0.0 ? size : 0.0;
+  gl_Position = projection * view *
+                vec4(aPosition + aPos.xy * scale, layer, 1.0);
+  TexCoord = aTexCoord;
+}
@@ -2,6 +2,29 @@
 out vec4 FragColor;
 in vec2 TexCoord;
 uniform sampler2D sprite;
+// The sprite's color texture, whose alpha says where the sprite is
+uniform sampler2D mask;
+// The same two from the texture atlas, on page atlas_layer; below 0, the
+// sprite's own textures are used instead
+uniform sampler2DArray atlas;
+uniform sampler2DArray atlas_mask;
+uniform int atlas_layer;
+// Opaque sprites are cut out below one half, transparent ones where empty
+uniform float alpha_cutoff;
+// Overdraw view: every fragment adds a fixed step instead
+uniform bool overdraw;
 void main() {
-  FragColor = texture(sprite, TexCoord);
+  vec3 page = vec3(TexCoord, float(atlas_layer));
+  float alpha = atlas_layer < 0 ? texture(mask, TexCoord).a
+                                : texture(atlas_mask, page).a;
+  if (alpha < alpha_cutoff) {
+    discard;
+  }
+  if (overdraw) {
+    FragColor = vec4(vec3(0.125), 1.0);
+    return;
+  }
+  vec3 color = atlas_layer < 0 ? texture(sprite, TexCoord).rgb
+                               : texture(atlas, page).rgb;
+  FragColor = vec4(color, alpha);
 }
@@ -1,6 +1,13 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
+// Per sprite, from a constant attribute, or per vertex in static batches:
+// the sprite sheet's columns, rows, frame count and frame rate
+layout (location = 2) in vec4 aAnimation;
+// Its AnimationMode and start time
+layout (location = 3) in vec2 aAnimationTiming;
+// Where the sprite's textures are in the atlas (offset, scale), or (0, 0, 1, 1)
+layout (location = 4) in vec4 aAtlasRect;
 
 out vec2 TexCoord;
 
@@ -9,8 +16,35 @@ layout (std140) uniform Matrices {
     mat4 view;
 };
 uniform mat4 model;
+// Seconds on the renderer's clock
+uniform float time;
+
+// The texture coordinates of the frame showing at `time`, as AnimationFrame
+// in render_proxy.cc computes them
+vec2 Frame(vec2 coordinates) {
+  vec2 grid = aAnimation.xy;
+  float frames = aAnimation.z;
+  float rate = aAnimation.w;
+  float step = rate > 0.0 ? floor(max(time - aAnimationTiming.y, 0.0) * rate)
+                          : 0.0;
+  float period = 2.0 * frames - 2.0;
+  float frame;
+  if (aAnimationTiming.x == 1.0) {
+    frame = min(step, frames - 1.0);
+  } else if (aAnimationTiming.x == 2.0 && period > 0.0) {
+    frame = step - period * floor(step / period);
+    if (frame >= frames) {
+      frame = period - frame;
+    }
+  } else {
+    frame = step - frames * floor(step / frames);
+  }
+  float column = frame - grid.x * floor(frame / grid.x);
+  float row = floor(frame / grid.x);
+  return (vec2(column, row) + coordinates) / grid;
+}
 
 void main() {
   gl_Position = projection * view * model * vec4(aPos, 1.0);
-  TexCoord = aTexCoord;
+  TexCoord = aAtlasRect.xy + Frame(aTexCoord) * aAtlasRect.zw;
 }
@@ -0,0 +1,324 @@
+// Microbenchmarks for the object, scene and template hot paths, run on
+// generated scenes (see scene_generator.h). Textures are not uploaded (no GL
+// context), so load times are parsing and object construction only.
+//
+//   vibrant_bench [--objects 10000,100000] [--runs 5] [--filter text]
+//                 [--json results.json]
+//
+// Each sample repeats its benchmark until it takes at least 10 ms; results
+// are reported per repetition, and per item (object, light or template).
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <numeric>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "light_lod.h"
+#include "object.h"
+#include "object_filter.h"
+#include "render_proxy.h"
+#include "scene.h"
+#include "scene_generator.h"
+#include "scene_watcher.h"
+#include "transform.h"
+
+namespace {
+constexpr auto kMinSampleTime = std::chrono::milliseconds(10);
+constexpr std::size_t kMaxRepeat = std::size_t{1} << 20;
+constexpr std::size_t kTemplateCount = 256;
+
+struct Options {
+  std::vector<std::size_t> object_counts = {10'000, 100'000};
+  std::size_t runs = 5;
+  std::string filter;
+  std::string json_path;
+};
+
+struct Result {
+  std::string name;
+  std::size_t objects;
+  std::size_t items;
+  std::size_t repeat;
+  std::vector<double> samples_ns;  // Per repetition, sorted
+
+  double Median() const { return samples_ns[samples_ns.size() / 2]; }
+  double Mean() const {
+    return std::accumulate(samples_ns.begin(), samples_ns.end(), 0.0) /
+           static_cast<double>(samples_ns.size());
+  }
+};
+
+// Written to by every benchmark so the measured work cannot be optimized away
+volatile float sink;
+
+double TimeNs(const std::function<void()>& body, std::size_t repeat) {
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < repeat; i++) {
+    body();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+class Runner {
+ public:
+  explicit Runner(const Options& options) : options_(options) {}
+
+  bool Selected(std::string_view name) const {
+    return options_.filter.empty() || name.contains(options_.filter);
+  }
+
+  void Run(std::string_view name, std::size_t objects, std::size_t items,
+           const std::function<void()>& body) {
+    if (!Selected(name)) {
+      return;
+    }
+    // The calibration runs double as warm-up
+    std::size_t repeat = 1;
+    while (TimeNs(body, repeat) <
+               std::chrono::duration<double, std::nano>(kMinSampleTime)
+                   .count() &&
+           repeat < kMaxRepeat) {
+      repeat *= 2;
+    }
+    Result result{.name = std::string(name),
+                  .objects = objects,
+                  .items = std::max<std::size_t>(items, 1),
+                  .repeat = repeat,
+                  .samples_ns = {}};
+    for (std::size_t run = 0; run < options_.runs; run++) {
+      result.samples_ns.push_back(TimeNs(body, repeat) /
+                                  static_cast<double>(repeat));
+    }
+    std::ranges::sort(result.samples_ns);
+    std::print("{:<32} {:>9} {:>14.0f} {:>12.2f}\n", result.name,
+               result.objects, result.Median(),
+               result.Median() / static_cast<double>(result.items));
+    results_.push_back(std::move(result));
+  }
+
+  void WriteJson(std::string_view path) const {
+    std::ofstream file{std::string(path)};
+    if (!file.is_open()) {
+      throw std::runtime_error("Failed to open file: " + std::string(path));
+    }
+    file << "{\n  \"context\": {\"runs\": " << options_.runs
+         << ", \"threads\": " << std::thread::hardware_concurrency()
+         << "},\n  \"benchmarks\": [";
+    for (std::size_t i = 0; i < results_.size(); i++) {
+      const auto& result = results_[i];
+      file << (i == 0 ? "\n" : ",\n")
+           << std::format(
+                  "    {{\"name\": \"{}\", \"objects\": {}, \"items\": {}, "
+                  "\"repeat\": {}, \"min_ns\": {:.1f}, \"median_ns\": {:.1f}, "
+                  "\"mean_ns\": {:.1f}, \"median_ns_per_item\": {:.3f}}}",
+                  result.name, result.objects, result.items, result.repeat,
+                  result.samples_ns.front(), result.Median(), result.Mean(),
+                  result.Median() / static_cast<double>(result.items));
+    }
+    file << "\n  ]\n}\n";
+  }
+
+ private:
+  const Options& options_;
+  std::vector<Result> results_;
+};
+
+std::vector<std::size_t> ParseCounts(std::string_view text) {
+  std::vector<std::size_t> counts;
+  while (!text.empty()) {
+    auto comma = text.find(',');
+    counts.push_back(std::stoull(std::string(text.substr(0, comma))));
+    text = comma == std::string_view::npos ? "" : text.substr(comma + 1);
+  }
+  return counts;
+}
+
+Options ParseOptions(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (i + 1 >= argc) {
+      throw std::runtime_error("Missing value for " + std::string(arg));
+    }
+    std::string_view value = argv[++i];
+    if (arg == "--objects") {
+      options.object_counts = ParseCounts(value);
+    } else if (arg == "--runs") {
+      options.runs = std::max<std::size_t>(std::stoull(std::string(value)), 1);
+    } else if (arg == "--filter") {
+      options.filter = value;
+    } else if (arg == "--json") {
+      options.json_path = value;
+    } else {
+      throw std::runtime_error("Unknown option: " + std::string(arg));
+    }
+  }
+  return options;
+}
+
+void ObjectBenchmarks(Runner& runner, Scene& scene) {
+  auto objects = scene.objects.size();
+  auto lights = static_cast<std::size_t>(std::ranges::count_if(
+      scene.objects, [](const auto& object) { return object->HasTag("light"); }));
+  std::size_t sprites = objects - lights;
+
+  runner.Run("object.has_tag", objects, objects, [&] {
+    std::size_t count = 0;
+    for (const auto& object : scene.objects) {
+      count += object->HasTag("sprite") ? 1 : 0;
+    }
+    sink = static_cast<float>(count);
+  });
+  // The lookups the sprite and light passes make every frame
+  runner.Run("object.get_attribute.transform", objects, objects, [&] {
+    float sum = 0.0F;
+    for (const auto& object : scene.objects) {
+      sum += std::get<glm::vec3>(object->GetAttribute("transform.position")).x;
+      sum += std::get<glm::vec3>(object->GetAttribute("transform.scale")).x;
+      sum += std::get<float>(object->GetAttribute("transform.rotation"));
+    }
+    sink = sum;
+  });
+  runner.Run("object.get_attribute.light", objects, lights, [&] {
+    float sum = 0.0F;
+    for (const auto& object : scene.objects) {
+      if (!object->HasTag("light")) {
+        continue;
+      }
+      sum += static_cast<float>(std::get<int>(object->GetAttribute("light.type")));
+      sum += std::get<float>(object->GetAttribute("light.intensity"));
+      sum += std::get<glm::vec3>(object->GetAttribute("light.color")).x;
+      sum += std::get<float>(object->GetAttribute("light.radial_falloff"));
+      sum += std::get<float>(
+          object->GetAttribute("light.volumetric_intensity"));
+    }
+    sink = sum;
+  });
+  runner.Run("transform.build", objects, sprites, [&] {
+    float sum = 0.0F;
+    for (const auto& object : scene.objects) {
+      if (!object->HasTag("sprite")) {
+        continue;
+      }
+      auto model = ModelMatrix(
+          {std::get<glm::vec3>(object->GetAttribute("transform.position")),
+           std::get<glm::vec3>(object->GetAttribute("transform.scale")),
+           std::get<float>(object->GetAttribute("transform.rotation"))});
+      sum += model[3][0];
+    }
+    sink = sum;
+  });
+  // A new query in the Edit window's filter box
+  runner.Run("object_filter.matches", objects, objects, [&] {
+    ObjectFilter filter;
+    filter.SetQuery("LIGHT");
+    sink = static_cast<float>(filter.Matches(scene).size());
+  });
+  runner.Run("render_proxies.build", objects, objects, [&] {
+    RenderProxies proxies;
+    proxies.Sync(scene);
+    sink = static_cast<float>(proxies.Sprites().size());
+  });
+  // A frame in which nothing changed
+  RenderProxies proxies;
+  proxies.Sync(scene);
+  runner.Run("render_proxies.sync", objects, objects, [&] {
+    proxies.Sync(scene);
+    sink = static_cast<float>(proxies.Sprites().size());
+  });
+  // Merging the lights down to what the shader takes, every frame
+  LightLod light_lod;
+  runner.Run("light_lod.reduce", objects, lights, [&] {
+    sink = static_cast<float>(light_lod.Reduce(proxies.Lights()).size());
+  });
+}
+
+void SceneBenchmarks(Runner& runner, const Scene& scene,
+                     const std::filesystem::path& directory) {
+  auto objects = scene.objects.size();
+  for (std::string_view extension : {".xml", ".vbscene"}) {
+    auto kind = extension.substr(1);
+    auto path =
+        (directory / std::format("scene_{}{}", objects, extension)).string();
+    runner.Run(std::format("scene.save.{}", kind), objects, objects,
+               [&] { SaveScene(scene, path); });
+    auto load = std::format("scene.load.{}", kind);
+    if (runner.Selected(load) && !std::filesystem::exists(path)) {
+      SaveScene(scene, path);
+    }
+    runner.Run(load, objects, objects, [&] {
+      sink = static_cast<float>(LoadScene(path, false).objects.size());
+    });
+  }
+  // A reloaded file with one value edited, as after a tool's save
+  if (runner.Selected("scene.reload.diff") && objects != 0) {
+    auto file = GenerateScene(objects);
+    std::get<glm::vec3>(file.objects[objects / 2]->attributes.front().second)
+        .x += 1.0F;
+    runner.Run("scene.reload.diff", objects, objects, [&] {
+      sink = static_cast<float>(DiffScenes(scene, file).changed.size());
+    });
+  }
+}
+
+// Templates shaped like the generated sprites and lights.
+void TemplateBenchmarks(Runner& runner,
+                        const std::filesystem::path& directory) {
+  if (!runner.Selected("templates.load")) {
+    return;
+  }
+  auto scene = GenerateScene(kTemplateCount);
+  std::vector<AttributeTemplate> templates;
+  for (const auto& object : scene.objects) {
+    templates.push_back({.name = object->name, .attributes = object->attributes});
+  }
+  auto path = (directory / "attributes.xml").string();
+  attributes::SaveTemplates(templates, path);
+  runner.Run("templates.load", 0, kTemplateCount, [&] {
+    sink = static_cast<float>(attributes::LoadTemplates(path).size());
+  });
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  try {
+    options = ParseOptions(argc, argv);
+  } catch (const std::exception& e) {
+    std::print(stderr, "{}\n", e.what());
+    return EXIT_FAILURE;
+  }
+  auto directory = std::filesystem::temp_directory_path() / "vibrant_bench";
+  std::filesystem::create_directories(directory);
+
+  Runner runner(options);
+  std::print("{:<32} {:>9} {:>14} {:>12}\n", "benchmark", "objects",
+             "median (ns)", "ns / item");
+  try {
+    for (auto object_count : options.object_counts) {
+      auto scene = GenerateScene(object_count);
+      ObjectBenchmarks(runner, scene);
+      SceneBenchmarks(runner, scene, directory);
+    }
+    TemplateBenchmarks(runner, directory);
+    if (!options.json_path.empty()) {
+      runner.WriteJson(options.json_path);
+    }
+  } catch (const std::exception& e) {
+    std::print(stderr, "Benchmark failed: {}\n", e.what());
+    std::filesystem::remove_all(directory);
+    return EXIT_FAILURE;
+  }
+  std::filesystem::remove_all(directory);
+  return EXIT_SUCCESS;
+}
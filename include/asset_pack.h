@@ -0,0 +1,122 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "mapped_file.h"
+
+// On-disk layout of an asset pack (.vbpack), every file an installation reads
+// at startup in one file that is mapped once:
+//
+//   Header | EntryRecord[entry_count] | path data | entry data
+//
+// Entries are sorted by path (relative, '/'-separated, as loose files are
+// opened) and their data is 16-byte aligned. An entry is stored as is, or as
+// a single LZ4 block when that makes it smaller.
+namespace asset_pack {
+constexpr std::array<char, 4> kMagic = {'V', 'B', 'A', 'P'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::size_t kAlignment = 16;
+// Where the editor looks for its pack, next to the loose assets it replaces
+constexpr std::string_view kDefaultPath = "assets.vbpack";
+
+enum class Compression : std::uint32_t { kNone, kLz4 };
+
+struct Header {
+  std::array<char, 4> magic;
+  std::uint32_t version;
+  std::uint32_t entry_count;
+  std::uint32_t path_data_size;
+  std::uint64_t entries_offset;
+  std::uint64_t path_data_offset;
+};
+
+struct EntryRecord {
+  std::uint64_t offset;
+  std::uint64_t stored_size;
+  std::uint64_t size;  // Once decompressed
+  std::uint32_t path_offset;  // Into the path data
+  std::uint32_t path_length;
+  Compression compression;
+  std::uint32_t reserved;
+};
+
+static_assert(std::endian::native == std::endian::little,
+              "The asset pack format is little-endian");
+static_assert(std::is_trivially_copyable_v<Header> &&
+              std::is_trivially_copyable_v<EntryRecord>);
+static_assert(sizeof(EntryRecord) == 40);
+}  // namespace asset_pack
+
+// The LZ4 block format, without the frame around it. Decompress fills
+// `target`, which must be the decompressed size, and throws
+// std::runtime_error if `source` is not a valid block of that size.
+std::vector<std::byte> Lz4Compress(std::span<const std::byte> source);
+void Lz4Decompress(std::span<const std::byte> source, std::span<std::byte> target);
+
+class AssetPack {
+ public:
+  // Throws std::runtime_error if the file is not a valid pack.
+  explicit AssetPack(std::string_view path);
+
+  // The entry stored under `path` (see AssetPath), or null.
+  const asset_pack::EntryRecord* Find(std::string_view path) const;
+  std::span<const asset_pack::EntryRecord> Entries() const { return entries_; }
+  std::string_view Path(const asset_pack::EntryRecord& entry) const;
+  // The entry's bytes as stored, compressed or not
+  std::span<const std::byte> Stored(const asset_pack::EntryRecord& entry) const;
+
+ private:
+  MappedFile file_;
+  std::span<const asset_pack::EntryRecord> entries_;
+  std::string_view path_data_;
+};
+
+// Writes the files at `paths` into a pack at `output`, compressing entries
+// that shrink when `compress` is set. Throws std::runtime_error on failure.
+void SaveAssetPack(std::string_view output, std::span<const std::string> paths,
+                   bool compress);
+
+// The name an asset is stored under: `path` made relative-normal with '/'.
+std::string AssetPath(std::string_view path);
+
+// The contents of an asset, from the mounted pack (without copying unless the
+// entry is compressed) or mapped from the loose file.
+class Asset {
+ public:
+  const std::byte* Data() const { return bytes_.data(); }
+  std::size_t Size() const { return bytes_.size(); }
+  std::span<const std::byte> Bytes() const { return bytes_; }
+  std::string_view Text() const {
+    return {reinterpret_cast<const char*>(bytes_.data()), bytes_.size()};
+  }
+
+ private:
+  friend std::optional<Asset> FindAsset(std::string_view path,
+                                        bool prefer_loose);
+
+  std::span<const std::byte> bytes_;
+  std::unique_ptr<MappedFile> file_;
+  std::vector<std::byte> decompressed_;
+};
+
+// Serves assets from the pack at `path` from now on; call before any are read.
+// Throws std::runtime_error if the pack can't be opened.
+void MountAssetPack(std::string_view path);
+// Looks in the mounted pack, then for the loose file, or the other way round
+// with `prefer_loose` (for files the editor saves, so the saved copy wins).
+// Nothing if neither has it; throws std::runtime_error if a packed entry is
+// corrupt or the loose file can't be mapped.
+std::optional<Asset> FindAsset(std::string_view path, bool prefer_loose = false);
+bool AssetExists(std::string_view path);
+
+#endif  // ASSET_PACK_H
@@ -0,0 +1,99 @@
+#ifndef BINARY_SCENE_H
+#define BINARY_SCENE_H
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+#include "scene.h"
+
+// On-disk layout of a .vbscene file. Every section is an array of fixed-size
+// little-endian records, 4-byte aligned, so a mapped file can be read in place:
+//
+//   Header | StringRecord[string_count] | string data
+//          | ObjectRecord[object_count] | PrefabRecord[prefab_count]
+//          | AttributeRecord[attribute_count]
+//          | uint32_t tags[tag_count]   | uint32_t textures[texture_count]
+//
+// Names, tags and attribute keys are indices into the string table; texture
+// attributes are indices into the texture table, which holds path strings.
+// Objects and prefabs both own ranges of the attribute section.
+namespace binary_scene {
+constexpr std::array<char, 4> kMagic = {'V', 'B', 'S', 'N'};
+constexpr std::uint32_t kVersion = 2;
+constexpr std::uint32_t kNoPrefab = 0xFFFFFFFF;
+constexpr std::string_view kExtension = ".vbscene";
+
+enum class AttributeType : std::uint32_t {
+  kInt,
+  kFloat,
+  kVec2,
+  kVec3,
+  kVec4,
+  kTexture
+};
+
+struct Header {
+  std::array<char, 4> magic;
+  std::uint32_t version;
+  std::uint32_t string_count;
+  std::uint32_t string_data_size;
+  std::uint32_t object_count;
+  std::uint32_t attribute_count;
+  std::uint32_t tag_count;
+  std::uint32_t texture_count;
+  std::uint32_t strings_offset;
+  std::uint32_t string_data_offset;
+  std::uint32_t objects_offset;
+  std::uint32_t attributes_offset;
+  std::uint32_t tags_offset;
+  std::uint32_t textures_offset;
+  std::uint32_t prefab_count;
+  std::uint32_t prefabs_offset;
+};
+
+struct StringRecord {
+  std::uint32_t offset;  // Into the string data blob
+  std::uint32_t length;
+};
+
+struct ObjectRecord {
+  std::uint32_t name;
+  std::uint32_t first_attribute;
+  std::uint32_t attribute_count;
+  std::uint32_t first_tag;
+  std::uint32_t tag_count;
+  std::uint32_t prefab;  // Index into the prefab section, or kNoPrefab
+};
+
+struct PrefabRecord {
+  std::uint32_t name;
+  std::uint32_t first_attribute;
+  std::uint32_t attribute_count;
+};
+
+struct AttributeRecord {
+  std::uint32_t name;
+  AttributeType type;
+  union {
+    std::int32_t i;
+    std::array<float, 4> f;
+    std::uint32_t texture;  // Into the texture table
+  } value;
+};
+
+static_assert(std::endian::native == std::endian::little,
+              "The binary scene format is little-endian");
+static_assert(std::is_trivially_copyable_v<Header> &&
+              std::is_trivially_copyable_v<ObjectRecord> &&
+              std::is_trivially_copyable_v<PrefabRecord> &&
+              std::is_trivially_copyable_v<AttributeRecord>);
+static_assert(sizeof(AttributeRecord) == 24);
+}  // namespace binary_scene
+
+Scene LoadBinaryScene(std::string_view path, bool load_textures = true);
+void SaveBinaryScene(const Scene& scene, std::string_view path,
+                     std::atomic<std::size_t>* progress = nullptr);
+
+#endif  // BINARY_SCENE_H
@@ -0,0 +1,119 @@
+#ifndef CPU_RENDERER_H
+#define CPU_RENDERER_H
+#include <array>
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "light_lod.h"
+#include "render_proxy.h"
+#include "scene.h"
+#include "shadow_map.h"
+
+// A software copy of Renderer for machines without an OpenGL driver, and a
+// reference to check the GPU output against. It follows the same passes at
+// the same low resolution: sprites are rasterized into albedo and normal
+// buffers back to front (which leaves what Renderer's depth test does), lit exactly as deferred_fragment.glsl does (including light merging,
+// shadows and the static lighting Renderer bakes, which is recomputed each
+// frame here), and scaled up to the viewport. Lighting runs on several pixels
+// at once with SSE, or AVX2 when built with VIBRANT_AVX2, and on plain floats
+// elsewhere; the frame is split into tiles shared between threads.
+class CpuRenderer {
+ public:
+  CpuRenderer(glm::ivec2 viewport, std::size_t shadow_refresh_limit = 4,
+              std::size_t threads = 0);
+
+  // Name of the instruction set the lighting was built for.
+  static std::string_view Simd();
+
+  // Decodes the scene's textures, which must have been loaded without the GL
+  // context (see LoadScene), and points their ids at the decoded images so
+  // SpriteProxy's textures refer to them.
+  void LoadTextures(Scene& scene);
+
+  // Same as Renderer::Draw, for the viewport given on construction, except
+  // that emitters are not drawn: their particles only exist on the GPU.
+  void Draw(std::span<const SpriteProxy> sprites,
+            std::span<const LightProxy> lights,
+            std::span<const OccluderProxy> occluders, const glm::mat4& view,
+            glm::vec3 clear_color);
+  // RGB, top row first, as Draw left it.
+  std::span<const unsigned char> Frame() const { return frame_; }
+
+  LightLod& Lod() { return light_lod_; }
+  // Same as Renderer::Advance, for sprite animations.
+  void Advance(float seconds) { time_ += seconds; }
+
+ private:
+  struct Image {
+    int width = 0;
+    int height = 0;
+    // Normalized RGB, bottom row first like a GL texture
+    std::vector<float> rgb;
+    // Per texel, empty for textures without alpha, which sample as 1
+    std::vector<float> alpha;
+  };
+  struct Plane {
+    std::vector<float> values[3];
+  };
+  // A sprite set up for the frame
+  struct Raster {
+    // Sprite coordinates of pixel p's centre are origin + p.x * x_axis +
+    // p.y * y_axis; the sprite covers [-0.5, 0.5) in both
+    glm::vec2 origin;
+    glm::vec2 x_axis;
+    glm::vec2 y_axis;
+    // Pixels the sprite may cover, last exclusive
+    glm::ivec2 first;
+    glm::ivec2 last;
+    // Null where the pass is skipped
+    const Image* color;
+    const Image* normal;
+    // Whose alpha cuts out or blends the sprite in both passes
+    const Image* mask;
+    // The animation frame's offset (x, y) and scale (z, w) of the texture
+    // coordinates
+    glm::vec4 frame;
+    // Also drawn into static_normal_
+    bool is_static;
+    bool is_transparent;
+    // transform.position.z as seen, and the sprite's place in the list
+    float layer;
+    std::size_t index;
+  };
+
+  // Rasterizes the sprites into, and lights, the pixels from `first` up to
+  // (not including) `last`. Only lights marked in `shadowed` have an occluder
+  // in their shadow map.
+  void DrawTile(glm::ivec2 first, glm::ivec2 last,
+                std::span<const LightProxy> static_lights,
+                std::span<const LightProxy> lights,
+                const std::array<bool, ShadowMaps::kMaxLights>& shadowed);
+
+  glm::ivec2 viewport_;
+  // Size of Renderer's low resolution framebuffers
+  glm::ivec2 size_;
+  // Row length of the planes, padded to a whole number of SIMD lanes
+  std::size_t stride_;
+  std::size_t threads_;
+  // By texture id; id 0, a texture that failed to load, is black as in GL
+  std::vector<Image> images_;
+  Plane albedo_;
+  Plane normal_;
+  // Normals of the static sprites alone, which static lights see
+  Plane static_normal_;
+  // The lit low resolution frame, RGB, bottom row first
+  std::vector<unsigned char> deferred_;
+  std::vector<unsigned char> frame_;
+  LightLod light_lod_;
+  ShadowMaps shadow_maps_;
+  std::vector<Raster> rasters_;
+  std::vector<LightProxy> static_lights_;
+  std::vector<LightProxy> dynamic_lights_;
+  double time_ = 0.0;
+};
+
+#endif  // CPU_RENDERER_H
@@ -0,0 +1,53 @@
+#ifndef FRAME_BENCHMARK_H
+#define FRAME_BENCHMARK_H
+#include <cstddef>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "light_lod.h"
+
+// End-to-end frame timing (`vibrant --benchmark`): renders a scene for a fixed
+// number of frames without the editor UI, writes the CPU and GPU time of each
+// frame as CSV and prints their percentiles. The last frame can be saved, or
+// compared against a golden image to catch rendering changes. Only needs an
+// OpenGL 3.3 context, so Mesa's llvmpipe will do on machines without a GPU;
+// the CPU backend needs no OpenGL at all.
+enum class RenderBackend {
+  kOpengl,
+  // CpuRenderer; frames are timed as a whole, there is no GPU time
+  kCpu,
+};
+
+struct FrameBenchmarkOptions {
+  std::string scene_path;
+  std::size_t frames = 600;
+  // Rendered first and left out of the results
+  std::size_t warmup_frames = 10;
+  glm::ivec2 resolution = {1280, 720};
+  // Pans the camera and moves the lights, the same way on every run
+  bool animate = false;
+  std::string csv_path = "frame_times.csv";
+  std::string capture_path;
+  std::string golden_path;
+  // Largest mean difference per color channel (0-255) that still passes
+  float tolerance = 1.0F;
+  LightLodOptions light_lod;
+  // Off, sprites are drawn in list order without the depth test, to compare
+  // overdraw (OpenGL only)
+  bool depth_sort = true;
+  // Off, static sprites are drawn one by one instead of from chunk batches
+  // (OpenGL only)
+  bool static_batching = true;
+  // Off, every sprite binds its own textures (OpenGL only)
+  bool texture_atlas = true;
+  RenderBackend backend = RenderBackend::kOpengl;
+};
+
+// From the arguments after `--benchmark <scene>`. Throws on a bad option.
+FrameBenchmarkOptions ParseFrameBenchmarkOptions(int argc, char* argv[]);
+// Returns the process exit code; failure if the benchmark could not run or
+// the last frame does not match the golden image.
+int RunFrameBenchmark(const FrameBenchmarkOptions& options);
+
+#endif  // FRAME_BENCHMARK_H
@@ -5,6 +5,7 @@
 #include <GLFW/glfw3.h>
 
 #include <memory>
+#include <unordered_map>
 
 #include "opengl_objects.h"
 
@@ -42,6 +43,9 @@ extern std::vector<std::shared_ptr<Framebuffer>> all_framebuffers;
 extern std::vector<unsigned int> loaded_textures;
 extern std::vector<unsigned int> loaded_vertex_arrays;
 extern std::vector<unsigned int> loaded_buffers;
+// Bytes uploaded to each texture and buffer, for the memory report
+extern std::unordered_map<unsigned int, std::size_t> texture_bytes;
+extern std::unordered_map<unsigned int, std::size_t> buffer_bytes;
 
 unsigned int CreateVertexArrayObject(VertexArrayCreateInfo info);
 
@@ -52,12 +56,19 @@ unsigned int CreateBufferObject(BufferCreateInfo<T> info) {
   glBindBuffer(info.type, buffer);
   glBufferData(info.type, info.size, info.data, info.usage);
   loaded_buffers.push_back(buffer);
+  buffer_bytes[buffer] = info.size;
   return buffer;
 }
 
 unsigned int CreateTextureObject(TextureCreateInfo info);
+// `feedback_varyings` are captured, interleaved, by transform feedback.
 unsigned int LoadShaderProgram(
-    std::vector<std::pair<unsigned int, std::string>> shader_paths);
-std::shared_ptr<Framebuffer> CreateFramebuffer(GLFWwindow* window, float scale);
+    std::vector<std::pair<unsigned int, std::string>> shader_paths,
+    const std::vector<const char*>& feedback_varyings = {});
+// With `depth`, the framebuffer also gets a depth attachment.
+std::shared_ptr<Framebuffer> CreateFramebuffer(GLFWwindow* window, float scale,
+                                               bool depth = false);
+// (Re)allocates the framebuffer's attachments at its size.
+void AllocateFramebuffer(const Framebuffer& framebuffer);
 
 #endif  // HELPERS_H
@@ -0,0 +1,124 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "scene.h"
+
+// Append-only log of scene edits kept next to the scene file
+// (<scene>.journal). Edits are encoded as compact binary entries in memory and
+// appended to the file by Flush(), so an autosave only costs as much as the
+// edits made since the last one. Objects, attributes and tags are addressed
+// by index, which stays valid because entries are replayed in order on top of
+// the same base scene.
+//
+// Saving the scene is compaction: the journal is folded into the new base
+// file and truncated once the save has succeeded. The journal header records
+// the size and modification time of its base file, so a journal left behind
+// by an interrupted compaction is recognised as stale and ignored.
+class Journal {
+ public:
+  // A journal without a scene path records nothing; a scene that was never
+  // saved has nowhere to autosave to.
+  Journal() = default;
+  explicit Journal(std::string_view scene_path);
+
+  // The object's prefab is not recorded; follow with SetPrefab.
+  void AddObject(std::size_t index, const Object& object);
+  void RemoveObject(std::size_t index);
+  void SetName(std::size_t object, std::string_view name);
+  // `attribute` equal to the attribute count appends.
+  void SetAttribute(std::size_t object, std::size_t attribute,
+                    std::string_view name, const AttributeData& value);
+  void RemoveAttribute(std::size_t object, std::size_t attribute);
+  // `tag` equal to the tag count appends.
+  void SetTag(std::size_t object, std::size_t tag, std::string_view value);
+  void RemoveTag(std::size_t object, std::size_t tag);
+  // Prefabs are addressed by their index in the scene's prefab list.
+  void SetPrefab(std::size_t object, std::optional<std::size_t> prefab);
+  void AddPrefab(std::size_t index, const AttributeTemplate& prefab);
+  void SetPrefabAttribute(std::size_t prefab, std::size_t attribute,
+                          std::string_view name, const AttributeData& value);
+  void RemovePrefabAttribute(std::size_t prefab, std::size_t attribute);
+
+  // Appends everything recorded since the last flush to the file.
+  void Flush();
+  // Call before saving a snapshot of the scene to `scene_path`. Edits made
+  // while the save runs are held back until EndCompaction.
+  void BeginCompaction(std::string_view scene_path);
+  // Truncates the journal if the save succeeded; the journal then follows
+  // the newly saved file.
+  void EndCompaction(bool saved);
+  // Call on a journal without a scene path when a scene starts streaming in
+  // (see SceneStream). Edits are held back until EndStream, addressing
+  // objects in the scene's order while it streams: in the order they were
+  // published.
+  void BeginStream();
+  // Call once the stream is Done. `file_order` holds the position in the
+  // file of each published object, in the order they were published.
+  // Rewrites the held edits to address the file's order and attaches the
+  // journal to `scene_path`. Returns the index in file order of each of the
+  // scene's objects, which the scene has to be reordered to.
+  std::vector<std::size_t> EndStream(std::string_view scene_path,
+                                     std::vector<std::size_t> file_order);
+  // For a scene file replaced by one the edits were not made to: keeps the
+  // journal, unflushed entries included, as <journal>.bad and empties it.
+  void SetAside();
+  // Size of the journal file, including unflushed entries.
+  std::size_t Size() const { return file_size_ + pending_.size(); }
+
+ private:
+  enum class Operation : std::uint8_t {
+    kAddObject,
+    kRemoveObject,
+    kSetName,
+    kSetAttribute,
+    kSetTag,
+    kRemoveTag,
+    kRemoveAttribute,
+    kSetPrefab,
+    kAddPrefab,
+    kSetPrefabAttribute,
+    kRemovePrefabAttribute
+  };
+
+  bool Recording() const {
+    return !path_.empty() || compacting_ || streaming_;
+  }
+  void Attach(std::string_view scene_path);
+  void Begin(Operation operation, std::size_t object);
+  void End();
+  void PutU32(std::uint32_t value);
+  void PutString(std::string_view value);
+  void PutValue(const AttributeData& value);
+  void PutAttributes(
+      const std::vector<std::pair<std::string, AttributeData>>& attributes);
+
+  std::string path_;
+  std::string pending_;
+  std::size_t entry_start_ = 0;
+  std::size_t file_size_ = 0;
+  std::uint64_t base_size_ = 0;
+  std::int64_t base_modified_ = 0;
+  bool compacting_ = false;
+  bool streaming_ = false;
+  // The scene being saved, which the journal follows once it is
+  std::string compaction_scene_path_;
+
+  friend void ReplayJournal(std::string_view scene_path, Scene& scene,
+                            bool load_textures);
+};
+
+std::string JournalPath(std::string_view scene_path);
+// Applies the journal next to `scene_path`, if there is one, to `scene`. Never
+// throws for a journal that does not match the scene: replay stops at the
+// first entry that does not apply, or is truncated by a crash mid-append, with
+// a warning, and the journal is kept as <journal>.bad and cut back to the
+// entries that did.
+void ReplayJournal(std::string_view scene_path, Scene& scene,
+                   bool load_textures = true);
+
+#endif  // JOURNAL_H
@@ -0,0 +1,88 @@
+#ifndef LIGHT_LOD_H
+#define LIGHT_LOD_H
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "render_proxy.h"
+
+struct LightLodOptions {
+  // How far a light may move when merged, as a fraction of its distance from
+  // the view (plus a tenth of the view for lights on it). Dim lights may move
+  // further, in proportion to how much dimmer than full intensity they are.
+  float error_bound = 0.25F;
+  // Lights shaded at most; more than MAX_LIGHTS in deferred_fragment.glsl are
+  // ignored by the shader anyway
+  std::size_t budget = 64;
+};
+
+struct LightLodStats {
+  std::size_t lights = 0;
+  // Sent to the shader, aggregates included
+  std::size_t shaded = 0;
+  // Point lights folded into aggregates
+  std::size_t merged = 0;
+  std::size_t aggregates = 0;
+  // The error bound the budget allowed, at least LightLodOptions::error_bound
+  float error = 0.0F;
+};
+
+// Light level of detail: point lights far from the view, or too dim to matter,
+// are merged with their neighbours into one representative light each, so
+// thousands of small lights cost about as much as a few dozen. Lights are
+// clustered on a grid whose cells grow with distance from the view (screen
+// texture coordinates, see deferred_fragment.glsl); if that leaves more than
+// the budget, the cells are made coarser until it fits.
+class LightLod {
+ public:
+  explicit LightLod(LightLodOptions options = {});
+
+  void SetOptions(LightLodOptions options) { options_ = options; }
+  const LightLodOptions& Options() const { return options_; }
+
+  // The lights to shade. Global lights pass through; point lights left alone
+  // by clustering are passed through unchanged. Valid until the next call.
+  std::span<const LightProxy> Reduce(std::span<const LightProxy> lights);
+  const LightLodStats& Stats() const { return stats_; }
+
+ private:
+  struct Cluster {
+    // Sums weighted by intensity, divided out in Emit
+    glm::vec3 position;
+    glm::vec3 color;
+    float falloff;
+    float volumetric_intensity;
+    float intensity;
+    float weight;
+    // Summed peak contribution to the view, for the last-resort merge
+    float contribution;
+    std::size_t first;
+    std::size_t count;
+  };
+
+  // Measures each point light's distance and contribution, once per Reduce.
+  void Measure(std::span<const LightProxy> lights);
+  // Clusters the point lights with cells scaled by `error`.
+  void Group(std::span<const LightProxy> lights, float error);
+  // Folds the least contributing clusters into one, leaving `limit`.
+  void Truncate(std::size_t limit);
+  void Emit(std::span<const LightProxy> lights);
+
+  struct Measured {
+    std::size_t index;
+    // Cell size per unit of error
+    float scale;
+    float contribution;
+  };
+
+  LightLodOptions options_;
+  std::vector<Measured> measured_;
+  std::vector<Cluster> clusters_;
+  std::unordered_map<std::uint64_t, std::size_t> cells_;
+  std::vector<LightProxy> shaded_;
+  LightLodStats stats_;
+};
+
+#endif  // LIGHT_LOD_H
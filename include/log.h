@@ -6,6 +6,12 @@
 
 enum class LogLevel { kInfo, kWarning, kError };
 
+// Only touched by the UI thread.
 extern std::map<std::string, LogLevel> output_log;
 
+// Safe to call from any thread; the message reaches output_log on the UI
+// thread's next FlushLog().
+void PostLog(std::string message, LogLevel level);
+void FlushLog();
+
 #endif  // LOG_H
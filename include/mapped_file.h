@@ -0,0 +1,29 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+#include <cstddef>
+#include <string_view>
+
+// Read-only view of a whole file mapped into memory. With `writable` the
+// mapping is private (copy-on-write), so the contents can be modified in place
+// without touching the file on disk.
+class MappedFile {
+ public:
+  explicit MappedFile(std::string_view path, bool writable = false);
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const std::byte* Data() const { return data_; }
+  std::byte* MutableData() { return data_; }
+  std::size_t Size() const { return size_; }
+
+ private:
+  std::byte* data_ = nullptr;
+  std::size_t size_ = 0;
+#ifdef _WIN32
+  void* file_ = nullptr;
+  void* mapping_ = nullptr;
+#endif
+};
+
+#endif  // MAPPED_FILE_H
@@ -0,0 +1,44 @@
+#ifndef MEMORY_REPORT_H
+#define MEMORY_REPORT_H
+#include <cstddef>
+#include <string>
+
+#include "scene.h"
+
+// Bytes in use by category. The CPU side is measured by walking the live
+// data when a report is made, so normal allocations carry no bookkeeping;
+// the GPU side comes from the sizes recorded when textures, buffers and
+// framebuffers were created (see helpers.h), as uploaded, before any padding
+// the driver adds.
+struct MemoryReport {
+  // CPU
+  std::size_t objects = 0;     // Object structs, their tag lists, scene list
+  std::size_t attributes = 0;  // Attribute lists of objects and prefabs
+  std::size_t strings = 0;     // Heap-allocated names, tags and paths
+  std::size_t logs = 0;        // The output log
+  // The simulation's object list, proxies and render states (see
+  // Simulation::MemoryBytes); the objects it shares with the scene are
+  // counted above
+  std::size_t simulation = 0;
+  // GPU
+  std::size_t textures = 0;
+  std::size_t buffers = 0;
+  std::size_t framebuffers = 0;
+
+  std::size_t Cpu() const {
+    return objects + attributes + strings + logs + simulation;
+  }
+  std::size_t Gpu() const { return textures + buffers + framebuffers; }
+  std::string ToJson() const;
+};
+
+MemoryReport MeasureMemory(const Scene& scene);
+// What MeasureMemory counts for one object, in all categories
+std::size_t ObjectBytes(const Object& object);
+// The texture bytes the scene's distinct textures would take once uploaded,
+// read from their image headers. For reports made without an OpenGL context.
+std::size_t EstimateTextureBytes(const Scene& scene);
+// "12.3 MB"
+std::string FormatBytes(std::size_t bytes);
+
+#endif  // MEMORY_REPORT_H
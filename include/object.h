@@ -1,52 +1,99 @@
 #pragma once
 #include <algorithm>
 #include <glm/glm.hpp>
+#include <memory>
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
 #include "log.h"
 #include "texture.h"
 
+// Trivially copyable: textures hold a handle to their path (see texture.h),
+// so a value is a vec4 and a tag.
 using AttributeData =
     std::variant<int, float, glm::vec2, glm::vec3, glm::vec4, Texture>;
+static_assert(sizeof(AttributeData) <= 20 &&
+              std::is_trivially_copyable_v<AttributeData>);
+
+struct AttributeTemplate {
+  std::string name;
+  std::vector<std::pair<std::string, AttributeData>> attributes;
+};
+
+namespace attributes {
+inline AttributeData* Find(
+    std::vector<std::pair<std::string, AttributeData>>& list,
+    std::string_view name) {
+  auto it = std::ranges::find_if(
+      list, [&](const auto& attribute) { return attribute.first == name; });
+  return it == list.end() ? nullptr : &it->second;
+}
+}  // namespace attributes
 
 struct Object {
   std::string name;
   std::vector<std::string> tags;
+  // With a prefab, only the attributes this object overrides.
   std::vector<std::pair<std::string, AttributeData>> attributes;
+  // Shared by every object made from the same template, so editing it
+  // changes all of them. Must be one of the owning scene's prefabs.
+  std::shared_ptr<AttributeTemplate> prefab;
   bool HasTag(std::string_view tag) const {
     return std::ranges::any_of(tags,
                                [&](std::string_view t) { return t == tag; });
   }
 
+  // The object's own value if it has one, otherwise the prefab's.
+  AttributeData* FindAttribute(std::string_view attribute_name) {
+    if (auto* data = attributes::Find(attributes, attribute_name)) {
+      return data;
+    }
+    return prefab ? attributes::Find(prefab->attributes, attribute_name)
+                  : nullptr;
+  }
+
   AttributeData& GetAttribute(std::string_view attribute_name) {
-    for (auto& [name, data] : attributes) {
-      if (name == attribute_name) {
-        return data;
-      }
+    if (auto* data = FindAttribute(attribute_name)) {
+      return *data;
     }
-    output_log["Attribute Not Found: " + std::string(attribute_name)] =
-        LogLevel::kError;
+    // Render proxies are compiled on the simulation thread
+    PostLog("Attribute Not Found: " + std::string(attribute_name),
+            LogLevel::kError);
     throw std::runtime_error("Attribute not found: " +
                              std::string(attribute_name));
   }
 
-  void SetAttribute(std::string_view attribute_name,
-                    const AttributeData& value) {
-    attributes.emplace_back(attribute_name, value);
-    output_log["Attribute Set: " + std::string(attribute_name)] =
-        LogLevel::kInfo;
+  // Replaces the object's own attribute of that name, or adds one (which
+  // overrides the prefab's). Returns its index in `attributes`.
+  std::size_t SetAttribute(std::string_view attribute_name,
+                           const AttributeData& value) {
+    auto it = std::ranges::find_if(attributes, [&](const auto& attribute) {
+      return attribute.first == attribute_name;
+    });
+    if (it != attributes.end()) {
+      it->second = value;
+    } else {
+      it = attributes.emplace(attributes.end(), attribute_name, value);
+    }
+    PostLog("Attribute Set: " + std::string(attribute_name), LogLevel::kInfo);
+    return static_cast<std::size_t>(it - attributes.begin());
   }
 };
 
-struct AttributeTemplate {
-  std::string name;
-  std::vector<std::pair<std::string, AttributeData>> attributes;
-};
-
 namespace attributes {
-std::vector<AttributeTemplate> LoadTemplates();
-void SaveTemplates(const std::vector<AttributeTemplate>& templates);
+std::vector<AttributeTemplate> LoadTemplates(
+    std::string_view path = "attributes.xml");
+void SaveTemplates(const std::vector<AttributeTemplate>& templates,
+                   std::string_view path = "attributes.xml");
+// Parses the value string of an XML attribute of the given type. Textures are
+// returned unloaded (id 0) with only the path set. Numbers may have leading
+// whitespace and a '+', and vectors separate them with commas or spaces, but
+// nothing else may follow the last one. Returns nullopt for unknown types and
+// malformed values.
+std::optional<AttributeData> ParseValue(std::string_view type,
+                                        std::string_view value);
 }  // namespace attributes
@@ -0,0 +1,35 @@
+#ifndef OBJECT_FILTER_H
+#define OBJECT_FILTER_H
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "scene.h"
+
+// The indices of the objects whose name or one of whose tags contains the
+// query (ignoring case). The matches are kept between frames and only
+// searched again when the query or the scene changes; typing more of a query
+// only narrows the previous matches, and objects appended to the scene (as a
+// streamed scene arrives) are the only ones searched.
+class ObjectFilter {
+ public:
+  void SetQuery(std::string_view query);
+  // Call after names or tags were edited, or objects were removed, reordered
+  // or inserted anywhere but the end. Appending objects is noticed on its
+  // own.
+  void Invalidate() { valid_ = false; }
+  const std::vector<std::size_t>& Matches(const Scene& scene);
+
+ private:
+  bool Match(const Object& object) const;
+
+  std::string query_;
+  std::vector<std::size_t> matches_;
+  std::size_t object_count_ = 0;
+  bool valid_ = false;
+  // The query grew, so only the current matches need checking again
+  bool narrow_ = false;
+};
+
+#endif  // OBJECT_FILTER_H
@@ -12,6 +12,7 @@ struct Framebuffer {
   float scale;
   glm::ivec2 size;
   unsigned int colorbuffer;
+  // 24-bit depth texture, or 0 for framebuffers created without depth
   unsigned int depthbuffer;
 };
 
@@ -0,0 +1,42 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+// Splits [0, count) into contiguous chunks of at least `min_chunk` items and
+// runs `fn(begin, end)` for each on its own thread. Small ranges run inline.
+// The first exception thrown by any chunk is rethrown once all have finished.
+template <typename Fn>
+void ParallelChunks(std::size_t count, std::size_t min_chunk, Fn&& fn) {
+  std::size_t threads = std::max(1U, std::thread::hardware_concurrency());
+  threads = std::min(threads, std::max<std::size_t>(1, count / min_chunk));
+  if (threads <= 1) {
+    fn(std::size_t{0}, count);
+    return;
+  }
+  std::size_t chunk = (count + threads - 1) / threads;
+  std::vector<std::exception_ptr> errors(threads);
+  {
+    std::vector<std::jthread> workers;
+    workers.reserve(threads);
+    for (std::size_t i = 0; i < threads; i++) {
+      workers.emplace_back([&, i] {
+        try {
+          fn(i * chunk, std::min(count, (i + 1) * chunk));
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+      });
+    }
+  }
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+#endif  // PARALLEL_H
@@ -0,0 +1,59 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "render_proxy.h"
+
+// Particles of every emitter, simulated and drawn entirely on the GPU, so the
+// CPU cost of an emitter does not grow with its particle count. Each emitter
+// has two particle buffers: every Update runs particle_update.glsl over one
+// with transform feedback into the other (nothing is rasterized), and the
+// newest is drawn as instances of the sprite quad into Renderer's G-buffer
+// passes. Emitters are matched to their particles by position in the list;
+// reordering them, or changing an emitter's count, restarts its particles.
+//
+// Particles are born unborn and spread evenly over the first lifetime, so
+// an emitter emits count / lifetime particles a second from the start.
+class ParticleSystem {
+ public:
+  // The sprite quad's vertex and index buffers, shared with Renderer.
+  ParticleSystem(unsigned int quad_vertex_buffer,
+                 unsigned int quad_index_buffer);
+  ParticleSystem(const ParticleSystem&) = delete;
+  ParticleSystem& operator=(const ParticleSystem&) = delete;
+  ~ParticleSystem();
+
+  // Advances the emitters' particles by `seconds`, (re)allocating their
+  // buffers as emitters come, go and change count.
+  void Update(std::span<const EmitterProxy> emitters, float seconds);
+  // Draws the particles into the bound framebuffer, with the emitters' color
+  // textures or, with `normals`, their normal textures. `overdraw` and
+  // `alpha_cutoff` are as in sprite_fragment.glsl.
+  void Draw(std::span<const EmitterProxy> emitters, bool normals,
+            bool overdraw, float alpha_cutoff);
+
+  std::size_t ParticleCount() const;
+
+ private:
+  struct Particles {
+    std::uint32_t count = 0;
+    // Ping-pong: `current` holds the latest state
+    unsigned int buffers[2] = {0, 0};
+    unsigned int update_arrays[2] = {0, 0};
+    unsigned int draw_arrays[2] = {0, 0};
+    int current = 0;
+  };
+
+  void Allocate(Particles& particles, const EmitterProxy& emitter);
+  void Release(Particles& particles);
+
+  unsigned int quad_vertex_buffer_;
+  unsigned int quad_index_buffer_;
+  unsigned int update_shader_;
+  unsigned int draw_shader_;
+  std::vector<Particles> particles_;
+};
+
+#endif  // PARTICLES_H
@@ -0,0 +1,123 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+#include <glad/glad.h>
+// Code block
+#include <GLFW/glfw3.h>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "opengl_objects.h"
+
+// A frame's passes, each declaring the targets it reads and the one it
+// draws into, run in the order they were added. Compile culls the passes
+// whose output no remaining pass reads, then places the transient targets
+// (window-scaled color buffers, with or without depth) in a pool of
+// framebuffers kept between frames: targets whose uses do not overlap share
+// one. Copies between targets are a glBlitFramebuffer instead of a pass.
+// Imported targets, such as the window or a framebuffer owned elsewhere,
+// outlive the frame, so passes drawing into them are never culled.
+//
+// A pass finds its framebuffer bound and the viewport set to it; it clears
+// it itself, if it needs to, as transient targets start with whatever the
+// last target sharing their framebuffer left.
+//
+// The renderer's frame, as Renderer::Draw declares it:
+//  - "static normals" and "bake" re-bake the lightmap where static sprites
+//    or lights changed (see static_lighting.h).
+//  - "color" and "normal" draw the sprites by layer into depth-tested
+//    targets: opaque ones front to back, so hidden pixels fail the depth test
+//    before shading, then transparent ones blended back to front. Of sprites
+//    on the same layer, later ones are on top, except opaque static sprites,
+//    drawn from their batches after the others. Particles are drawn as
+//    cutouts on their emitter's layer after the opaque sprites. "normal" is
+//    culled when no point light is shaded.
+//  - "lighting" shades the point lights LightLod kept, with their shadows,
+//    and adds the lightmap; culled while showing overdraw.
+//  - "present" copies the lit frame, or the overdraw, into the window.
+class RenderGraph {
+ public:
+  using Target = std::size_t;
+
+  struct Stats {
+    std::size_t passes = 0;
+    std::size_t culled = 0;
+    std::size_t targets = 0;
+    // In the pool, some of which the frame may not have needed
+    std::size_t framebuffers = 0;
+  };
+
+  // Transient targets are `scale` times the window's framebuffer size.
+  RenderGraph(GLFWwindow* window, float scale);
+
+  // Drops the last frame's passes and targets, keeping the pool.
+  void Reset();
+  Target CreateTarget(std::string name, bool depth = false);
+  // `texture` is what passes reading the target sample, 0 if none can.
+  Target Import(std::string name, unsigned int framebuffer, glm::ivec2 size,
+                unsigned int texture = 0);
+  void AddPass(std::string name, std::vector<Target> inputs, Target output,
+               std::function<void()> execute);
+  // Scales `source`'s color to cover `destination`, with nearest filtering.
+  void AddCopy(std::string name, Target source, Target destination);
+
+  // Culls passes and assigns the targets framebuffers. Throws
+  // std::runtime_error if a pass reads a transient target no earlier pass
+  // draws into.
+  void Compile();
+  // Runs the passes Compile kept, leaving the window's framebuffer bound.
+  void Execute();
+
+  // The target's color texture while the frame runs; 0 for targets no pass
+  // kept uses.
+  unsigned int Texture(Target target) const;
+  // Size of transient targets
+  glm::ivec2 TransientSize() const;
+  const Stats& GetStats() const { return stats_; }
+
+ private:
+  struct TargetInfo {
+    std::string name;
+    bool depth = false;
+    bool imported = false;
+    unsigned int framebuffer = 0;
+    glm::ivec2 size = {0, 0};
+    unsigned int texture = 0;
+    // Into pool_, for transient targets Compile placed
+    std::size_t slot = kNone;
+  };
+  struct Pass {
+    std::string name;
+    std::vector<Target> inputs;
+    Target output;
+    // Empty for copies, which read inputs[0]
+    std::function<void()> execute;
+    bool culled = false;
+  };
+  struct Slot {
+    std::shared_ptr<Framebuffer> framebuffer;
+    bool depth;
+    // Index of the last pass using it this frame
+    std::size_t busy_until;
+  };
+
+  static constexpr std::size_t kNone = static_cast<std::size_t>(-1);
+
+  // Binds the target's framebuffer to `binding`; the current framebuffer
+  // size for transient ones, whose size may have changed since Compile.
+  glm::ivec2 Bind(GLenum binding, Target target) const;
+
+  GLFWwindow* window_;
+  float scale_;
+  std::vector<TargetInfo> targets_;
+  std::vector<Pass> passes_;
+  std::vector<Slot> pool_;
+  Stats stats_;
+};
+
+#endif  // RENDER_GRAPH_H
@@ -0,0 +1,197 @@
+#ifndef RENDER_PROXY_H
+#define RENDER_PROXY_H
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "scene.h"
+
+enum class AnimationMode : int { kLoop, kOnce, kPingPong };
+
+// A sprite sheet played by the sprite shader from the renderer's clock, so
+// animated sprites cost nothing per frame on the CPU. Tagged "animated";
+// the textures are a grid of frames, numbered along the rows from the first
+// row of the image file. The default is the whole texture, unanimated.
+struct SpriteAnimation {
+  // Columns and rows
+  glm::vec2 grid = {1.0F, 1.0F};
+  float frames = 1.0F;
+  // Frames per second; 0 holds the first frame
+  float rate = 0.0F;
+  AnimationMode mode = AnimationMode::kLoop;
+  // Seconds on the renderer's clock at which the first frame shows
+  float start = 0.0F;
+
+  bool operator==(const SpriteAnimation&) const = default;
+};
+
+// The frame shown at `time`, as an offset (x, y) and scale (z, w) of the
+// sprite's texture coordinates, as sprite_vertex.glsl computes it.
+glm::vec4 AnimationFrame(const SpriteAnimation& animation, float time);
+
+// Render-only copies of what the passes need from an object, compiled once
+// from its attributes instead of looked up by name every frame.
+struct SpriteProxy {
+  // Texture of a pass whose attribute the object lacks; skipped in that pass
+  static constexpr unsigned int kMissingTexture = ~0U;
+  glm::mat4 model;
+  unsigned int color_texture;
+  unsigned int normal_texture;
+  // Handles of the textures' paths (see texture.h), which unlike the ids
+  // are the same in every run; 0 if missing
+  std::uint32_t color_path = 0;
+  std::uint32_t normal_path = 0;
+  // Tagged "static": its normals are baked into the lightmap
+  bool is_static = false;
+  // Tagged "transparent": blended by its color's alpha, drawn after the
+  // opaque sprites; others are cut out where the alpha is below one half
+  bool is_transparent = false;
+  SpriteAnimation animation;
+};
+
+// Casts shadows from point lights (see shadow_map.h). Tagged "occluder";
+// the occluder is the object's unit quad, whether or not it is also drawn.
+struct OccluderProxy {
+  glm::mat4 model;
+};
+
+struct LightProxy {
+  glm::vec3 position;
+  int type;
+  glm::vec3 color;
+  float intensity;
+  float falloff;
+  float volumetric_intensity;
+  // Tagged "static": baked into the lightmap instead of shaded every frame
+  bool is_static = false;
+};
+
+// Emits particles that are simulated and drawn on the GPU (see particles.h),
+// instead of one object per particle. Tagged "emitter"; particles leave the
+// emitter's position along its up axis, turned by transform.rotation, and
+// are drawn like sprites on its layer with its textures.
+struct EmitterProxy {
+  glm::vec3 position;
+  // Radians, counterclockwise from straight up
+  float direction;
+  // Radians either side of the direction together
+  float spread;
+  float speed;
+  glm::vec2 gravity;
+  float size;
+  // Seconds; as many particles are emitted per lifetime as there are
+  float lifetime;
+  std::uint32_t count;
+  unsigned int color_texture;
+  unsigned int normal_texture;
+};
+
+// Distance (in screen texture coordinates, like the position) beyond which
+// the light adds less than 1/256 to any color; infinite without falloff.
+float LightReach(const LightProxy& light);
+
+// Keeps sprite and light proxies in step with a scene, recompiling only the
+// objects that changed. Objects that were added, removed or replaced (see
+// Detach) are found by identity on Sync; objects that were only reordered
+// must be reported with TouchOrder, and changes made to an object in place
+// with Touch.
+class RenderProxies {
+ public:
+  // Indices [begin, end) of a proxy array; empty if begin >= end.
+  struct Range {
+    std::size_t begin = 0;
+    std::size_t end = 0;
+
+    bool Empty() const { return begin >= end; }
+    void Add(std::size_t index) { Merge({index, index + 1}); }
+    void Merge(Range other) {
+      if (other.Empty()) {
+        return;
+      }
+      begin = Empty() ? other.begin : std::min(begin, other.begin);
+      end = std::max(end, other.end);
+    }
+  };
+  // The proxies the last Sync wrote. Arrays may also have shrunk; everything
+  // past a range's end that is still in the array is unchanged.
+  struct Changes {
+    Range sprites;
+    Range lights;
+    Range occluders;
+    Range emitters;
+
+    void Merge(const Changes& other) {
+      sprites.Merge(other.sprites);
+      lights.Merge(other.lights);
+      occluders.Merge(other.occluders);
+      emitters.Merge(other.emitters);
+    }
+  };
+
+  void Sync(Scene& scene);
+  const Changes& LastChanges() const { return changes_; }
+  void Touch(std::size_t index) { touched_.push_back(index); }
+  // For every object using the prefab.
+  void TouchPrefab(const AttributeTemplate* prefab) {
+    touched_prefabs_.push_back(prefab);
+  }
+  void TouchAll() { touched_all_ = true; }
+  // Objects were moved without any being added or removed, which Sync would
+  // otherwise take for replacements and recompile.
+  void TouchOrder() { touched_order_ = true; }
+
+  // In scene order, which is draw order.
+  std::span<const SpriteProxy> Sprites() const { return sprites_; }
+  std::span<const LightProxy> Lights() const { return lights_; }
+  std::span<const OccluderProxy> Occluders() const { return occluders_; }
+  std::span<const EmitterProxy> Emitters() const { return emitters_; }
+  // Of the compiled proxies and the packed arrays
+  std::size_t MemoryBytes() const;
+
+ private:
+  struct Slot {
+    // Weak, so the object can still be detached or freed; Realign finds the
+    // slot's object by it.
+    std::weak_ptr<Object> object;
+    std::optional<SpriteProxy> sprite;
+    std::optional<LightProxy> light;
+    std::optional<OccluderProxy> occluder;
+    std::optional<EmitterProxy> emitter;
+    std::size_t sprite_index = 0;
+    std::size_t light_index = 0;
+    std::size_t occluder_index = 0;
+    std::size_t emitter_index = 0;
+  };
+
+  // Moves each slot to its object's new index after objects were added or
+  // removed, so the objects around them keep their compiled proxies. Slots
+  // of removed objects are dropped, and added objects get empty ones. Only
+  // the span between the unchanged ends is matched by object. Returns where
+  // that span starts; the slots before it did not move.
+  std::size_t Realign(const std::vector<std::shared_ptr<Object>>& objects);
+  // Returns false if the object became or stopped being a sprite, light,
+  // occluder or emitter, in which case the packed arrays have to be rebuilt.
+  bool Compile(Slot& slot, const std::shared_ptr<Object>& object);
+  // Rebuilds the packed arrays from slot `first` on; the proxies of the
+  // slots before it keep their places.
+  void Pack(std::size_t first);
+
+  std::vector<Slot> slots_;
+  std::vector<std::size_t> touched_;
+  std::vector<const AttributeTemplate*> touched_prefabs_;
+  bool touched_all_ = false;
+  bool touched_order_ = false;
+  std::vector<SpriteProxy> sprites_;
+  std::vector<LightProxy> lights_;
+  std::vector<OccluderProxy> occluders_;
+  std::vector<EmitterProxy> emitters_;
+  Changes changes_;
+};
+
+#endif  // RENDER_PROXY_H
@@ -0,0 +1,163 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+#include <glad/glad.h>
+// Code block
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "light_lod.h"
+#include "opengl_objects.h"
+#include "particles.h"
+#include "render_graph.h"
+#include "render_proxy.h"
+#include "shadow_map.h"
+#include "static_batch.h"
+#include "static_lighting.h"
+#include "texture_atlas.h"
+
+// Orthographic projection showing 20 units vertically, centred on the view.
+glm::mat4 Projection(glm::ivec2 viewport);
+
+struct RenderDebugOptions {
+  // Sprites are depth tested and sorted by layer (transform.position.z, from
+  // -1 at the back to 1 at the front); off, they are drawn in list order, each
+  // over the last, whatever their layer
+  bool depth_sort = true;
+  // Shows how often each pixel of the color pass was shaded, an eighth of
+  // white per fragment, instead of the lit frame
+  bool overdraw = false;
+  // Opaque static sprites are drawn from StaticBatches; off, one by one.
+  // Needs depth_sort, as batches are not drawn in list order
+  bool static_batching = true;
+  // Sprites' textures are packed into a TextureAtlas and drawn from it; off,
+  // each sprite binds its own
+  bool texture_atlas = true;
+};
+
+// The deferred sprite renderer. Each frame, sprite colors and normals are
+// drawn into low-resolution framebuffers, lit in a full-screen pass and
+// scaled up into the window, as passes of a RenderGraph (render_graph.h
+// lists them). Opaque static sprites are drawn from StaticBatches, and
+// textures from a TextureAtlas where they could be packed. Point lights are
+// merged by LightLod and shadowed by occluders through ShadowMaps, at most
+// `shadow_refresh_limit` maps being redrawn per frame; static lights are
+// baked into a lightmap instead (see static_lighting.h). Emitters' particles
+// are simulated and drawn by a ParticleSystem. Owns the shaders; buffers,
+// vertex arrays and framebuffers are released with the rest in
+// loaded_buffers etc. (see helpers.h).
+class Renderer {
+ public:
+  explicit Renderer(GLFWwindow* window, std::size_t shadow_refresh_limit = 4);
+  Renderer(const Renderer&) = delete;
+  Renderer& operator=(const Renderer&) = delete;
+  ~Renderer();
+
+  // Draws into the default framebuffer, which is `viewport` pixels.
+  void Draw(std::span<const SpriteProxy> sprites,
+            std::span<const LightProxy> lights,
+            std::span<const OccluderProxy> occluders,
+            std::span<const EmitterProxy> emitters, const glm::mat4& view,
+            glm::ivec2 viewport, glm::vec3 clear_color);
+  // Moves particles on by `seconds` at the next Draw, and the clock sprite
+  // animations play by (see SpriteAnimation).
+  void Advance(float seconds) {
+    pending_seconds_ += seconds;
+    time_ += seconds;
+  }
+  std::size_t ParticleCount() const { return particles_->ParticleCount(); }
+
+  // Options and stats of the light merging done by Draw
+  LightLod& Lod() { return light_lod_; }
+
+  void SetDebugOptions(RenderDebugOptions options);
+  const RenderDebugOptions& DebugOptions() const { return debug_options_; }
+  const StaticBatches::Stats& BatchStats() const {
+    return static_batches_.GetStats();
+  }
+  const TextureAtlas& Atlas() const { return atlas_; }
+  // Fragments shaded per pixel of the color pass, read back a frame or more
+  // after it was drawn so as not to stall
+  float Overdraw() const { return overdraw_; }
+  const RenderGraph::Stats& GraphStats() const { return graph_.GetStats(); }
+
+  // Uses a saved lightmap instead of baking, from the first frame whose static
+  // sprites and lights match it. Throws std::runtime_error if it can't be read.
+  void LoadLightmap(const std::string& path);
+  // Saves the lightmap of the last frame. Throws std::runtime_error on failure.
+  void SaveLightmap(const std::string& path);
+
+ private:
+  RenderGraph graph_;
+  unsigned int sprite_shader_;
+  unsigned int deferred_shader_;
+  unsigned int sprite_uniform_buffer_;
+  unsigned int sprite_vertex_array_;
+  unsigned int deferred_vertex_array_;
+  LightLod light_lod_;
+  ShadowMaps shadow_maps_;
+  // ShadowMaps::Atlas as a single-channel float texture
+  unsigned int shadow_atlas_;
+  // The frame's lights that are not static
+  std::vector<LightProxy> dynamic_lights_;
+
+  // Orders the sprites for DrawLayers.
+  void Sort(std::span<const SpriteProxy> sprites, const glm::mat4& view);
+  // Draws the sorted sprites' `texture` into the bound framebuffer: opaque
+  // ones front to back, then the static batches and the emitters' particles,
+  // then transparent ones back to front.
+  void DrawLayers(std::span<const SpriteProxy> sprites,
+                  std::span<const EmitterProxy> emitters,
+                  unsigned int SpriteProxy::*texture, bool overdraw);
+
+  bool Batching() const {
+    return debug_options_.static_batching && debug_options_.depth_sort;
+  }
+
+  // The atlas to draw from, if in use
+  const TextureAtlas* ActiveAtlas() const {
+    return debug_options_.texture_atlas ? &atlas_ : nullptr;
+  }
+
+  TextureAtlas atlas_;
+  StaticBatches static_batches_;
+  glm::mat4 view_projection_ = glm::mat4(1.0F);
+  std::unique_ptr<ParticleSystem> particles_;
+  float pending_seconds_ = 0.0F;
+  double time_ = 0.0;
+
+  RenderDebugOptions debug_options_;
+  // Layer, as ordered bits, above the sprite's index, sorted back to front
+  std::vector<std::uint64_t> sort_keys_;
+  // Sprite indices in drawing order
+  std::vector<std::uint32_t> opaque_order_;
+  std::vector<std::uint32_t> transparent_order_;
+  // Counts the color pass's samples; one query in flight at a time
+  unsigned int overdraw_query_ = 0;
+  bool overdraw_query_pending_ = false;
+  float overdraw_ = 0.0F;
+
+  // (Re)allocates the lightmap at the size of the lighting pass.
+  void ResizeLightmap();
+  // Adds the passes baking StaticLighting's sprites and lights into `region`
+  // of `lightmap`.
+  void Bake(StaticLighting::Region region, const glm::mat4& view,
+            glm::vec3 clear_color, RenderGraph::Target lightmap);
+
+  StaticLighting static_lighting_;
+  std::optional<LightmapFile> loaded_lightmap_;
+  unsigned int bake_shader_;
+  unsigned int lightmap_framebuffer_ = 0;
+  unsigned int baked_diffuse_ = 0;
+  unsigned int baked_volumetric_ = 0;
+  glm::ivec2 lightmap_size_ = {0, 0};
+};
+
+#endif  // RENDERER_H
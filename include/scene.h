@@ -1,12 +1,91 @@
 #pragma once
+#include <atomic>
+#include <functional>
+#include <glm/glm.hpp>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "object.h"
 
 struct Scene {
   std::vector<std::shared_ptr<Object>> objects;
+  // Templates objects refer to by reference. Names are unique; files refer
+  // to prefabs by name (XML) or index (binary).
+  std::vector<std::shared_ptr<AttributeTemplate>> prefabs;
 };
 
-Scene LoadScene(std::string_view path);
-void SaveScene(const Scene& scene, std::string_view path);
+// Copying a Scene only copies object pointers, which makes it a cheap
+// snapshot. Before changing an object that may be shared with a snapshot,
+// detach it: it is cloned if anything else still holds it.
+inline Object& Detach(std::shared_ptr<Object>& object) {
+  if (object.use_count() > 1) {
+    object = std::make_shared<Object>(*object);
+  }
+  return *object;
+}
+
+// The same for a prefab, which a snapshot shares through its objects as well
+// as its prefab list: if anything outside the live scene still holds it, the
+// prefab is cloned and the live objects using it are detached and re-pointed.
+inline AttributeTemplate& DetachPrefab(Scene& scene, std::size_t index) {
+  auto& prefab = scene.prefabs[index];
+  std::vector<std::shared_ptr<Object>*> users;
+  for (auto& object : scene.objects) {
+    if (object->prefab == prefab) {
+      users.push_back(&object);
+    }
+  }
+  if (static_cast<std::size_t>(prefab.use_count()) > users.size() + 1) {
+    auto clone = std::make_shared<AttributeTemplate>(*prefab);
+    for (auto* object : users) {
+      Detach(*object).prefab = clone;
+    }
+    prefab = std::move(clone);
+  }
+  return *prefab;
+}
+
+// Moves each object to the index `positions` holds for it; `positions` is a
+// permutation of the objects' indices.
+inline void ReorderObjects(std::vector<std::shared_ptr<Object>>& objects,
+                           const std::vector<std::size_t>& positions) {
+  std::vector<std::shared_ptr<Object>> reordered(objects.size());
+  for (std::size_t i = 0; i < objects.size(); i++) {
+    reordered[positions[i]] = std::move(objects[i]);
+  }
+  objects = std::move(reordered);
+}
+
+// The format is picked from the extension: .vbscene is binary, anything else
+// is XML. Without `load_textures` only texture paths are read, which is all a
+// conversion needs and does not require an OpenGL context. The scene's
+// journal, if there is one, is replayed on top.
+Scene LoadScene(std::string_view path, bool load_textures = true);
+// Replaces the file atomically. `progress`, if given, is incremented as each
+// object is written.
+void SaveScene(const Scene& scene, std::string_view path,
+               std::atomic<std::size_t>* progress = nullptr);
+void ConvertScene(std::string_view from, std::string_view to);
+// Index of each prefab in `scene.prefabs`, which is how objects refer to
+// them on disk. Throws if two prefabs share a name.
+std::unordered_map<const AttributeTemplate*, std::uint32_t> PrefabIndices(
+    const Scene& scene);
+
+// A batch of objects read by ReadSceneChunks. Textures are not loaded.
+struct SceneChunk {
+  std::size_t total;  // Objects in the whole file
+  // Position of each object in the file, after the journal's edits
+  std::vector<std::size_t> indices;
+  std::vector<std::shared_ptr<Object>> objects;
+  // The scene's prefabs, in the first chunk only
+  std::vector<std::shared_ptr<AttributeTemplate>> prefabs;
+};
+
+// Reads the scene at `path` and hands it to `sink` in chunks of about
+// `chunk_size` objects, those nearest to `focus` first, with the scene's
+// journal replayed (see journal.h). Reading stops early when `sink` returns
+// false.
+void ReadSceneChunks(std::string_view path, glm::vec2 focus,
+                     std::size_t chunk_size,
+                     const std::function<bool(SceneChunk&&)>& sink);
@@ -0,0 +1,14 @@
+#ifndef SCENE_GENERATOR_H
+#define SCENE_GENERATOR_H
+#include <cstddef>
+#include <cstdint>
+
+#include "scene.h"
+
+// Builds a synthetic scene of `object_count` objects laid out on a grid:
+// every eighth object is a point light, the rest are sprites with color and
+// normal textures (unloaded, id 0). The same count and seed always produce the
+// same scene, on every platform, so benchmark results stay comparable.
+Scene GenerateScene(std::size_t object_count, std::uint64_t seed = 1);
+
+#endif  // SCENE_GENERATOR_H
@@ -0,0 +1,36 @@
+#ifndef SCENE_SAVE_H
+#define SCENE_SAVE_H
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "scene.h"
+
+// Saves a snapshot of the scene on a background thread. The snapshot shares
+// objects with the live scene; the editor must Detach() an object before
+// changing it so the save keeps seeing the state it started from.
+class SceneSave {
+ public:
+  SceneSave(Scene snapshot, std::string_view path);
+  SceneSave(const SceneSave&) = delete;
+  SceneSave& operator=(const SceneSave&) = delete;
+
+  // Fraction of the snapshot's objects written so far.
+  float Progress() const;
+  // Returns true once the save has finished, throwing if it failed.
+  bool Poll();
+  const std::string& Path() const { return path_; }
+
+ private:
+  Scene snapshot_;
+  std::string path_;
+  std::size_t total_;
+  std::atomic<std::size_t> written_ = 0;
+  std::atomic<bool> finished_ = false;
+  std::mutex mutex_;
+  std::string error_;
+  std::jthread worker_;
+};
+
+#endif  // SCENE_SAVE_H
@@ -0,0 +1,55 @@
+#ifndef SCENE_STREAM_H
+#define SCENE_STREAM_H
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "scene.h"
+
+// Loads a scene on a background thread and publishes it into the live scene a
+// chunk at a time, nearest to the view first, so the editor keeps rendering
+// while a large level comes in. The scene's journal is replayed on the
+// background thread before anything is published, so the scene can be edited
+// while it streams in. Once the stream is Done, the objects are to be put
+// back in file order, which is also draw order (see Journal::EndStream).
+class SceneStream {
+ public:
+  // Destroying the stream stops the reader after its current chunk.
+  SceneStream(std::string_view path, glm::vec2 focus);
+  SceneStream(const SceneStream&) = delete;
+  SceneStream& operator=(const SceneStream&) = delete;
+
+  // Moves parsed objects into `scene` and loads their textures until `budget`
+  // is spent. Throws if the background read failed.
+  void Publish(Scene& scene, std::chrono::microseconds budget);
+  // Fraction of the file's objects published so far.
+  float Progress() const;
+  bool Done() const;
+  const std::string& Path() const { return path_; }
+  // Position in the file of each object published so far, in the order they
+  // were published.
+  const std::vector<std::size_t>& FileOrder() const { return file_order_; }
+
+ private:
+  void Read(const std::stop_token& stop, std::string path, glm::vec2 focus);
+  void LoadTextures(
+      std::vector<std::pair<std::string, AttributeData>>& attributes);
+
+  std::string path_;
+  mutable std::mutex mutex_;
+  std::deque<SceneChunk> chunks_;
+  std::string error_;
+  std::atomic<bool> finished_ = false;
+  std::atomic<std::size_t> total_ = 0;
+  std::vector<std::size_t> file_order_;
+  // By path handle
+  std::unordered_map<std::uint32_t, unsigned int> textures_;
+  std::jthread worker_;
+};
+
+#endif  // SCENE_STREAM_H
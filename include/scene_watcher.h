@@ -0,0 +1,107 @@
+#ifndef SCENE_WATCHER_H
+#define SCENE_WATCHER_H
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "scene.h"
+#include "simulation.h"
+
+// How the live scene differs from a reloaded file. Objects are matched by
+// stable identity: their name and how many objects before them have the same
+// name, so an object keeps its identity when others are added or removed
+// around it. Prefabs are matched by name.
+struct SceneDiff {
+  static constexpr std::size_t kNew = ~std::size_t{0};
+
+  // For each of the file's objects, the index of the live object it is, or
+  // kNew
+  std::vector<std::size_t> sources;
+  // Indices of the live objects the file no longer has, ascending
+  std::vector<std::size_t> removed;
+  // File indices of objects whose live object differs, ascending
+  std::vector<std::size_t> changed;
+  std::size_t added = 0;
+  // The objects kept are in another order than the file's
+  bool reordered = false;
+
+  bool Empty() const {
+    return removed.empty() && changed.empty() && added == 0 && !reordered;
+  }
+};
+
+// Watches a scene file for changes made outside the editor (inotify on the
+// file's directory on Linux, which also sees files replaced by a rename;
+// polling its size and modification time elsewhere). Once writes to it have
+// settled, the file is re-parsed, without textures, and diffed against a
+// snapshot of the live scene, both on a background thread, so the editor
+// only has to apply the differences.
+class SceneWatcher {
+ public:
+  struct Reload {
+    Scene file;
+    SceneDiff diff;
+  };
+
+  // The file as it is now is taken to be the live scene's.
+  explicit SceneWatcher(std::string_view path);
+  SceneWatcher(const SceneWatcher&) = delete;
+  SceneWatcher& operator=(const SceneWatcher&) = delete;
+
+  // Returns the file and its diff against `live` once both are ready; a
+  // diff made against objects that have since been edited is redone. Throws
+  // if the file could not be read, as when a tool is still writing it; the
+  // next change is reloaded again.
+  std::optional<Reload> Poll(const Scene& live);
+  // The editor just wrote the file itself: it is not reloaded.
+  void Ignore();
+  const std::string& Path() const { return path_; }
+
+ private:
+  struct Stamp {
+    std::uintmax_t size;
+    std::int64_t modified;
+    bool operator==(const Stamp&) const = default;
+  };
+
+  // Of the reload in progress
+  enum class State { kIdle, kWaitingForSnapshot, kDiffing, kReady, kStale };
+
+  static Stamp FileStamp(const std::string& path);
+  void Watch(const std::stop_token& stop);
+  void Load(const std::stop_token& stop);
+
+  std::string path_;
+  std::mutex mutex_;
+  std::condition_variable_any changed_;
+  State state_ = State::kIdle;
+  // Handed by Poll for the worker to diff against
+  std::optional<Scene> snapshot_;
+  std::optional<Reload> reload_;
+  Stamp reload_stamp_{};
+  // The snapshot's objects, which the live scene must still have for the
+  // diff to apply
+  std::vector<std::shared_ptr<Object>> base_;
+  Stamp ignored_;
+  std::string error_;
+  std::jthread worker_;
+};
+
+// Texture ids are ignored: only paths are compared. Reads only the live
+// objects and their prefabs' names, so it may run on a snapshot.
+SceneDiff DiffScenes(const Scene& live, const Scene& file);
+// Makes the live scene match `file` by applying `diff`, which DiffScenes made
+// from the two, and queues the same changes to the simulation. Prefabs, which
+// the editor changes in place, are compared here, by name. Unchanged objects
+// and prefabs are kept as they are, textures included; textures are loaded
+// only for paths the live scene does not use. Prefabs the file no longer has
+// are kept, as indices into the prefab list must stay valid. Takes objects
+// and prefabs out of `file`.
+void ApplySceneDiff(Scene& live, Scene& file, const SceneDiff& diff,
+                    Simulation& simulation);
+
+#endif  // SCENE_WATCHER_H
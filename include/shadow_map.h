@@ -0,0 +1,63 @@
+#ifndef SHADOW_MAP_H
+#define SHADOW_MAP_H
+#include <array>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "render_proxy.h"
+
+// 1D polar shadow maps for point lights. Each light gets one row of the atlas
+// (the row of its index), holding for every direction around the light the
+// distance to the nearest occluder edge. Lighting works in screen texture
+// coordinates (see deferred_fragment.glsl), so occluders are projected there
+// first.
+//
+// A light's map is only redrawn when the light or an occluder within its reach
+// moved, and at most `refresh_limit` maps per Update; the rest keep their old
+// shadows until their turn comes.
+class ShadowMaps {
+ public:
+  // Directions per map.
+  static constexpr std::size_t kResolution = 256;
+  // Rows in the atlas; MAX_LIGHTS in deferred_fragment.glsl.
+  static constexpr std::size_t kMaxLights = 64;
+  // Stored for directions without an occluder
+  static constexpr float kNoOccluder = 4.0F;
+
+  explicit ShadowMaps(std::size_t refresh_limit);
+
+  // Returns true if any map was redrawn.
+  bool Update(std::span<const LightProxy> lights,
+              std::span<const OccluderProxy> occluders,
+              const glm::mat4& view_projection);
+  // kMaxLights rows of kResolution distances.
+  std::span<const float> Atlas() const { return atlas_; }
+
+ private:
+  struct Quad {
+    std::array<glm::vec2, 4> corners;
+    glm::vec2 min;
+    glm::vec2 max;
+  };
+  struct Row {
+    std::size_t signature = 0;
+    bool drawn = false;
+  };
+
+  // Hash of the light and the occluders it reaches; a change means redraw.
+  std::size_t Signature(const LightProxy& light) const;
+  void Draw(std::size_t row, const LightProxy& light);
+
+  std::size_t refresh_limit_;
+  // Occluders in texture coordinates, updated every frame
+  std::vector<Quad> quads_;
+  std::vector<Row> rows_;
+  // Where the next refresh starts looking, so no light waits forever
+  std::size_t next_ = 0;
+  std::vector<float> atlas_;
+};
+
+#endif  // SHADOW_MAP_H
@@ -0,0 +1,124 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "render_proxy.h"
+#include "scene.h"
+
+// Everything the renderer draws, as of one simulation tick.
+struct RenderState {
+  std::vector<SpriteProxy> sprites;
+  std::vector<LightProxy> lights;
+  std::vector<OccluderProxy> occluders;
+  std::vector<EmitterProxy> emitters;
+};
+
+// Updates the scene on its own thread at a fixed timestep. The update thread
+// keeps its own list of the scene's objects, which the editor changes by
+// queueing commands, and publishes a RenderState after each tick that changed
+// something. The list shares the editor's objects and prefabs: the editor
+// only changes them after detaching them (see Detach and DetachPrefab), so
+// both threads read them without copying. A tick that applied commands
+// copies only the proxies that changed into the state it publishes.
+//
+// States are triple buffered: the update thread always has one to write, the
+// renderer always has a complete one to read, and publishing or picking up
+// the newest is a single atomic exchange, so neither side waits on the other.
+class Simulation {
+ public:
+  explicit Simulation(std::chrono::nanoseconds timestep);
+  Simulation(const Simulation&) = delete;
+  Simulation& operator=(const Simulation&) = delete;
+
+  // Editor side. Indices are those of the editor's scene, which the update
+  // thread's list follows command by command.
+  void Reset(const Scene& scene);
+  void SetObject(const Scene& scene, std::size_t index);
+  // Inserts `scene.objects[first, first + count)` at `first`.
+  void InsertObjects(const Scene& scene, std::size_t first, std::size_t count);
+  void EraseObject(std::size_t index);
+  // Moves each object to the index `positions` holds for it, as
+  // ReorderObjects did to the editor's scene.
+  void Reorder(std::vector<std::size_t> positions);
+  // A prefab index past the update thread's last prefab appends. The objects
+  // using the prefab are taken along, as DetachPrefab replaces them.
+  void SetPrefab(const Scene& scene, std::size_t index);
+
+  // Renderer side: the newest published state, valid until the next call.
+  const RenderState& Acquire();
+
+  // Bytes the update thread holds besides what it shares with the editor's
+  // scene: its object list, objects only it still holds, its proxies and the
+  // published states. As of the last tick that applied commands.
+  std::size_t MemoryBytes() const {
+    return memory_bytes_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct ResetCommand {
+    Scene scene;
+  };
+  struct InsertCommand {
+    std::size_t first;
+    std::vector<std::shared_ptr<Object>> objects;
+  };
+  struct SetObjectCommand {
+    std::size_t index;
+    std::shared_ptr<Object> object;
+  };
+  struct EraseCommand {
+    std::size_t index;
+  };
+  struct ReorderCommand {
+    std::vector<std::size_t> positions;
+  };
+  struct SetPrefabCommand {
+    std::size_t index;
+    std::shared_ptr<AttributeTemplate> prefab;
+    // Index and object of each of its users
+    std::vector<std::pair<std::size_t, std::shared_ptr<Object>>> users;
+  };
+  using Command =
+      std::variant<ResetCommand, InsertCommand, SetObjectCommand, EraseCommand,
+                   ReorderCommand, SetPrefabCommand>;
+
+  // The shared buffer index, with kFresh set while it holds a state the
+  // renderer has not picked up yet
+  static constexpr std::uint8_t kIndexMask = 0x3;
+  static constexpr std::uint8_t kFresh = 0x4;
+
+  void Push(Command command);
+  void Run(const std::stop_token& stop);
+  void Apply(Command& command);
+  void Publish();
+  void MeasureMemory();
+
+  std::chrono::nanoseconds timestep_;
+  std::mutex mutex_;
+  std::vector<Command> commands_;
+
+  // Update thread only
+  Scene scene_;
+  RenderProxies proxies_;
+  std::uint8_t back_ = 1;
+  // What each state is missing of the proxies
+  std::array<RenderProxies::Changes, 3> stale_;
+
+  std::array<RenderState, 3> states_;
+  std::atomic<std::uint8_t> shared_ = 2;
+  std::uint8_t front_ = 0;  // Renderer only
+  std::atomic<std::size_t> memory_bytes_ = 0;
+
+  std::jthread worker_;
+};
+
+#endif  // SIMULATION_H
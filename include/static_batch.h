@@ -0,0 +1,98 @@
+#ifndef STATIC_BATCH_H
+#define STATIC_BATCH_H
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "render_proxy.h"
+#include "texture_atlas.h"
+
+// Opaque sprites tagged "static" (tiles and other level art) baked into one
+// vertex buffer per chunk of the world, kChunkSize units square, by where
+// their centres are. A chunk's quads are transformed once and grouped by
+// atlas page, or by texture for sprites the atlas could not pack, so a
+// visible chunk is one draw call per page and unpacked texture it uses
+// instead of one per sprite; chunks outside the view are not drawn. A chunk
+// is rebuilt only when one of its sprites was added, removed or changed, or
+// the atlas was repacked.
+class StaticBatches {
+ public:
+  // In world units: 32x32 unit-sized tiles
+  static constexpr float kChunkSize = 32.0F;
+
+  struct Stats {
+    std::size_t chunks = 0;
+    std::size_t sprites = 0;
+    // By the last Update
+    std::size_t rebuilt = 0;
+    // By the last Draw
+    std::size_t drawn = 0;
+    std::size_t draw_calls = 0;
+  };
+
+  StaticBatches() = default;
+  StaticBatches(const StaticBatches&) = delete;
+  StaticBatches& operator=(const StaticBatches&) = delete;
+  ~StaticBatches();
+
+  // Whether the sprite is drawn by a batch rather than on its own
+  static bool Batched(const SpriteProxy& sprite) {
+    return sprite.is_static && !sprite.is_transparent;
+  }
+
+  // Takes the frame's sprites and rebuilds the chunks whose batched sprites
+  // differ from last time, placing their texture coordinates in `atlas` if
+  // it is given.
+  void Update(std::span<const SpriteProxy> sprites, const TextureAtlas* atlas);
+  // Draws the chunks in view with the sprite shader, which must be bound
+  // with the atlas (see Renderer::DrawLayers), sampling `texture` where the
+  // color texture's alpha covers them.
+  void Draw(const glm::mat4& view_projection, unsigned int shader,
+            unsigned int SpriteProxy::*texture);
+  // Releases every chunk, to be rebuilt by the next Update.
+  void Clear();
+
+  const Stats& GetStats() const { return stats_; }
+
+ private:
+  // Sprites on the same atlas page, or sharing textures, drawn in one call
+  struct Group {
+    // Below 0 for sprites drawn with their own textures
+    int layer;
+    unsigned int color_texture;
+    unsigned int normal_texture;
+    int first_vertex;
+    int vertex_count;
+  };
+
+  struct Chunk {
+    // Batched last Update, and being collected by this one
+    std::vector<SpriteProxy> sprites;
+    std::vector<SpriteProxy> incoming;
+    std::vector<Group> groups;
+    // TextureAtlas::Generation plus one, or 0 without the atlas
+    std::uint64_t atlas_generation = 0;
+    unsigned int vertex_buffer = 0;
+    unsigned int vertex_array = 0;
+    // Bounds of the quads, z being the layer
+    glm::vec3 low = glm::vec3(0.0F);
+    glm::vec3 high = glm::vec3(0.0F);
+  };
+
+  void Build(Chunk& chunk, const TextureAtlas* atlas);
+  void Release(Chunk& chunk);
+  bool Visible(const Chunk& chunk, const glm::mat4& view_projection) const;
+
+  // Keyed by the chunk's grid cell, x in the high 32 bits and y in the low
+  std::unordered_map<std::uint64_t, Chunk> chunks_;
+  std::vector<std::uint32_t> order_;
+  std::vector<const TextureAtlas::Entry*> entries_;
+  std::vector<float> vertices_;
+  Stats stats_;
+};
+
+#endif  // STATIC_BATCH_H
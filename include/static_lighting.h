@@ -0,0 +1,81 @@
+#ifndef STATIC_LIGHTING_H
+#define STATIC_LIGHTING_H
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "render_proxy.h"
+
+// Lights tagged "static" are baked into a lightmap the size of the lighting
+// pass (screen texture coordinates, see deferred_fragment.glsl), holding per
+// pixel the light that reaches a white albedo ("diffuse") and the light added
+// regardless of albedo ("volumetric"). The diffuse light depends on the
+// normals of the sprites tagged "static"; other sprites are lit by static
+// lights as if they had those normals. Static lights cast no shadows.
+//
+// StaticLighting decides what to re-bake: it keeps the static sprites and
+// lights of the last bake and compares them with each frame's.
+class StaticLighting {
+ public:
+  // Pixels of the lightmap, last exclusive.
+  struct Region {
+    glm::ivec2 first;
+    glm::ivec2 last;
+
+    bool Empty() const { return first.x >= last.x || first.y >= last.y; }
+  };
+
+  // Takes the frame's static sprites and lights and returns the region in
+  // which the lightmap, `size` pixels, no longer matches them: everything
+  // after a change of size, view or clear color (to which the normal buffer is
+  // cleared), otherwise where changed sprites and lights reach.
+  Region Update(std::span<const SpriteProxy> sprites,
+                std::span<const LightProxy> lights,
+                const glm::mat4& view_projection, glm::vec3 clear_color,
+                glm::ivec2 size);
+  // Makes the next Update return the whole lightmap.
+  void Invalidate() { size_ = {0, 0}; }
+  // The static sprites and lights of the last Update, in order.
+  std::span<const SpriteProxy> Sprites() const { return sprites_; }
+  std::span<const LightProxy> Lights() const { return lights_; }
+  // Identifies what the last Update's lightmap looks like. Textures count by
+  // path, as their ids differ between runs.
+  std::uint64_t Signature() const;
+
+ private:
+  // The lightmap pixels covered by the sprite and the light.
+  Region Cover(const SpriteProxy& sprite) const;
+  Region Cover(const LightProxy& light) const;
+  void Include(Region& region, Region added) const;
+
+  std::vector<SpriteProxy> sprites_;
+  std::vector<LightProxy> lights_;
+  // The frame's, swapped with the above on Update
+  std::vector<SpriteProxy> incoming_sprites_;
+  std::vector<LightProxy> incoming_lights_;
+  glm::mat4 view_projection_ = glm::mat4(0.0F);
+  glm::vec3 clear_color_ = glm::vec3(-1.0F);
+  glm::ivec2 size_ = {0, 0};
+};
+
+// A baked lightmap, as saved next to its scene.
+struct LightmapFile {
+  std::uint64_t signature = 0;
+  glm::ivec2 size = {0, 0};
+  // RGBA per pixel, bottom row first
+  std::vector<float> diffuse;
+  std::vector<float> volumetric;
+};
+
+// Where the lightmap of the scene at `scene_path` is saved.
+std::string LightmapPath(std::string_view scene_path);
+// Both throw std::runtime_error if the file cannot be read or written.
+LightmapFile LoadLightmap(const std::string& path);
+void SaveLightmap(const std::string& path, const LightmapFile& lightmap);
+
+#endif  // STATIC_LIGHTING_H
@@ -1,11 +1,29 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
+
+// Texture paths are interned: a texture attribute holds a 4-byte handle
+// instead of the string, so attributes stay small and copy no strings. The
+// same path always gets the same handle, and handle 0 is the empty path.
+// Safe to use from any thread; paths are never released.
+std::uint32_t InternTexturePath(std::string_view path);
+const std::string& TexturePath(std::uint32_t handle);
+// Heap bytes of the interned paths and their index, for the memory report
+std::size_t TexturePathBytes();
 
 struct Texture {
   unsigned int id;
-  std::string path;
+  // See InternTexturePath
+  std::uint32_t path;
+
+  const std::string& Path() const { return TexturePath(path); }
 };
 
-Texture LoadTexture(const std::string& path);
+Texture LoadTexture(std::string_view path);
+// Size of the image's pixels as LoadTexture would upload them, from its
+// header alone; 0 if it cannot be read.
+std::size_t TextureFileBytes(const std::string& path);
 #endif  // TEXTURE_H
@@ -0,0 +1,76 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "render_proxy.h"
+
+// The color and normal textures of the frame's sprites, packed into the
+// layers ("pages") of two GL_TEXTURE_2D_ARRAYs, one for colors and one for
+// normals, at the same place in both. Sprites whose textures are packed are
+// drawn from the arrays, which stay bound for the whole pass, with a
+// sub-rectangle and layer instead of binding their own textures; this also
+// lets StaticBatches draw a chunk's packed sprites in one call per page.
+//
+// Only pairs whose color and normal textures are the same size are packed,
+// each with a one-texel border repeating its edges, which keeps
+// GL_CLAMP_TO_EDGE sampling. The rest, and pairs that do not fit in
+// kMaxPages, keep their own textures. Textures are copied from the GL
+// objects LoadTexture made, which stay loaded for the editor and the
+// sprites that are not packed.
+class TextureAtlas {
+ public:
+  static constexpr int kPageSize = 2048;
+  static constexpr int kMaxPages = 8;
+
+  struct Entry {
+    // Offset (x, y) and scale (z, w) from the sprite's texture coordinates
+    // to the page's
+    glm::vec4 rect;
+    int layer;
+  };
+
+  TextureAtlas() = default;
+  TextureAtlas(const TextureAtlas&) = delete;
+  TextureAtlas& operator=(const TextureAtlas&) = delete;
+  ~TextureAtlas();
+
+  // Packs the sprites' texture pairs that were not seen before, which
+  // repacks every pair so the most fit. Returns true if it did.
+  bool Update(std::span<const SpriteProxy> sprites);
+  // The pair's place in the arrays, or null if it is not packed.
+  const Entry* Find(unsigned int color_texture,
+                    unsigned int normal_texture) const;
+
+  // 0 until something has been packed
+  unsigned int ColorArray() const { return color_array_; }
+  unsigned int NormalArray() const { return normal_array_; }
+  // Changes whenever entries move
+  std::uint64_t Generation() const { return generation_; }
+  std::size_t Packed() const { return packed_; }
+  int Pages() const { return pages_; }
+
+ private:
+  static std::uint64_t Key(unsigned int color_texture,
+                           unsigned int normal_texture) {
+    return (std::uint64_t{color_texture} << 32U) | normal_texture;
+  }
+
+  void Pack();
+  void Release();
+
+  // Every pair seen, and where it is if packed
+  std::unordered_map<std::uint64_t, std::optional<Entry>> pairs_;
+  unsigned int color_array_ = 0;
+  unsigned int normal_array_ = 0;
+  std::uint64_t generation_ = 0;
+  std::size_t packed_ = 0;
+  int pages_ = 0;
+};
+
+#endif  // TEXTURE_ATLAS_H
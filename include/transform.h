@@ -1,8 +1,17 @@
 #pragma once
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 struct Transform {
   glm::vec3 position;
   glm::vec3 scale;
   float rotation;
 };
+
+// Translation, then rotation about Z (in degrees), then scale.
+inline glm::mat4 ModelMatrix(const Transform& transform) {
+  auto model = glm::translate(glm::mat4(1.0F), transform.position);
+  model = glm::rotate(model, glm::radians(transform.rotation),
+                      glm::vec3(0.0F, 0.0F, 1.0F));
+  return glm::scale(model, transform.scale);
+}
@@ -1,7 +1,10 @@
 #ifndef TUTORIAL_H
 #define TUTORIAL_H
-#include "scene.h"
+#include <functional>
+#include <string_view>
 
-void TutorialWindow(bool& show, Scene& scene);
+// `load_scene` is called with the path of the test scene.
+void TutorialWindow(bool& show,
+                    const std::function<void(std::string_view)>& load_scene);
 
 #endif  // TUTORIAL_H
@@ -0,0 +1,336 @@
+#include "asset_pack.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+using asset_pack::Compression;
+using asset_pack::EntryRecord;
+using asset_pack::Header;
+
+namespace {
+// LZ4 block format constants
+constexpr std::size_t kMinMatch = 4;
+// The last literals and the distance of the last match from the end
+constexpr std::size_t kLastLiterals = 5;
+constexpr std::size_t kMatchLimit = 12;
+constexpr std::size_t kMaxOffset = 65535;
+constexpr int kHashBits = 14;
+
+std::unique_ptr<AssetPack> mounted_pack;
+
+std::uint32_t Read32(const std::byte* data) {
+  std::uint32_t value;
+  std::copy_n(data, sizeof(value), reinterpret_cast<std::byte*>(&value));
+  return value;
+}
+
+std::uint32_t Hash(std::uint32_t sequence) {
+  return (sequence * 2654435761U) >> (32 - kHashBits);
+}
+
+// A length nibble of 15 continues in bytes of up to 255
+void WriteLength(std::vector<std::byte>& out, std::size_t length) {
+  for (; length >= 255; length -= 255) {
+    out.push_back(std::byte{255});
+  }
+  out.push_back(static_cast<std::byte>(length));
+}
+
+void WriteSequence(std::vector<std::byte>& out,
+                   std::span<const std::byte> literals, std::size_t offset,
+                   std::size_t match_length) {
+  auto literal_nibble = std::min<std::size_t>(literals.size(), 15);
+  auto match_nibble =
+      match_length == 0 ? 0 : std::min<std::size_t>(match_length - kMinMatch, 15);
+  out.push_back(static_cast<std::byte>((literal_nibble << 4U) | match_nibble));
+  if (literal_nibble == 15) {
+    WriteLength(out, literals.size() - 15);
+  }
+  out.insert(out.end(), literals.begin(), literals.end());
+  if (match_length == 0) {
+    return;
+  }
+  out.push_back(static_cast<std::byte>(offset & 0xFFU));
+  out.push_back(static_cast<std::byte>(offset >> 8U));
+  if (match_nibble == 15) {
+    WriteLength(out, match_length - kMinMatch - 15);
+  }
+}
+
+std::vector<std::byte> ReadWholeFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + path);
+  }
+  std::vector<std::byte> data(static_cast<std::size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(data.data()),
+            static_cast<std::streamsize>(data.size()));
+  if (!file) {
+    throw std::runtime_error("Failed to read file: " + path);
+  }
+  return data;
+}
+
+std::size_t Align(std::size_t offset) {
+  return (offset + asset_pack::kAlignment - 1) &
+         ~(asset_pack::kAlignment - 1);
+}
+}  // namespace
+
+std::vector<std::byte> Lz4Compress(std::span<const std::byte> source) {
+  std::vector<std::byte> out;
+  out.reserve(source.size() + (source.size() / 255) + 16);
+  // Last position each hashed 4-byte sequence was seen at, plus one
+  std::vector<std::size_t> table(std::size_t{1} << kHashBits, 0);
+  std::size_t anchor = 0;
+  std::size_t i = 0;
+  while (source.size() >= kMatchLimit && i <= source.size() - kMatchLimit) {
+    auto sequence = Read32(source.data() + i);
+    auto& slot = table[Hash(sequence)];
+    auto candidate = slot;
+    slot = i + 1;
+    if (candidate == 0 || i - (candidate - 1) > kMaxOffset ||
+        Read32(source.data() + candidate - 1) != sequence) {
+      i++;
+      continue;
+    }
+    auto match = candidate - 1;
+    auto length = kMinMatch;
+    while (i + length < source.size() - kLastLiterals &&
+           source[match + length] == source[i + length]) {
+      length++;
+    }
+    WriteSequence(out, source.subspan(anchor, i - anchor), i - match, length);
+    i += length;
+    anchor = i;
+  }
+  WriteSequence(out, source.subspan(anchor), 0, 0);
+  return out;
+}
+
+void Lz4Decompress(std::span<const std::byte> source,
+                   std::span<std::byte> target) {
+  std::size_t in = 0;
+  std::size_t out = 0;
+  auto read_length = [&](std::size_t length) {
+    if (length != 15) {
+      return length;
+    }
+    for (;;) {
+      if (in >= source.size()) {
+        throw std::runtime_error("Corrupt LZ4 block: truncated length");
+      }
+      auto more = static_cast<std::size_t>(source[in++]);
+      length += more;
+      if (more != 255) {
+        return length;
+      }
+    }
+  };
+  while (in < source.size()) {
+    auto token = static_cast<std::size_t>(source[in++]);
+    auto literals = read_length(token >> 4U);
+    if (literals > source.size() - in || literals > target.size() - out) {
+      throw std::runtime_error("Corrupt LZ4 block: literals out of bounds");
+    }
+    std::copy_n(source.data() + in, literals, target.data() + out);
+    in += literals;
+    out += literals;
+    // The last sequence has no match
+    if (in == source.size()) {
+      break;
+    }
+    if (source.size() - in < 2) {
+      throw std::runtime_error("Corrupt LZ4 block: truncated offset");
+    }
+    auto offset = static_cast<std::size_t>(source[in]) |
+                  (static_cast<std::size_t>(source[in + 1]) << 8U);
+    in += 2;
+    auto length = read_length(token & 0xFU) + kMinMatch;
+    if (offset == 0 || offset > out || length > target.size() - out) {
+      throw std::runtime_error("Corrupt LZ4 block: match out of bounds");
+    }
+    // Byte by byte, as the match may overlap what it produces
+    for (std::size_t j = 0; j < length; j++, out++) {
+      target[out] = target[out - offset];
+    }
+  }
+  if (out != target.size()) {
+    throw std::runtime_error("Corrupt LZ4 block: wrong decompressed size");
+  }
+}
+
+AssetPack::AssetPack(std::string_view path) : file_(path) {
+  auto section = [&](std::uint64_t offset, std::uint64_t size) {
+    if (offset > file_.Size() || size > file_.Size() - offset) {
+      throw std::runtime_error("Corrupt asset pack: section out of bounds");
+    }
+    return file_.Data() + offset;
+  };
+  if (file_.Size() < sizeof(Header)) {
+    throw std::runtime_error("Not an asset pack: " + std::string(path));
+  }
+  const auto& header = *reinterpret_cast<const Header*>(file_.Data());
+  if (header.magic != asset_pack::kMagic) {
+    throw std::runtime_error("Not an asset pack: " + std::string(path));
+  }
+  if (header.version != asset_pack::kVersion) {
+    throw std::runtime_error("Unsupported asset pack version: " +
+                             std::to_string(header.version));
+  }
+  if (header.entries_offset % alignof(EntryRecord) != 0) {
+    throw std::runtime_error("Corrupt asset pack: misaligned entries");
+  }
+  entries_ = {reinterpret_cast<const EntryRecord*>(section(
+                  header.entries_offset,
+                  std::uint64_t{header.entry_count} * sizeof(EntryRecord))),
+              header.entry_count};
+  path_data_ = {reinterpret_cast<const char*>(
+                    section(header.path_data_offset, header.path_data_size)),
+                header.path_data_size};
+  for (const auto& entry : entries_) {
+    if (entry.path_offset > path_data_.size() ||
+        entry.path_length > path_data_.size() - entry.path_offset) {
+      throw std::runtime_error("Corrupt asset pack: bad path");
+    }
+    section(entry.offset, entry.stored_size);
+    if (entry.compression == Compression::kNone
+            ? entry.stored_size != entry.size
+            : entry.compression != Compression::kLz4) {
+      throw std::runtime_error("Corrupt asset pack: bad entry " +
+                               std::string(Path(entry)));
+    }
+  }
+}
+
+const EntryRecord* AssetPack::Find(std::string_view path) const {
+  auto it = std::ranges::lower_bound(
+      entries_, path, {},
+      [&](const EntryRecord& entry) { return Path(entry); });
+  return it != entries_.end() && Path(*it) == path ? &*it : nullptr;
+}
+
+std::string_view AssetPack::Path(const EntryRecord& entry) const {
+  return path_data_.substr(entry.path_offset, entry.path_length);
+}
+
+std::span<const std::byte> AssetPack::Stored(const EntryRecord& entry) const {
+  return {file_.Data() + entry.offset, entry.stored_size};
+}
+
+void SaveAssetPack(std::string_view output, std::span<const std::string> paths,
+                   bool compress) {
+  std::vector<std::pair<std::string, std::string>> files;  // Name, path
+  for (const auto& path : paths) {
+    files.emplace_back(AssetPath(path), path);
+  }
+  std::ranges::sort(files);
+  auto duplicate = std::ranges::adjacent_find(
+      files, {}, [](const auto& file) -> const std::string& { return file.first; });
+  if (duplicate != files.end()) {
+    throw std::runtime_error("Asset packed twice: " + duplicate->first);
+  }
+
+  std::vector<EntryRecord> entries(files.size());
+  std::string path_data;
+  for (std::size_t i = 0; i < files.size(); i++) {
+    entries[i].path_offset = static_cast<std::uint32_t>(path_data.size());
+    entries[i].path_length = static_cast<std::uint32_t>(files[i].first.size());
+    path_data += files[i].first;
+  }
+  Header header{.magic = asset_pack::kMagic,
+                .version = asset_pack::kVersion,
+                .entry_count = static_cast<std::uint32_t>(entries.size()),
+                .path_data_size = static_cast<std::uint32_t>(path_data.size()),
+                .entries_offset = sizeof(Header),
+                .path_data_offset = 0};
+  header.path_data_offset =
+      header.entries_offset + (entries.size() * sizeof(EntryRecord));
+
+  std::ofstream file(std::string(output), std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + std::string(output));
+  }
+  // The records are written last, once the data offsets are known
+  file.seekp(static_cast<std::streamoff>(header.path_data_offset));
+  file.write(path_data.data(), static_cast<std::streamsize>(path_data.size()));
+  auto offset = header.path_data_offset + path_data.size();
+  for (std::size_t i = 0; i < files.size(); i++) {
+    auto data = ReadWholeFile(files[i].second);
+    auto& entry = entries[i];
+    entry.size = data.size();
+    entry.compression = Compression::kNone;
+    if (compress) {
+      auto compressed = Lz4Compress(data);
+      if (compressed.size() < data.size()) {
+        data = std::move(compressed);
+        entry.compression = Compression::kLz4;
+      }
+    }
+    entry.stored_size = data.size();
+    entry.offset = Align(offset);
+    static constexpr std::array<char, asset_pack::kAlignment> kPadding{};
+    file.write(kPadding.data(),
+               static_cast<std::streamsize>(entry.offset - offset));
+    file.write(reinterpret_cast<const char*>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+    offset = entry.offset + entry.stored_size;
+  }
+  file.seekp(0);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(entries.data()),
+             static_cast<std::streamsize>(entries.size() * sizeof(EntryRecord)));
+  if (!file) {
+    throw std::runtime_error("Failed to write asset pack: " +
+                             std::string(output));
+  }
+}
+
+std::string AssetPath(std::string_view path) {
+  return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+void MountAssetPack(std::string_view path) {
+  mounted_pack = std::make_unique<AssetPack>(path);
+}
+
+std::optional<Asset> FindAsset(std::string_view path, bool prefer_loose) {
+  auto from_pack = [&]() -> std::optional<Asset> {
+    const EntryRecord* entry =
+        mounted_pack ? mounted_pack->Find(AssetPath(path)) : nullptr;
+    if (entry == nullptr) {
+      return std::nullopt;
+    }
+    Asset asset;
+    asset.bytes_ = mounted_pack->Stored(*entry);
+    if (entry->compression == Compression::kLz4) {
+      asset.decompressed_.resize(entry->size);
+      Lz4Decompress(asset.bytes_, asset.decompressed_);
+      asset.bytes_ = asset.decompressed_;
+    }
+    return asset;
+  };
+  auto from_file = [&]() -> std::optional<Asset> {
+    if (!std::filesystem::is_regular_file(path)) {
+      return std::nullopt;
+    }
+    Asset asset;
+    asset.file_ = std::make_unique<MappedFile>(path);
+    asset.bytes_ = {asset.file_->Data(), asset.file_->Size()};
+    return asset;
+  };
+  if (prefer_loose) {
+    auto asset = from_file();
+    return asset ? std::move(asset) : from_pack();
+  }
+  auto asset = from_pack();
+  return asset ? std::move(asset) : from_file();
+}
+
+bool AssetExists(std::string_view path) {
+  return (mounted_pack && mounted_pack->Find(AssetPath(path)) != nullptr) ||
+         std::filesystem::is_regular_file(path);
+}
@@ -0,0 +1,305 @@
+#include "binary_scene.h"
+
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.h"
+#include "texture.h"
+
+using binary_scene::AttributeRecord;
+using binary_scene::AttributeType;
+using binary_scene::Header;
+using binary_scene::ObjectRecord;
+using binary_scene::PrefabRecord;
+using binary_scene::StringRecord;
+
+namespace {
+template <typename T>
+std::span<const T> Section(const MappedFile& file, std::uint32_t offset,
+                           std::uint32_t count) {
+  if (offset % alignof(T) != 0 || offset > file.Size() ||
+      count > (file.Size() - offset) / sizeof(T)) {
+    throw std::runtime_error("Corrupt binary scene: section out of bounds");
+  }
+  return {reinterpret_cast<const T*>(file.Data() + offset), count};
+}
+
+AttributeData Decode(const AttributeRecord& record,
+                     const std::vector<Texture>& textures) {
+  const auto& f = record.value.f;
+  switch (record.type) {
+    case AttributeType::kInt:
+      return record.value.i;
+    case AttributeType::kFloat:
+      return f[0];
+    case AttributeType::kVec2:
+      return glm::vec2(f[0], f[1]);
+    case AttributeType::kVec3:
+      return glm::vec3(f[0], f[1], f[2]);
+    case AttributeType::kVec4:
+      return glm::vec4(f[0], f[1], f[2], f[3]);
+    case AttributeType::kTexture:
+      if (record.value.texture >= textures.size()) {
+        throw std::runtime_error("Corrupt binary scene: bad texture index");
+      }
+      return textures[record.value.texture];
+  }
+  throw std::runtime_error("Unknown attribute type");
+}
+
+class StringTable {
+ public:
+  std::uint32_t Intern(std::string_view s) {
+    auto [it, inserted] = index_.try_emplace(s, records_.size());
+    if (inserted) {
+      records_.push_back({.offset = static_cast<std::uint32_t>(data_.size()),
+                          .length = static_cast<std::uint32_t>(s.size())});
+      data_ += s;
+    }
+    return it->second;
+  }
+  const std::vector<StringRecord>& Records() const { return records_; }
+  const std::string& Data() const { return data_; }
+
+ private:
+  // Keys point into the scene being saved, which outlives the table.
+  std::unordered_map<std::string_view, std::uint32_t> index_;
+  std::vector<StringRecord> records_;
+  std::string data_;
+};
+
+std::uint32_t Align(std::size_t offset) {
+  return static_cast<std::uint32_t>((offset + 3) & ~std::size_t{3});
+}
+
+template <typename T>
+void WriteSection(std::ofstream& file, std::uint32_t offset,
+                  const std::vector<T>& data) {
+  file.seekp(offset);
+  file.write(reinterpret_cast<const char*>(data.data()),
+             static_cast<std::streamsize>(data.size() * sizeof(T)));
+}
+}  // namespace
+
+Scene LoadBinaryScene(std::string_view path, bool load_textures) {
+  MappedFile file(path);
+  const auto& header = Section<Header>(file, 0, 1).front();
+  if (header.magic != binary_scene::kMagic) {
+    throw std::runtime_error("Not a binary scene: " + std::string(path));
+  }
+  if (header.version != binary_scene::kVersion) {
+    throw std::runtime_error("Unsupported binary scene version: " +
+                             std::to_string(header.version));
+  }
+  auto strings = Section<StringRecord>(file, header.strings_offset,
+                                       header.string_count);
+  auto string_data = Section<char>(file, header.string_data_offset,
+                                   header.string_data_size);
+  auto objects =
+      Section<ObjectRecord>(file, header.objects_offset, header.object_count);
+  auto prefab_records =
+      Section<PrefabRecord>(file, header.prefabs_offset, header.prefab_count);
+  auto attributes = Section<AttributeRecord>(file, header.attributes_offset,
+                                             header.attribute_count);
+  auto tags = Section<std::uint32_t>(file, header.tags_offset, header.tag_count);
+  auto texture_paths = Section<std::uint32_t>(file, header.textures_offset,
+                                              header.texture_count);
+
+  auto string = [&](std::uint32_t index) -> std::string_view {
+    if (index >= strings.size() ||
+        strings[index].offset > string_data.size() ||
+        strings[index].length > string_data.size() - strings[index].offset) {
+      throw std::runtime_error("Corrupt binary scene: bad string index");
+    }
+    return {string_data.data() + strings[index].offset, strings[index].length};
+  };
+
+  // Each distinct texture is loaded once and shared by every attribute using it
+  std::vector<Texture> textures;
+  textures.reserve(texture_paths.size());
+  for (auto path_index : texture_paths) {
+    auto texture_path = string(path_index);
+    textures.push_back(
+        load_textures
+            ? LoadTexture(texture_path)
+            : Texture{.id = 0U, .path = InternTexturePath(texture_path)});
+  }
+
+  auto decode_attributes =
+      [&](std::uint32_t first, std::uint32_t count,
+          std::vector<std::pair<std::string, AttributeData>>& decoded) {
+    if (first > attributes.size() || count > attributes.size() - first) {
+      throw std::runtime_error("Corrupt binary scene: attributes out of bounds");
+    }
+    decoded.reserve(count);
+    for (const auto& attribute : attributes.subspan(first, count)) {
+      decoded.emplace_back(string(attribute.name), Decode(attribute, textures));
+    }
+  };
+
+  Scene scene;
+  scene.prefabs.reserve(prefab_records.size());
+  for (const auto& record : prefab_records) {
+    auto prefab = std::make_shared<AttributeTemplate>();
+    prefab->name = string(record.name);
+    decode_attributes(record.first_attribute, record.attribute_count,
+                      prefab->attributes);
+    scene.prefabs.push_back(std::move(prefab));
+  }
+  scene.objects.reserve(objects.size());
+  for (const auto& record : objects) {
+    if (record.first_tag > tags.size() ||
+        record.tag_count > tags.size() - record.first_tag ||
+        (record.prefab != binary_scene::kNoPrefab &&
+         record.prefab >= scene.prefabs.size())) {
+      throw std::runtime_error("Corrupt binary scene: object out of bounds");
+    }
+    auto object = std::make_shared<Object>();
+    object->name = string(record.name);
+    if (record.prefab != binary_scene::kNoPrefab) {
+      object->prefab = scene.prefabs[record.prefab];
+    }
+    decode_attributes(record.first_attribute, record.attribute_count,
+                      object->attributes);
+    object->tags.reserve(record.tag_count);
+    for (auto tag : tags.subspan(record.first_tag, record.tag_count)) {
+      object->tags.emplace_back(string(tag));
+    }
+    scene.objects.push_back(std::move(object));
+  }
+  return scene;
+}
+
+void SaveBinaryScene(const Scene& scene, std::string_view path,
+                     std::atomic<std::size_t>* progress) {
+  auto prefab_index = PrefabIndices(scene);
+  StringTable strings;
+  // By path handle
+  std::unordered_map<std::uint32_t, std::uint32_t> texture_index;
+  std::vector<std::uint32_t> textures;
+  std::vector<ObjectRecord> objects;
+  std::vector<PrefabRecord> prefabs;
+  std::vector<AttributeRecord> attributes;
+  std::vector<std::uint32_t> tags;
+  objects.reserve(scene.objects.size());
+
+  auto encode_attributes =
+      [&](const std::vector<std::pair<std::string, AttributeData>>& list) {
+    for (const auto& [name, value] : list) {
+      AttributeRecord record{};
+      record.name = strings.Intern(name);
+      std::visit(
+          [&](const auto& v) {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, int>) {
+              record.type = AttributeType::kInt;
+              record.value.i = v;
+            } else if constexpr (std::is_same_v<T, float>) {
+              record.type = AttributeType::kFloat;
+              record.value.f[0] = v;
+            } else if constexpr (std::is_same_v<T, glm::vec2>) {
+              record.type = AttributeType::kVec2;
+              record.value.f = {v.x, v.y, 0.0F, 0.0F};
+            } else if constexpr (std::is_same_v<T, glm::vec3>) {
+              record.type = AttributeType::kVec3;
+              record.value.f = {v.x, v.y, v.z, 0.0F};
+            } else if constexpr (std::is_same_v<T, glm::vec4>) {
+              record.type = AttributeType::kVec4;
+              record.value.f = {v.x, v.y, v.z, v.w};
+            } else if constexpr (std::is_same_v<T, Texture>) {
+              record.type = AttributeType::kTexture;
+              auto [it, inserted] =
+                  texture_index.try_emplace(v.path, textures.size());
+              if (inserted) {
+                textures.push_back(strings.Intern(v.Path()));
+              }
+              record.value.texture = it->second;
+            }
+          },
+          value);
+      attributes.push_back(record);
+    }
+  };
+
+  for (const auto& prefab : scene.prefabs) {
+    prefabs.push_back(
+        {.name = strings.Intern(prefab->name),
+         .first_attribute = static_cast<std::uint32_t>(attributes.size()),
+         .attribute_count =
+             static_cast<std::uint32_t>(prefab->attributes.size())});
+    encode_attributes(prefab->attributes);
+  }
+  for (const auto& object : scene.objects) {
+    auto prefab = binary_scene::kNoPrefab;
+    if (object->prefab) {
+      auto it = prefab_index.find(object->prefab.get());
+      if (it == prefab_index.end()) {
+        throw std::runtime_error("Prefab is not part of the scene: " +
+                                 object->prefab->name);
+      }
+      prefab = it->second;
+    }
+    objects.push_back(
+        {.name = strings.Intern(object->name),
+         .first_attribute = static_cast<std::uint32_t>(attributes.size()),
+         .attribute_count =
+             static_cast<std::uint32_t>(object->attributes.size()),
+         .first_tag = static_cast<std::uint32_t>(tags.size()),
+         .tag_count = static_cast<std::uint32_t>(object->tags.size()),
+         .prefab = prefab});
+    encode_attributes(object->attributes);
+    for (const auto& tag : object->tags) {
+      tags.push_back(strings.Intern(tag));
+    }
+    if (progress != nullptr) {
+      (*progress)++;
+    }
+  }
+
+  Header header{};
+  header.magic = binary_scene::kMagic;
+  header.version = binary_scene::kVersion;
+  header.string_count = static_cast<std::uint32_t>(strings.Records().size());
+  header.string_data_size = static_cast<std::uint32_t>(strings.Data().size());
+  header.object_count = static_cast<std::uint32_t>(objects.size());
+  header.attribute_count = static_cast<std::uint32_t>(attributes.size());
+  header.tag_count = static_cast<std::uint32_t>(tags.size());
+  header.texture_count = static_cast<std::uint32_t>(textures.size());
+  header.prefab_count = static_cast<std::uint32_t>(prefabs.size());
+  header.strings_offset = Align(sizeof(Header));
+  header.string_data_offset = Align(
+      header.strings_offset + (header.string_count * sizeof(StringRecord)));
+  header.objects_offset =
+      Align(header.string_data_offset + header.string_data_size);
+  header.prefabs_offset = Align(
+      header.objects_offset + (header.object_count * sizeof(ObjectRecord)));
+  header.attributes_offset = Align(
+      header.prefabs_offset + (header.prefab_count * sizeof(PrefabRecord)));
+  header.tags_offset = Align(header.attributes_offset +
+                             (header.attribute_count * sizeof(AttributeRecord)));
+  header.textures_offset =
+      Align(header.tags_offset + (header.tag_count * sizeof(std::uint32_t)));
+
+  std::ofstream file{std::string(path), std::ios::binary | std::ios::trunc};
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + std::string(path));
+  }
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  WriteSection(file, header.strings_offset, strings.Records());
+  file.seekp(header.string_data_offset);
+  file.write(strings.Data().data(),
+             static_cast<std::streamsize>(strings.Data().size()));
+  WriteSection(file, header.objects_offset, objects);
+  WriteSection(file, header.prefabs_offset, prefabs);
+  WriteSection(file, header.attributes_offset, attributes);
+  WriteSection(file, header.tags_offset, tags);
+  WriteSection(file, header.textures_offset, textures);
+  if (!file) {
+    throw std::runtime_error("Failed to write binary scene: " +
+                             std::string(path));
+  }
+}
@@ -0,0 +1,613 @@
+#include "cpu_renderer.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VIBRANT_SSE
+#include <emmintrin.h>
+#endif
+
+#include <stb_image.h>
+
+#include "asset_pack.h"
+#include "renderer.h"
+
+namespace {
+// Same as the framebuffers in Renderer
+constexpr float kFramebufferScale = 0.1F;
+// Lights the shader looks at, MAX_LIGHTS in deferred_fragment.glsl
+constexpr std::size_t kMaxLights = ShadowMaps::kMaxLights;
+constexpr int kTileWidth = 32;
+constexpr int kTileHeight = 16;
+constexpr float kPi = std::numbers::pi_v<float>;
+// Same as in Renderer
+constexpr float kOpaqueCutoff = 0.5F;
+constexpr float kTransparentCutoff = 1.0F / 255.0F;
+
+// Lanes holds a float for each of several pixels, and Mask a comparison of
+// them; the lighting is written once against these.
+#if defined(__AVX2__)
+constexpr std::string_view kSimd = "AVX2";
+struct Mask {
+  __m256 v;
+};
+struct Lanes {
+  static constexpr int kWidth = 8;
+  __m256 v;
+
+  static Lanes Load(const float* p) { return {_mm256_loadu_ps(p)}; }
+  static Lanes Set(float s) { return {_mm256_set1_ps(s)}; }
+  static Lanes Ramp() { return {_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)}; }
+  void Store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+inline Lanes operator+(Lanes a, Lanes b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline Lanes operator-(Lanes a, Lanes b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline Lanes operator*(Lanes a, Lanes b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline Lanes operator/(Lanes a, Lanes b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline Lanes Min(Lanes a, Lanes b) { return {_mm256_min_ps(a.v, b.v)}; }
+inline Lanes Max(Lanes a, Lanes b) { return {_mm256_max_ps(a.v, b.v)}; }
+inline Lanes Sqrt(Lanes a) { return {_mm256_sqrt_ps(a.v)}; }
+inline Lanes Abs(Lanes a) {
+  return {_mm256_andnot_ps(_mm256_set1_ps(-0.0F), a.v)};
+}
+inline Mask operator<(Lanes a, Lanes b) {
+  return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)};
+}
+inline Lanes Select(Mask m, Lanes a, Lanes b) {
+  return {_mm256_blendv_ps(b.v, a.v, m.v)};
+}
+#elif defined(VIBRANT_SSE)
+constexpr std::string_view kSimd = "SSE2";
+struct Mask {
+  __m128 v;
+};
+struct Lanes {
+  static constexpr int kWidth = 4;
+  __m128 v;
+
+  static Lanes Load(const float* p) { return {_mm_loadu_ps(p)}; }
+  static Lanes Set(float s) { return {_mm_set1_ps(s)}; }
+  static Lanes Ramp() { return {_mm_setr_ps(0, 1, 2, 3)}; }
+  void Store(float* p) const { _mm_storeu_ps(p, v); }
+};
+inline Lanes operator+(Lanes a, Lanes b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Lanes operator-(Lanes a, Lanes b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline Lanes operator*(Lanes a, Lanes b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline Lanes operator/(Lanes a, Lanes b) { return {_mm_div_ps(a.v, b.v)}; }
+inline Lanes Min(Lanes a, Lanes b) { return {_mm_min_ps(a.v, b.v)}; }
+inline Lanes Max(Lanes a, Lanes b) { return {_mm_max_ps(a.v, b.v)}; }
+inline Lanes Sqrt(Lanes a) { return {_mm_sqrt_ps(a.v)}; }
+inline Lanes Abs(Lanes a) { return {_mm_andnot_ps(_mm_set1_ps(-0.0F), a.v)}; }
+inline Mask operator<(Lanes a, Lanes b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline Lanes Select(Mask m, Lanes a, Lanes b) {
+  return {_mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v))};
+}
+#else
+constexpr std::string_view kSimd = "scalar";
+struct Mask {
+  bool v;
+};
+struct Lanes {
+  static constexpr int kWidth = 1;
+  float v;
+
+  static Lanes Load(const float* p) { return {*p}; }
+  static Lanes Set(float s) { return {s}; }
+  static Lanes Ramp() { return {0.0F}; }
+  void Store(float* p) const { *p = v; }
+};
+inline Lanes operator+(Lanes a, Lanes b) { return {a.v + b.v}; }
+inline Lanes operator-(Lanes a, Lanes b) { return {a.v - b.v}; }
+inline Lanes operator*(Lanes a, Lanes b) { return {a.v * b.v}; }
+inline Lanes operator/(Lanes a, Lanes b) { return {a.v / b.v}; }
+inline Lanes Min(Lanes a, Lanes b) { return {std::min(a.v, b.v)}; }
+inline Lanes Max(Lanes a, Lanes b) { return {std::max(a.v, b.v)}; }
+inline Lanes Sqrt(Lanes a) { return {std::sqrt(a.v)}; }
+inline Lanes Abs(Lanes a) { return {std::abs(a.v)}; }
+inline Mask operator<(Lanes a, Lanes b) { return {a.v < b.v}; }
+inline Lanes Select(Mask m, Lanes a, Lanes b) { return m.v ? a : b; }
+#endif
+
+// GLSL's atan(y, x), to within 1e-5 radians.
+Lanes Atan2(Lanes y, Lanes x) {
+  auto zero = Lanes::Set(0.0F);
+  auto ax = Abs(x);
+  auto ay = Abs(y);
+  auto ratio = Min(ax, ay) / Max(Max(ax, ay), Lanes::Set(1e-30F));
+  auto s = ratio * ratio;
+  auto angle =
+      ((Lanes::Set(-0.0464964749F) * s + Lanes::Set(0.15931422F)) * s -
+       Lanes::Set(0.327622764F)) *
+          s * ratio +
+      ratio;
+  angle = Select(ax < ay, Lanes::Set(kPi / 2.0F) - angle, angle);
+  angle = Select(x < zero, Lanes::Set(kPi) - angle, angle);
+  return Select(y < zero, zero - angle, angle);
+}
+
+// ShadowFactor in deferred_fragment.glsl for `offset` from light `row`; the
+// atlas lookups are made one lane at a time.
+Lanes ShadowFactor(std::span<const float> atlas, std::size_t row, Lanes offset_x,
+                   Lanes offset_y, Lanes distance) {
+  constexpr auto kResolution = static_cast<float>(ShadowMaps::kResolution);
+  auto u = (Atan2(offset_y, offset_x) + Lanes::Set(kPi)) /
+           Lanes::Set(2.0F * kPi);
+  auto spread =
+      (Lanes::Set(1.0F) + distance * Lanes::Set(8.0F)) / Lanes::Set(kResolution);
+  std::array<float, Lanes::kWidth> us;
+  std::array<float, Lanes::kWidth> spreads;
+  std::array<float, Lanes::kWidth> distances;
+  std::array<float, Lanes::kWidth> lit;
+  u.Store(us.data());
+  spread.Store(spreads.data());
+  distance.Store(distances.data());
+  const float* distances_row = atlas.data() + (row * ShadowMaps::kResolution);
+  for (int lane = 0; lane < Lanes::kWidth; lane++) {
+    float sum = 0.0F;
+    for (int tap = -2; tap <= 2; tap++) {
+      // Nearest filtering, wrapping around the angle
+      float coordinate = us[lane] + static_cast<float>(tap) * spreads[lane];
+      coordinate -= std::floor(coordinate);
+      auto texel = std::min(static_cast<std::size_t>(coordinate * kResolution),
+                            ShadowMaps::kResolution - 1);
+      sum += distances[lane] <= distances_row[texel] ? 1.0F : 0.0F;
+    }
+    lit[lane] = sum / 5.0F;
+  }
+  return Lanes::Load(lit.data());
+}
+
+unsigned char ToUnorm(float value) {
+  return static_cast<unsigned char>(
+      std::lround(std::clamp(value, 0.0F, 1.0F) * 255.0F));
+}
+
+// Runs `work(index)` for every index below `count` on `threads` threads.
+template <typename Work>
+void ParallelFor(std::size_t count, std::size_t threads, const Work& work) {
+  std::atomic<std::size_t> next = 0;
+  auto worker = [&] {
+    for (auto index = next++; index < count; index = next++) {
+      work(index);
+    }
+  };
+  std::vector<std::jthread> pool;
+  for (std::size_t i = 1; i < std::min(threads, count); i++) {
+    pool.emplace_back(worker);
+  }
+  worker();
+}
+}  // namespace
+
+CpuRenderer::CpuRenderer(glm::ivec2 viewport, std::size_t shadow_refresh_limit,
+                         std::size_t threads)
+    : viewport_(viewport),
+      size_(std::max(1, static_cast<int>(viewport.x * kFramebufferScale)),
+            std::max(1, static_cast<int>(viewport.y * kFramebufferScale))),
+      stride_((static_cast<std::size_t>(size_.x) + Lanes::kWidth - 1) /
+              Lanes::kWidth * Lanes::kWidth),
+      threads_(threads != 0
+                   ? threads
+                   : std::max(1U, std::thread::hardware_concurrency())),
+      frame_(static_cast<std::size_t>(viewport.x) *
+             static_cast<std::size_t>(viewport.y) * 3),
+      shadow_maps_(shadow_refresh_limit) {
+  if (viewport.x <= 0 || viewport.y <= 0) {
+    throw std::runtime_error("Viewport must be positive");
+  }
+  auto pixels = stride_ * static_cast<std::size_t>(size_.y);
+  for (int c = 0; c < 3; c++) {
+    albedo_.values[c].resize(pixels);
+    normal_.values[c].resize(pixels);
+    static_normal_.values[c].resize(pixels);
+  }
+  deferred_.resize(static_cast<std::size_t>(size_.x) *
+                   static_cast<std::size_t>(size_.y) * 3);
+  images_.push_back(
+      {.width = 1, .height = 1, .rgb = {0.0F, 0.0F, 0.0F}, .alpha = {}});
+}
+
+std::string_view CpuRenderer::Simd() { return kSimd; }
+
+void CpuRenderer::LoadTextures(Scene& scene) {
+  // By path handle
+  std::unordered_map<std::uint32_t, unsigned int> loaded;
+  auto load = [&](const std::string& path) -> unsigned int {
+    int width;
+    int height;
+    int channels;
+    auto asset = FindAsset(path);
+    if (!asset) {
+      return 0U;
+    }
+    auto* data = stbi_load_from_memory(
+        reinterpret_cast<const stbi_uc*>(asset->Data()),
+        static_cast<int>(asset->Size()), &width, &height, &channels, 0);
+    if (data == nullptr) {
+      return 0U;
+    }
+    // Expanded the way GL_RED and GL_RG textures are sampled
+    Image image{.width = width, .height = height, .rgb = {}, .alpha = {}};
+    auto texels =
+        static_cast<std::size_t>(width) * static_cast<std::size_t>(height);
+    image.rgb.resize(texels * 3);
+    for (std::size_t i = 0; i < texels; i++) {
+      for (int c = 0; c < std::min(channels, 3); c++) {
+        image.rgb[(i * 3) + c] =
+            static_cast<float>(data[(i * channels) + c]) / 255.0F;
+      }
+    }
+    if (channels == 4) {
+      image.alpha.resize(texels);
+      for (std::size_t i = 0; i < texels; i++) {
+        image.alpha[i] = static_cast<float>(data[(i * 4) + 3]) / 255.0F;
+      }
+    }
+    stbi_image_free(data);
+    images_.push_back(std::move(image));
+    return static_cast<unsigned int>(images_.size() - 1);
+  };
+  auto assign = [&](auto& attributes) {
+    for (auto& [name, value] : attributes) {
+      if (auto* texture = std::get_if<Texture>(&value)) {
+        auto [it, inserted] = loaded.try_emplace(texture->path, 0U);
+        if (inserted) {
+          it->second = load(texture->Path());
+        }
+        texture->id = it->second;
+      }
+    }
+  };
+  for (auto& prefab : scene.prefabs) {
+    assign(prefab->attributes);
+  }
+  for (auto& object : scene.objects) {
+    assign(object->attributes);
+  }
+}
+
+void CpuRenderer::Draw(std::span<const SpriteProxy> sprites,
+                       std::span<const LightProxy> lights,
+                       std::span<const OccluderProxy> occluders,
+                       const glm::mat4& view, glm::vec3 clear_color) {
+  auto view_projection = Projection(viewport_) * view;
+  static_lights_.clear();
+  dynamic_lights_.clear();
+  for (const auto& light : lights) {
+    (light.is_static ? static_lights_ : dynamic_lights_).push_back(light);
+  }
+  auto shaded = light_lod_.Reduce(dynamic_lights_);
+  shadow_maps_.Update(shaded, occluders, view_projection);
+
+  // Pixel centres to sprite coordinates, inverting the sprite's 2D transform
+  glm::vec2 size(size_);
+  auto image = [&](unsigned int id) -> const Image* {
+    if (id == SpriteProxy::kMissingTexture) {
+      return nullptr;
+    }
+    return &images_[id < images_.size() ? id : 0];
+  };
+  rasters_.clear();
+  // The layer as seen, as Renderer sorts by
+  glm::vec4 depth_row(view[0][2], view[1][2], view[2][2], view[3][2]);
+  for (std::size_t index = 0; index < sprites.size(); index++) {
+    const auto& sprite = sprites[index];
+    auto transform = view_projection * sprite.model;
+    // Outside the near and far planes, so clipped
+    if (std::abs(transform[3][2]) > 1.0F) {
+      continue;
+    }
+    glm::vec2 x_axis(transform[0]);
+    glm::vec2 y_axis(transform[1]);
+    glm::vec2 offset(transform[3]);
+    float determinant = x_axis.x * y_axis.y - x_axis.y * y_axis.x;
+    if (determinant == 0.0F) {
+      continue;
+    }
+    // Inverse of the columns x_axis, y_axis
+    glm::vec2 inverse_x(y_axis.y / determinant, -x_axis.y / determinant);
+    glm::vec2 inverse_y(-y_axis.x / determinant, x_axis.x / determinant);
+    auto to_sprite = [&](glm::vec2 ndc) {
+      auto d = ndc - offset;
+      return inverse_x * d.x + inverse_y * d.y;
+    };
+    // Pixel p's centre is at (p + 0.5) / size * 2 - 1 in NDC
+    auto origin = to_sprite(glm::vec2(1.0F) / size - 1.0F);
+    Raster raster{.origin = origin,
+                  .x_axis = inverse_x * (2.0F / size.x),
+                  .y_axis = inverse_y * (2.0F / size.y),
+                  .first = {},
+                  .last = {},
+                  .color = image(sprite.color_texture),
+                  .normal = image(sprite.normal_texture),
+                  .mask = nullptr,
+                  .frame = AnimationFrame(sprite.animation,
+                                          static_cast<float>(time_)),
+                  .is_static = sprite.is_static,
+                  .is_transparent = sprite.is_transparent,
+                  .layer = glm::dot(depth_row, sprite.model[3]),
+                  .index = index};
+    raster.mask = raster.color != nullptr ? raster.color : raster.normal;
+    glm::vec2 low(INFINITY);
+    glm::vec2 high(-INFINITY);
+    for (float x : {-0.5F, 0.5F}) {
+      for (float y : {-0.5F, 0.5F}) {
+        auto ndc = x_axis * x + y_axis * y + offset;
+        auto pixel = (ndc + 1.0F) * 0.5F * size;
+        low = glm::min(low, pixel);
+        high = glm::max(high, pixel);
+      }
+    }
+    raster.first = {std::max(0, static_cast<int>(std::floor(low.x)) - 1),
+                    std::max(0, static_cast<int>(std::floor(low.y)) - 1)};
+    raster.last = {std::min(size_.x, static_cast<int>(std::ceil(high.x)) + 1),
+                   std::min(size_.y, static_cast<int>(std::ceil(high.y)) + 1)};
+    if (raster.first.x < raster.last.x && raster.first.y < raster.last.y) {
+      rasters_.push_back(raster);
+    }
+  }
+
+  // Back to front, so each sprite is drawn over those it hides: Renderer's
+  // opaque sprites are drawn front to back with the depth test, later ones
+  // winning within a layer, then transparent ones back to front over the
+  // opaque sprites of their layer
+  std::ranges::sort(rasters_, [](const Raster& a, const Raster& b) {
+    if (a.layer != b.layer) {
+      return a.layer < b.layer;
+    }
+    if (a.is_transparent != b.is_transparent) {
+      return b.is_transparent;
+    }
+    return a.index < b.index;
+  });
+
+  // The color buffer is cleared to the clear color, and so is the normal
+  // buffer, since Renderer leaves it set
+  for (int c = 0; c < 3; c++) {
+    float clear = static_cast<float>(ToUnorm(clear_color[c])) / 255.0F;
+    std::ranges::fill(albedo_.values[c], clear);
+    std::ranges::fill(normal_.values[c], clear);
+    std::ranges::fill(static_normal_.values[c], clear);
+  }
+  // Lights whose every direction is clear skip the shadow lookups
+  std::array<bool, kMaxLights> shadowed{};
+  auto atlas = shadow_maps_.Atlas();
+  for (std::size_t i = 0; i < std::min(shaded.size(), kMaxLights); i++) {
+    shadowed[i] = std::ranges::any_of(
+        atlas.subspan(i * ShadowMaps::kResolution, ShadowMaps::kResolution),
+        [](float distance) { return distance < ShadowMaps::kNoOccluder; });
+  }
+  auto columns = static_cast<std::size_t>((size_.x + kTileWidth - 1) / kTileWidth);
+  auto rows = static_cast<std::size_t>((size_.y + kTileHeight - 1) / kTileHeight);
+  ParallelFor(columns * rows, threads_, [&](std::size_t tile) {
+    glm::ivec2 first(static_cast<int>(tile % columns) * kTileWidth,
+                     static_cast<int>(tile / columns) * kTileHeight);
+    DrawTile(first, glm::min(first + glm::ivec2(kTileWidth, kTileHeight), size_),
+             static_lights_, shaded, shadowed);
+  });
+
+  // The combine pass: nearest filtering up to the viewport, flipped so the
+  // top row comes first
+  std::vector<std::size_t> source_columns(static_cast<std::size_t>(viewport_.x));
+  for (int x = 0; x < viewport_.x; x++) {
+    source_columns[x] = static_cast<std::size_t>(
+        (static_cast<float>(x) + 0.5F) / static_cast<float>(viewport_.x) *
+        size.x);
+  }
+  ParallelFor(static_cast<std::size_t>(viewport_.y), threads_, [&](std::size_t y) {
+    auto source_row = static_cast<std::size_t>(
+        (static_cast<float>(viewport_.y - 1 - static_cast<int>(y)) + 0.5F) /
+        static_cast<float>(viewport_.y) * size.y);
+    const auto* source = deferred_.data() + (source_row * size_.x * 3);
+    auto* target = frame_.data() + (y * viewport_.x * 3);
+    for (std::size_t x = 0; x < source_columns.size(); x++) {
+      std::copy_n(source + (source_columns[x] * 3), 3, target + (x * 3));
+    }
+  });
+}
+
+void CpuRenderer::DrawTile(glm::ivec2 first, glm::ivec2 last,
+                           std::span<const LightProxy> static_lights,
+                           std::span<const LightProxy> lights,
+                           const std::array<bool, kMaxLights>& shadowed) {
+  // Sprites back to front, each cut out, or blended if transparent, by its
+  // color's alpha as sprite_fragment.glsl does
+  for (const auto& raster : rasters_) {
+    glm::ivec2 from = glm::max(first, raster.first);
+    glm::ivec2 to = glm::min(last, raster.last);
+    for (int y = from.y; y < to.y; y++) {
+      for (int x = from.x; x < to.x; x++) {
+        auto local = raster.origin + raster.x_axis * static_cast<float>(x) +
+                     raster.y_axis * static_cast<float>(y);
+        if (local.x < -0.5F || local.x >= 0.5F || local.y < -0.5F ||
+            local.y >= 0.5F) {
+          continue;
+        }
+        auto pixel = (static_cast<std::size_t>(y) * stride_) + x;
+        // Clamped to the edge, nearest texel
+        glm::vec2 coordinates(
+            raster.frame.x + (local.x + 0.5F) * raster.frame.z,
+            raster.frame.y + (local.y + 0.5F) * raster.frame.w);
+        auto texel_index = [&](const Image& image) {
+          auto u = std::min(static_cast<int>(coordinates.x * image.width),
+                            image.width - 1);
+          auto v = std::min(static_cast<int>(coordinates.y * image.height),
+                            image.height - 1);
+          return (static_cast<std::size_t>(v) * image.width) +
+                 static_cast<std::size_t>(u);
+        };
+        float alpha = 1.0F;
+        if (raster.mask != nullptr && !raster.mask->alpha.empty()) {
+          alpha = raster.mask->alpha[texel_index(*raster.mask)];
+        }
+        if (alpha < (raster.is_transparent ? kTransparentCutoff
+                                           : kOpaqueCutoff)) {
+          continue;
+        }
+        auto sample = [&](const Image& image, Plane& plane) {
+          const auto* texel = image.rgb.data() + (texel_index(image) * 3);
+          for (int c = 0; c < 3; c++) {
+            auto& value = plane.values[c][pixel];
+            if (!raster.is_transparent) {
+              value = texel[c];
+              continue;
+            }
+            // Blended into the 8-bit color buffer
+            value = std::round(((value * (1.0F - alpha)) + (texel[c] * alpha)) *
+                               255.0F) /
+                    255.0F;
+          }
+        };
+        if (raster.color != nullptr) {
+          sample(*raster.color, albedo_);
+        }
+        if (raster.normal != nullptr) {
+          sample(*raster.normal, normal_);
+          if (raster.is_static) {
+            sample(*raster.normal, static_normal_);
+          }
+        }
+      }
+    }
+  }
+
+  // deferred_fragment.glsl, Lanes::kWidth pixels at a time. The color buffer
+  // has no alpha channel, so the shader never discards.
+  auto one = Lanes::Set(1.0F);
+  auto zero = Lanes::Set(0.0F);
+  auto no_occluder = Lanes::Set(ShadowMaps::kNoOccluder);
+  auto count = std::min(lights.size(), kMaxLights);
+  for (int y = first.y; y < last.y; y++) {
+    auto v = Lanes::Set((static_cast<float>(y) + 0.5F) /
+                        static_cast<float>(size_.y));
+    for (int x = first.x; x < last.x; x += Lanes::kWidth) {
+      auto pixel = (static_cast<std::size_t>(y) * stride_) + x;
+      auto u = (Lanes::Set(static_cast<float>(x) + 0.5F) + Lanes::Ramp()) /
+               Lanes::Set(static_cast<float>(size_.x));
+      std::array<Lanes, 3> albedo;
+      for (int c = 0; c < 3; c++) {
+        albedo[c] = Lanes::Load(albedo_.values[c].data() + pixel);
+      }
+      auto load_normal = [&](const Plane& plane) {
+        std::array<Lanes, 3> normal;
+        for (int c = 0; c < 3; c++) {
+          normal[c] = Lanes::Load(plane.values[c].data() + pixel) *
+                          Lanes::Set(2.0F) -
+                      one;
+        }
+        auto length = Sqrt(normal[0] * normal[0] + normal[1] * normal[1] +
+                           normal[2] * normal[2]);
+        for (auto& n : normal) {
+          n = n / length;
+        }
+        return normal;
+      };
+
+      // bake_fragment.glsl, over all static lights and without shadows
+      std::array<Lanes, 3> total = {zero, zero, zero};
+      if (!static_lights.empty()) {
+        auto normal = load_normal(static_normal_);
+        std::array<Lanes, 3> diffuse_total = {zero, zero, zero};
+        for (const auto& light : static_lights) {
+          if (light.type == 0) {
+            for (int c = 0; c < 3; c++) {
+              diffuse_total[c] =
+                  diffuse_total[c] + Lanes::Set(light.color[c] * light.intensity);
+            }
+            continue;
+          }
+          if (light.type != 1) {
+            continue;
+          }
+          auto offset_x = Lanes::Set(light.position.x) - u;
+          auto offset_y = Lanes::Set(light.position.y) - v;
+          auto height = Lanes::Set(light.position.z);
+          auto squared = offset_x * offset_x + offset_y * offset_y;
+          auto attenuation = Max(Lanes::Set(light.intensity) /
+                                     (one + Lanes::Set(light.falloff) * squared),
+                                 zero);
+          auto diffuse = Max((normal[0] * offset_x + normal[1] * offset_y +
+                              normal[2] * height) /
+                                 Sqrt(squared + height * height),
+                             zero);
+          auto volumetric =
+              Lanes::Set(light.volumetric_intensity) / (one + squared);
+          for (int c = 0; c < 3; c++) {
+            auto color = Lanes::Set(light.color[c]);
+            diffuse_total[c] = diffuse_total[c] + color * diffuse * attenuation;
+            total[c] = total[c] + color * volumetric * attenuation;
+          }
+        }
+        for (int c = 0; c < 3; c++) {
+          total[c] = total[c] + albedo[c] * diffuse_total[c];
+        }
+      }
+
+      auto normal = load_normal(normal_);
+      for (std::size_t i = 0; i < count; i++) {
+        const auto& light = lights[i];
+        if (light.type == 0) {
+          for (int c = 0; c < 3; c++) {
+            total[c] = total[c] + albedo[c] * Lanes::Set(light.color[c] *
+                                                         light.intensity);
+          }
+          continue;
+        }
+        if (light.type != 1) {
+          continue;
+        }
+        auto offset_x = Lanes::Set(light.position.x) - u;
+        auto offset_y = Lanes::Set(light.position.y) - v;
+        auto height = Lanes::Set(light.position.z);
+        auto squared = offset_x * offset_x + offset_y * offset_y;
+        auto distance = Sqrt(squared);
+        auto direction_length = Sqrt(squared + height * height);
+        auto attenuation = Max(
+            Lanes::Set(light.intensity) /
+                (one + Lanes::Set(light.falloff) * distance * distance),
+            zero);
+        if (shadowed[i]) {
+          attenuation = attenuation * ShadowFactor(shadow_maps_.Atlas(), i,
+                                                   zero - offset_x,
+                                                   zero - offset_y, distance);
+        } else {
+          // Every direction of the map holds ShadowMaps::kNoOccluder
+          attenuation = Select(no_occluder < distance, zero, attenuation);
+        }
+        auto diffuse = Max((normal[0] * offset_x + normal[1] * offset_y +
+                            normal[2] * height) /
+                               direction_length,
+                           zero);
+        auto volumetric = Lanes::Set(light.volumetric_intensity) /
+                          (one + distance * distance);
+        for (int c = 0; c < 3; c++) {
+          auto color = Lanes::Set(light.color[c]);
+          total[c] = total[c] + albedo[c] * color * diffuse * attenuation +
+                     color * volumetric * attenuation;
+        }
+      }
+      std::array<std::array<float, Lanes::kWidth>, 3> stored;
+      for (int c = 0; c < 3; c++) {
+        total[c].Store(stored[c].data());
+      }
+      for (int lane = 0; lane < Lanes::kWidth && x + lane < last.x; lane++) {
+        auto* target =
+            deferred_.data() +
+            (((static_cast<std::size_t>(y) * size_.x) + x + lane) * 3);
+        for (int c = 0; c < 3; c++) {
+          target[c] = ToUnorm(stored[c][lane]);
+        }
+      }
+    }
+  }
+}
@@ -9,6 +9,17 @@ const std::map<std::string, std::string> kDescriptionMap = {
   {"light.color", "The color of the light."},
   {"light.radial_falloff", "The range of the light"},
   {"light.volumetric_intensity", "The amount of which the light effects the volume around it."},
+  {"animation.grid", "Columns and rows of frames in the sprite's textures, tagged \"animated\"."},
+  {"animation.frames", "How many of the grid's cells are frames, along the rows from the top."},
+  {"animation.rate", "Frames per second; 0 shows the first frame."},
+  {"animation.mode", "0: Loop, 1: Play once and hold the last frame, 2: Ping-pong."},
+  {"animation.start", "Seconds after the renderer started at which the first frame shows."},
+  {"particle.count", "How many particles the emitter keeps alive, tagged \"emitter\"."},
+  {"particle.lifetime", "Seconds each particle lives before it is emitted again."},
+  {"particle.speed", "The fastest speed particles leave at; the slowest is half of it."},
+  {"particle.spread", "The angle in degrees particles spread over, around the object's up axis."},
+  {"particle.gravity", "The acceleration of every particle."},
+  {"particle.size", "The width and height of a particle."},
   {"texture.color", "The color texture of the object. (Optional. Removing it will set the color to black.)"},
   {"texture.normal", "The normal texture of the object. (Optional. Removing it will shade it flat.)"}
 };
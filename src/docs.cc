@@ -7,12 +7,20 @@
 #include <iostream>
 #include <vector>
 
+#include "asset_pack.h"
+
 namespace {
   std::vector<std::pair<std::string, std::string>> doc_text;
 
 std::vector<std::pair<std::string, std::string>> LoadDocumentation() {
   pugi::xml_document doc;
-  pugi::xml_parse_result result = doc.load_file("documentation.xml");
+  // The saved copy wins over the packed one
+  auto asset = FindAsset("documentation.xml", true);
+  if (!asset) {
+    std::cerr << "Failed to load documentation: documentation.xml not found" << std::endl;
+    return {};
+  }
+  pugi::xml_parse_result result = doc.load_buffer(asset->Data(), asset->Size());
   if (!result) {
     std::cerr << "Failed to load documentation: " << result.description() << std::endl;
     return {};
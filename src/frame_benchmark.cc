@@ -0,0 +1,387 @@
+#include "frame_benchmark.h"
+
+#include <glad/glad.h>
+// Code block
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <print>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+#include "core.h"
+#include "cpu_renderer.h"
+#include "render_proxy.h"
+#include "renderer.h"
+#include "scene.h"
+
+namespace {
+// Animation time advances by this much per frame, whatever the frame rate
+constexpr float kAnimationStep = 1.0F / 60.0F;
+constexpr glm::vec3 kClearColor = {0.1F, 0.1F, 0.1F};
+
+struct FrameTimes {
+  std::vector<double> cpu_ms;
+  std::vector<double> gpu_ms;
+  std::vector<double> frame_ms;
+};
+
+glm::ivec2 ParseResolution(std::string_view text) {
+  auto x = text.find('x');
+  if (x == std::string_view::npos) {
+    throw std::runtime_error("Resolution must be WxH: " + std::string(text));
+  }
+  glm::ivec2 resolution = {std::stoi(std::string(text.substr(0, x))),
+                           std::stoi(std::string(text.substr(x + 1)))};
+  if (resolution.x <= 0 || resolution.y <= 0) {
+    throw std::runtime_error("Resolution must be positive: " +
+                             std::string(text));
+  }
+  return resolution;
+}
+
+glm::mat4 AnimatedView(float time) {
+  return glm::translate(glm::mat4(1.0F),
+                        glm::vec3(std::sin(time * 0.5F) * 5.0F,
+                                  std::sin(time * 0.3F) * 3.0F, 0.0F));
+}
+
+// Each light circles its position in the scene.
+void AnimateLights(std::span<const LightProxy> lights, float time,
+                   std::vector<LightProxy>& animated) {
+  animated.assign(lights.begin(), lights.end());
+  for (std::size_t i = 0; i < animated.size(); i++) {
+    float phase = time + static_cast<float>(i);
+    animated[i].position += glm::vec3(std::cos(phase), std::sin(phase), 0.0F);
+  }
+}
+
+// Nearest-rank percentile of sorted values.
+double Percentile(const std::vector<double>& sorted, double percentile) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  auto rank = static_cast<std::size_t>(
+      std::ceil(percentile / 100.0 * static_cast<double>(sorted.size())));
+  return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+void PrintSummary(std::string_view name, std::vector<double> values) {
+  std::ranges::sort(values);
+  std::print("{:<6} p50 {:>8.3f} ms  p95 {:>8.3f} ms  p99 {:>8.3f} ms\n", name,
+             Percentile(values, 50), Percentile(values, 95),
+             Percentile(values, 99));
+}
+
+void WriteCsv(const std::string& path, const FrameTimes& times) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + path);
+  }
+  file << "frame,cpu_ms,gpu_ms,frame_ms\n";
+  for (std::size_t i = 0; i < times.cpu_ms.size(); i++) {
+    file << i << ',' << times.cpu_ms[i] << ',' << times.gpu_ms[i] << ','
+         << times.frame_ms[i] << '\n';
+  }
+}
+
+// RGB, top row first.
+std::vector<unsigned char> ReadFrame(glm::ivec2 size) {
+  std::vector<unsigned char> pixels(static_cast<std::size_t>(size.x) *
+                                    static_cast<std::size_t>(size.y) * 3);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadBuffer(GL_BACK);
+  glReadPixels(0, 0, size.x, size.y, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+  // OpenGL's rows start at the bottom
+  std::size_t row = static_cast<std::size_t>(size.x) * 3;
+  for (int y = 0; y < size.y / 2; y++) {
+    std::swap_ranges(pixels.begin() + static_cast<std::ptrdiff_t>(y * row),
+                     pixels.begin() + static_cast<std::ptrdiff_t>((y + 1) * row),
+                     pixels.end() - static_cast<std::ptrdiff_t>((y + 1) * row));
+  }
+  return pixels;
+}
+
+// Returns whether the frame is within `tolerance` of the image at `path`.
+bool CompareWithGolden(const std::vector<unsigned char>& frame,
+                       glm::ivec2 size, const std::string& path,
+                       float tolerance) {
+  int width;
+  int height;
+  int channels;
+  auto* golden = stbi_load(path.c_str(), &width, &height, &channels, 3);
+  if (golden == nullptr) {
+    throw std::runtime_error("Failed to load golden image: " + path);
+  }
+  if (width != size.x || height != size.y) {
+    stbi_image_free(golden);
+    std::print("Golden image is {}x{}, frame is {}x{}\n", width, height,
+               size.x, size.y);
+    return false;
+  }
+  double difference = 0.0;
+  for (std::size_t i = 0; i < frame.size(); i++) {
+    difference += std::abs(static_cast<int>(frame[i]) - golden[i]);
+  }
+  stbi_image_free(golden);
+  difference /= static_cast<double>(frame.size());
+  std::print("Golden image difference: {:.3f} (tolerance {:.3f})\n",
+             difference, tolerance);
+  return difference <= tolerance;
+}
+
+// Writes and prints the results, and checks the last frame (RGB, top row
+// first) if asked to. Returns the process exit code.
+int Report(const FrameBenchmarkOptions& options, const FrameTimes& times,
+           const LightLodStats& lod, const std::vector<unsigned char>& last_frame,
+           glm::ivec2 viewport) {
+  WriteCsv(options.csv_path, times);
+  PrintSummary("cpu", times.cpu_ms);
+  if (options.backend == RenderBackend::kOpengl) {
+    PrintSummary("gpu", times.gpu_ms);
+  }
+  PrintSummary("frame", times.frame_ms);
+  std::print("lights: {} shaded, {} merged into {} (error {:.2f})\n",
+             lod.shaded, lod.merged, lod.aggregates, lod.error);
+
+  if (!options.capture_path.empty() &&
+      stbi_write_png(options.capture_path.c_str(), viewport.x, viewport.y, 3,
+                     last_frame.data(), viewport.x * 3) == 0) {
+    throw std::runtime_error("Failed to write image: " + options.capture_path);
+  }
+  if (!options.golden_path.empty() &&
+      !CompareWithGolden(last_frame, viewport, options.golden_path,
+                         options.tolerance)) {
+    std::print("Last frame does not match {}\n", options.golden_path);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int Run(const FrameBenchmarkOptions& options, GLFWwindow* window) {
+  glm::ivec2 viewport;
+  glfwGetFramebufferSize(window, &viewport.x, &viewport.y);
+  Renderer renderer(window);
+  renderer.Lod().SetOptions(options.light_lod);
+  renderer.SetDebugOptions({.depth_sort = options.depth_sort,
+                            .overdraw = false,
+                            .static_batching = options.static_batching,
+                            .texture_atlas = options.texture_atlas});
+  // Loaded after the renderer: texture uploads need the context
+  auto scene = LoadScene(options.scene_path);
+  RenderProxies proxies;
+  proxies.Sync(scene);
+  std::print("{} objects, {} sprites, {} lights, {} emitters, {}x{}\n",
+             scene.objects.size(), proxies.Sprites().size(),
+             proxies.Lights().size(), proxies.Emitters().size(), viewport.x,
+             viewport.y);
+
+  auto total = options.warmup_frames + options.frames;
+  std::vector<unsigned int> queries(total);
+  glGenQueries(static_cast<int>(queries.size()), queries.data());
+  FrameTimes times;
+  std::vector<LightProxy> lights;
+  std::vector<unsigned char> last_frame;
+  for (std::size_t frame = 0; frame < total; frame++) {
+    auto start = std::chrono::steady_clock::now();
+    float time = static_cast<float>(frame) * kAnimationStep;
+    auto view = options.animate ? AnimatedView(time) : glm::mat4(1.0F);
+    if (options.animate) {
+      AnimateLights(proxies.Lights(), time, lights);
+    }
+    glBeginQuery(GL_TIME_ELAPSED, queries[frame]);
+    renderer.Advance(kAnimationStep);
+    renderer.Draw(proxies.Sprites(),
+                  options.animate ? std::span<const LightProxy>(lights)
+                                  : proxies.Lights(),
+                  proxies.Occluders(), proxies.Emitters(), view, viewport,
+                  kClearColor);
+    glEndQuery(GL_TIME_ELAPSED);
+    auto submitted = std::chrono::steady_clock::now();
+    if (frame + 1 == total &&
+        (!options.capture_path.empty() || !options.golden_path.empty())) {
+      last_frame = ReadFrame(viewport);
+    }
+    glfwSwapBuffers(window);
+    glfwPollEvents();
+    auto end = std::chrono::steady_clock::now();
+    if (frame >= options.warmup_frames) {
+      times.cpu_ms.push_back(
+          std::chrono::duration<double, std::milli>(submitted - start).count());
+      times.frame_ms.push_back(
+          std::chrono::duration<double, std::milli>(end - start).count());
+    }
+  }
+  // Read back once at the end so waiting for results never stalls a frame
+  for (std::size_t frame = options.warmup_frames; frame < total; frame++) {
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(queries[frame], GL_QUERY_RESULT, &ns);
+    times.gpu_ms.push_back(static_cast<double>(ns) / 1e6);
+  }
+  glDeleteQueries(static_cast<int>(queries.size()), queries.data());
+  std::print("overdraw: {:.2f} fragments per pixel\n", renderer.Overdraw());
+  const auto& batches = renderer.BatchStats();
+  std::print("static batches: {} sprites in {} chunks, {} drawn in {} calls\n",
+             batches.sprites, batches.chunks, batches.drawn,
+             batches.draw_calls);
+  std::print("texture atlas: {} texture pairs on {} pages\n",
+             renderer.Atlas().Packed(), renderer.Atlas().Pages());
+  const auto& graph = renderer.GraphStats();
+  std::print("render graph: {} of {} passes, {} framebuffers\n",
+             graph.passes - graph.culled, graph.passes, graph.framebuffers);
+  return Report(options, times, renderer.Lod().Stats(), last_frame, viewport);
+}
+
+int RunCpu(const FrameBenchmarkOptions& options) {
+  CpuRenderer renderer(options.resolution);
+  renderer.Lod().SetOptions(options.light_lod);
+  auto scene = LoadScene(options.scene_path, false);
+  renderer.LoadTextures(scene);
+  RenderProxies proxies;
+  proxies.Sync(scene);
+  std::print("{} objects, {} sprites, {} lights, {}x{}, CPU ({})\n",
+             scene.objects.size(), proxies.Sprites().size(),
+             proxies.Lights().size(), options.resolution.x,
+             options.resolution.y, CpuRenderer::Simd());
+
+  auto total = options.warmup_frames + options.frames;
+  FrameTimes times;
+  std::vector<LightProxy> lights;
+  for (std::size_t frame = 0; frame < total; frame++) {
+    auto start = std::chrono::steady_clock::now();
+    float time = static_cast<float>(frame) * kAnimationStep;
+    auto view = options.animate ? AnimatedView(time) : glm::mat4(1.0F);
+    if (options.animate) {
+      AnimateLights(proxies.Lights(), time, lights);
+    }
+    renderer.Advance(kAnimationStep);
+    renderer.Draw(proxies.Sprites(),
+                  options.animate ? std::span<const LightProxy>(lights)
+                                  : proxies.Lights(),
+                  proxies.Occluders(), view, kClearColor);
+    auto end = std::chrono::steady_clock::now();
+    if (frame >= options.warmup_frames) {
+      auto ms = std::chrono::duration<double, std::milli>(end - start).count();
+      times.cpu_ms.push_back(ms);
+      times.gpu_ms.push_back(0.0);
+      times.frame_ms.push_back(ms);
+    }
+  }
+  std::vector<unsigned char> last_frame(renderer.Frame().begin(),
+                                        renderer.Frame().end());
+  return Report(options, times, renderer.Lod().Stats(), last_frame,
+                options.resolution);
+}
+}  // namespace
+
+FrameBenchmarkOptions ParseFrameBenchmarkOptions(int argc, char* argv[]) {
+  if (argc < 3) {
+    throw std::runtime_error("Usage: --benchmark <scene> [options]");
+  }
+  FrameBenchmarkOptions options;
+  options.scene_path = argv[2];
+  for (int i = 3; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "--animate") {
+      options.animate = true;
+      continue;
+    }
+    if (arg == "--no-depth-sort") {
+      options.depth_sort = false;
+      continue;
+    }
+    if (arg == "--no-static-batching") {
+      options.static_batching = false;
+      continue;
+    }
+    if (arg == "--no-texture-atlas") {
+      options.texture_atlas = false;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      throw std::runtime_error("Missing value for " + std::string(arg));
+    }
+    std::string_view value = argv[++i];
+    if (arg == "--frames") {
+      options.frames = std::max<std::size_t>(std::stoull(std::string(value)), 1);
+    } else if (arg == "--warmup") {
+      options.warmup_frames = std::stoull(std::string(value));
+    } else if (arg == "--resolution") {
+      options.resolution = ParseResolution(value);
+    } else if (arg == "--csv") {
+      options.csv_path = value;
+    } else if (arg == "--capture") {
+      options.capture_path = value;
+    } else if (arg == "--golden") {
+      options.golden_path = value;
+    } else if (arg == "--tolerance") {
+      options.tolerance = std::stof(std::string(value));
+    } else if (arg == "--backend") {
+      if (value == "gl") {
+        options.backend = RenderBackend::kOpengl;
+      } else if (value == "cpu") {
+        options.backend = RenderBackend::kCpu;
+      } else {
+        throw std::runtime_error("Unknown backend: " + std::string(value));
+      }
+    } else if (arg == "--light-error") {
+      options.light_lod.error_bound = std::stof(std::string(value));
+    } else if (arg == "--light-budget") {
+      options.light_lod.budget =
+          std::max<std::size_t>(std::stoull(std::string(value)), 1);
+    } else {
+      throw std::runtime_error("Unknown option: " + std::string(arg));
+    }
+  }
+  return options;
+}
+
+int RunFrameBenchmark(const FrameBenchmarkOptions& options) {
+  if (options.backend == RenderBackend::kCpu) {
+    try {
+      return RunCpu(options);
+    } catch (const std::exception& e) {
+      std::print("Benchmark failed: {}\n", e.what());
+      return EXIT_FAILURE;
+    }
+  }
+  core::Initialize(core::InitializeFlags::kOpengl, nullptr);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+  auto* window = glfwCreateWindow(options.resolution.x, options.resolution.y,
+                                  "Vibrant Benchmark", nullptr, nullptr);
+  if (window == nullptr) {
+    std::print("Failed to create a window for the benchmark\n");
+    glfwTerminate();
+    return EXIT_FAILURE;
+  }
+  glfwMakeContextCurrent(window);
+  if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
+    std::print("Failed to load OpenGL\n");
+    glfwTerminate();
+    return EXIT_FAILURE;
+  }
+  // Frames are timed, not paced
+  glfwSwapInterval(0);
+  int result = EXIT_FAILURE;
+  try {
+    result = Run(options, window);
+  } catch (const std::exception& e) {
+    std::print("Benchmark failed: {}\n", e.what());
+  }
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return result;
+}
@@ -1,39 +1,32 @@
 #include <glad/glad.h>
 // CODE BLOCK: To stop clang from messing with my include
 #include <array>
-#include <filesystem>
-#include <fstream>
 #include <memory>
-#include <sstream>
 #include <stdexcept>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 #include "helpers.h"
 
+#include "asset_pack.h"
+
 constexpr int kLogSize = 512;
 std::vector<std::shared_ptr<Framebuffer>> all_framebuffers;
 std::vector<unsigned int> loaded_textures;
 std::vector<unsigned int> loaded_vertex_arrays;
 std::vector<unsigned int> loaded_buffers;
+std::unordered_map<unsigned int, std::size_t> texture_bytes;
+std::unordered_map<unsigned int, std::size_t> buffer_bytes;
 
 // Shader-related functions
 namespace {
-std::string ReadFile(const std::filesystem::path& path) {
-  std::ifstream file(path);
-  if (!file.is_open()) {
-    throw std::runtime_error("Failed to open file: " + path.string());
-  }
-  std::stringstream stream;
-  stream << file.rdbuf();
-  file.close();
-  return stream.str();
-}
-
-unsigned int CompileShader(int shader_type, std::string source) {
+unsigned int CompileShader(int shader_type, std::string_view source) {
   auto shader = glCreateShader(shader_type);
+  // Straight from the asset, which is not null-terminated
   const char* source_data = source.data();
-  glShaderSource(shader, 1, &source_data, nullptr);
+  auto source_length = static_cast<int>(source.size());
+  glShaderSource(shader, 1, &source_data, &source_length);
   glCompileShader(shader);
   int success;
   glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
@@ -48,13 +41,24 @@ unsigned int CompileShader(int shader_type, std::string source) {
 }
 
 unsigned int LoadShaderProgram(
-    std::vector<std::pair<unsigned int, std::string>> shader_paths) {
+    std::vector<std::pair<unsigned int, std::string>> shader_paths,
+    const std::vector<const char*>& feedback_varyings) {
   auto shader = glCreateProgram();
   for (auto& [shader_type, path] : shader_paths) {
-    auto compiled_shader = CompileShader(shader_type, ReadFile(path));
+    auto source = FindAsset(path);
+    if (!source) {
+      throw std::runtime_error("Failed to open file: " + path);
+    }
+    auto compiled_shader = CompileShader(shader_type, source->Text());
     glAttachShader(shader, compiled_shader);
     glDeleteShader(compiled_shader);
   }
+  if (!feedback_varyings.empty()) {
+    glTransformFeedbackVaryings(shader,
+                                static_cast<int>(feedback_varyings.size()),
+                                feedback_varyings.data(),
+                                GL_INTERLEAVED_ATTRIBS);
+  }
   glLinkProgram(shader);
   int success;
   std::array<char, kLogSize> log{};
@@ -69,7 +73,7 @@ unsigned int LoadShaderProgram(
 
 // Framebuffer-related functions
 std::shared_ptr<Framebuffer> CreateFramebuffer(GLFWwindow* window,
-                                               float scale) {
+                                               float scale, bool depth) {
   std::shared_ptr<Framebuffer> framebuffer = std::make_shared<Framebuffer>();
   framebuffer->scale = scale;
   int width;
@@ -87,6 +91,14 @@ std::shared_ptr<Framebuffer> CreateFramebuffer(GLFWwindow* window,
   framebuffer->colorbuffer = CreateTextureObject(create_info);
   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
                          framebuffer->colorbuffer, 0);
+  framebuffer->depthbuffer = 0;
+  if (depth) {
+    glGenTextures(1, &framebuffer->depthbuffer);
+    loaded_textures.push_back(framebuffer->depthbuffer);
+    AllocateFramebuffer(*framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                           framebuffer->depthbuffer, 0);
+  }
   if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
     throw std::runtime_error("Framebuffer is not complete...");
   }
@@ -95,6 +107,26 @@ std::shared_ptr<Framebuffer> CreateFramebuffer(GLFWwindow* window,
   return framebuffer;
 }
 
+void AllocateFramebuffer(const Framebuffer& framebuffer) {
+  glBindTexture(GL_TEXTURE_2D, framebuffer.colorbuffer);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, framebuffer.size.x,
+               framebuffer.size.y, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+  auto pixels = static_cast<std::size_t>(framebuffer.size.x) *
+                static_cast<std::size_t>(framebuffer.size.y);
+  texture_bytes[framebuffer.colorbuffer] = pixels * 3;
+  if (framebuffer.depthbuffer == 0) {
+    return;
+  }
+  glBindTexture(GL_TEXTURE_2D, framebuffer.depthbuffer);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, framebuffer.size.x,
+               framebuffer.size.y, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT,
+               nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  // Usually padded to 4 bytes by the driver
+  texture_bytes[framebuffer.depthbuffer] = pixels * 4;
+}
+
 // Buffer and Texture-related functions
 unsigned int CreateVertexArrayObject(VertexArrayCreateInfo info) {
   unsigned int vao;
@@ -142,5 +174,8 @@ unsigned int CreateTextureObject(TextureCreateInfo info) {
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   loaded_textures.push_back(texture);
+  texture_bytes[texture] = static_cast<std::size_t>(info.width) *
+                           static_cast<std::size_t>(info.height) *
+                           static_cast<std::size_t>(info.channels);
   return texture;
 }
@@ -0,0 +1,658 @@
+#include "journal.h"
+
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "binary_scene.h"
+#include "log.h"
+#include "mapped_file.h"
+#include "texture.h"
+
+using binary_scene::AttributeType;
+
+namespace {
+constexpr std::array<char, 4> kMagic = {'V', 'B', 'J', 'N'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kNoPrefab = 0xFFFFFFFF;
+
+// Identifies the scene file a journal applies to. A journal whose base has
+// since been replaced (by a save that may have crashed before removing it)
+// is stale and must not be replayed again.
+struct BaseStamp {
+  std::uint64_t size;
+  std::int64_t modified;
+  bool operator==(const BaseStamp&) const = default;
+};
+
+struct FileHeader {
+  std::array<char, 4> magic;
+  std::uint32_t version;
+  BaseStamp base;
+};
+
+BaseStamp Stamp(std::string_view scene_path) {
+  std::error_code error;
+  auto size = std::filesystem::file_size(scene_path, error);
+  if (error) {
+    return {.size = 0, .modified = 0};
+  }
+  auto modified = std::filesystem::last_write_time(scene_path, error);
+  return {.size = size,
+          .modified = error ? 0 : modified.time_since_epoch().count()};
+}
+
+// Bounds-checked cursor over a mapped journal. Reads past the end return
+// nullopt, which is how a truncated last entry is detected.
+class Reader {
+ public:
+  Reader(const std::byte* data, std::size_t size) : data_(data), size_(size) {}
+
+  template <typename T>
+  std::optional<T> Get() {
+    if (size_ - offset_ < sizeof(T)) {
+      return std::nullopt;
+    }
+    T value;
+    std::memcpy(&value, data_ + offset_, sizeof(T));
+    offset_ += sizeof(T);
+    return value;
+  }
+
+  std::optional<std::string_view> GetString() {
+    auto length = Get<std::uint32_t>();
+    if (!length || size_ - offset_ < *length) {
+      return std::nullopt;
+    }
+    std::string_view value(reinterpret_cast<const char*>(data_ + offset_),
+                           *length);
+    offset_ += *length;
+    return value;
+  }
+
+  std::optional<AttributeData> GetValue() {
+    auto type = Get<std::uint8_t>();
+    if (!type) {
+      return std::nullopt;
+    }
+    auto floats = [&]<std::size_t N>() -> std::optional<std::array<float, N>> {
+      std::array<float, N> values{};
+      for (auto& value : values) {
+        auto v = Get<float>();
+        if (!v) {
+          return std::nullopt;
+        }
+        value = *v;
+      }
+      return values;
+    };
+    switch (static_cast<AttributeType>(*type)) {
+      case AttributeType::kInt:
+        if (auto v = Get<std::int32_t>()) {
+          return *v;
+        }
+        break;
+      case AttributeType::kFloat:
+        if (auto v = floats.operator()<1>()) {
+          return (*v)[0];
+        }
+        break;
+      case AttributeType::kVec2:
+        if (auto v = floats.operator()<2>()) {
+          return glm::vec2((*v)[0], (*v)[1]);
+        }
+        break;
+      case AttributeType::kVec3:
+        if (auto v = floats.operator()<3>()) {
+          return glm::vec3((*v)[0], (*v)[1], (*v)[2]);
+        }
+        break;
+      case AttributeType::kVec4:
+        if (auto v = floats.operator()<4>()) {
+          return glm::vec4((*v)[0], (*v)[1], (*v)[2], (*v)[3]);
+        }
+        break;
+      case AttributeType::kTexture:
+        if (auto path = GetString()) {
+          return Texture{.id = 0U, .path = InternTexturePath(*path)};
+        }
+        break;
+    }
+    return std::nullopt;
+  }
+
+ private:
+  const std::byte* data_;
+  std::size_t size_;
+  std::size_t offset_ = 0;
+};
+
+void Check(bool valid) {
+  if (!valid) {
+    throw std::runtime_error("Journal does not match the scene");
+  }
+}
+
+// A journal is recovery data and must never keep its scene from opening. One
+// that cannot be replayed is copied to <journal>.bad for inspection and cut
+// back to the `valid` bytes that were, so edits keep appending to entries
+// that match the scene.
+void SetAside(const std::string& path, std::size_t valid) {
+  std::error_code error;
+  std::filesystem::copy_file(path, path + ".bad",
+                             std::filesystem::copy_options::overwrite_existing,
+                             error);
+  if (valid == 0) {
+    std::filesystem::remove(path, error);
+  } else {
+    std::filesystem::resize_file(path, valid, error);
+  }
+}
+}  // namespace
+
+std::string JournalPath(std::string_view scene_path) {
+  return std::string(scene_path) + ".journal";
+}
+
+Journal::Journal(std::string_view scene_path) {
+  Attach(scene_path);
+}
+
+void Journal::AddObject(std::size_t index, const Object& object) {
+  if (!Recording()) {
+    return;
+  }
+  Begin(Operation::kAddObject, index);
+  PutString(object.name);
+  PutAttributes(object.attributes);
+  PutU32(static_cast<std::uint32_t>(object.tags.size()));
+  for (const auto& tag : object.tags) {
+    PutString(tag);
+  }
+  End();
+}
+
+void Journal::RemoveObject(std::size_t index) {
+  if (!Recording()) {
+    return;
+  }
+  Begin(Operation::kRemoveObject, index);
+  End();
+}
+
+void Journal::SetName(std::size_t object, std::string_view name) {
+  if (!Recording()) {
+    return;
+  }
+  Begin(Operation::kSetName, object);
+  PutString(name);
+  End();
+}
+
+void Journal::SetAttribute(std::size_t object, std::size_t attribute,
+                           std::string_view name, const AttributeData& value) {
+  if (!Recording()) {
+    return;
+  }
+  Begin(Operation::kSetAttribute, object);
+  PutU32(static_cast<std::uint32_t>(attribute));
+  PutString(name);
+  PutValue(value);
+  End();
+}
+
+void Journal::RemoveAttribute(std::size_t object, std::size_t attribute) {
+  if (!Recording()) {
+    return;
+  }
+  Begin(Operation::kRemoveAttribute, object);
+  PutU32(static_cast<std::uint32_t>(attribute));
+  End();
+}
+
+void Journal::SetTag(std::size_t object, std::size_t tag,
+                     std::string_view value) {
+  if (!Recording()) {
+    return;
+  }
+  Begin(Operation::kSetTag, object);
+  PutU32(static_cast<std::uint32_t>(tag));
+  PutString(value);
+  End();
+}
+
+void Journal::RemoveTag(std::size_t object, std::size_t tag) {
+  if (!Recording()) {
+    return;
+  }
+  Begin(Operation::kRemoveTag, object);
+  PutU32(static_cast<std::uint32_t>(tag));
+  End();
+}
+
+void Journal::SetPrefab(std::size_t object,
+                        std::optional<std::size_t> prefab) {
+  if (!Recording()) {
+    return;
+  }
+  Begin(Operation::kSetPrefab, object);
+  PutU32(prefab ? static_cast<std::uint32_t>(*prefab) : kNoPrefab);
+  End();
+}
+
+void Journal::AddPrefab(std::size_t index, const AttributeTemplate& prefab) {
+  if (!Recording()) {
+    return;
+  }
+  Begin(Operation::kAddPrefab, index);
+  PutString(prefab.name);
+  PutAttributes(prefab.attributes);
+  End();
+}
+
+void Journal::SetPrefabAttribute(std::size_t prefab, std::size_t attribute,
+                                 std::string_view name,
+                                 const AttributeData& value) {
+  if (!Recording()) {
+    return;
+  }
+  Begin(Operation::kSetPrefabAttribute, prefab);
+  PutU32(static_cast<std::uint32_t>(attribute));
+  PutString(name);
+  PutValue(value);
+  End();
+}
+
+void Journal::RemovePrefabAttribute(std::size_t prefab, std::size_t attribute) {
+  if (!Recording()) {
+    return;
+  }
+  Begin(Operation::kRemovePrefabAttribute, prefab);
+  PutU32(static_cast<std::uint32_t>(attribute));
+  End();
+}
+
+void Journal::Flush() {
+  if (compacting_ || streaming_ || pending_.empty()) {
+    return;
+  }
+  std::ofstream file(path_, std::ios::binary | std::ios::app);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open journal: " + path_);
+  }
+  if (file_size_ == 0) {
+    FileHeader header{.magic = kMagic,
+                      .version = kVersion,
+                      .base = {.size = base_size_, .modified = base_modified_}};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file_size_ = sizeof(header);
+  }
+  file.write(pending_.data(), static_cast<std::streamsize>(pending_.size()));
+  if (!file) {
+    throw std::runtime_error("Failed to write journal: " + path_);
+  }
+  file_size_ += pending_.size();
+  pending_.clear();
+}
+
+void Journal::BeginCompaction(std::string_view scene_path) {
+  if (!path_.empty()) {
+    Flush();
+  }
+  compacting_ = true;
+  compaction_scene_path_ = scene_path;
+}
+
+void Journal::EndCompaction(bool saved) {
+  compacting_ = false;
+  if (saved) {
+    Attach(std::exchange(compaction_scene_path_, ""));
+  }
+  if (!path_.empty()) {
+    Flush();
+  } else {
+    pending_.clear();
+  }
+}
+
+void Journal::BeginStream() {
+  streaming_ = true;
+}
+
+std::vector<std::size_t> Journal::EndStream(
+    std::string_view scene_path, std::vector<std::size_t> file_order) {
+  // Objects are only ever published at the end, past every object an edit
+  // could have addressed, so the held edits apply just the same to all
+  // objects in the order they were published. Replayed on them alongside
+  // `positions`, each edit learns its object's index in file order.
+  auto& positions = file_order;
+  for (std::size_t offset = 0; offset < pending_.size();) {
+    // See Begin for the framing
+    std::uint32_t size;
+    std::memcpy(&size, pending_.data() + offset, sizeof(size));
+    auto operation =
+        static_cast<Operation>(pending_[offset + sizeof(std::uint32_t)]);
+    auto* field = pending_.data() + offset + sizeof(std::uint32_t) + 1;
+    offset += sizeof(std::uint32_t) + size;
+    std::uint32_t index;
+    std::memcpy(&index, field, sizeof(index));
+    std::size_t position;
+    switch (operation) {
+      case Operation::kAddObject:
+        // Follows the object before it in file order too
+        position = index == 0 ? 0 : positions[index - 1] + 1;
+        for (auto& other : positions) {
+          other += other >= position ? 1 : 0;
+        }
+        positions.insert(positions.begin() + index, position);
+        break;
+      case Operation::kRemoveObject:
+        position = positions[index];
+        positions.erase(positions.begin() + index);
+        for (auto& other : positions) {
+          other -= other > position ? 1 : 0;
+        }
+        break;
+      case Operation::kAddPrefab:
+      case Operation::kSetPrefabAttribute:
+      case Operation::kRemovePrefabAttribute:
+        // Need no rewriting: the file's prefabs are published together, in
+        // file order
+        continue;
+      default:
+        position = positions[index];
+        break;
+    }
+    index = static_cast<std::uint32_t>(position);
+    std::memcpy(field, &index, sizeof(index));
+  }
+  streaming_ = false;
+  Attach(scene_path);
+  return std::move(positions);
+}
+
+void Journal::SetAside() {
+  if (path_.empty()) {
+    pending_.clear();
+    return;
+  }
+  Flush();
+  if (file_size_ != 0) {
+    ::SetAside(path_, 0);
+    file_size_ = 0;
+  }
+}
+
+void Journal::Attach(std::string_view scene_path) {
+  path_ = JournalPath(scene_path);
+  auto base = Stamp(scene_path);
+  base_size_ = base.size;
+  base_modified_ = base.modified;
+  // Keep an existing journal only if it belongs to this exact base file;
+  // otherwise it was not replayed and must not be appended to.
+  file_size_ = 0;
+  if (std::filesystem::exists(path_)) {
+    MappedFile file(path_);
+    Reader reader(file.Data(), file.Size());
+    auto header = reader.Get<FileHeader>();
+    if (header && header->magic == kMagic && header->version == kVersion &&
+        header->base == base) {
+      file_size_ = file.Size();
+    }
+  }
+  if (file_size_ == 0) {
+    std::error_code error;
+    std::filesystem::remove(path_, error);
+  }
+}
+
+// Entries are framed as [u32 size][u8 operation][u32 object][payload]. Begin
+// reserves the size, End fills it in.
+void Journal::Begin(Operation operation, std::size_t object) {
+  entry_start_ = pending_.size();
+  PutU32(0);
+  pending_ += static_cast<char>(operation);
+  PutU32(static_cast<std::uint32_t>(object));
+}
+
+void Journal::End() {
+  auto size = static_cast<std::uint32_t>(pending_.size() - entry_start_ -
+                                         sizeof(std::uint32_t));
+  std::memcpy(pending_.data() + entry_start_, &size, sizeof(size));
+}
+
+void Journal::PutU32(std::uint32_t value) {
+  pending_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void Journal::PutString(std::string_view value) {
+  PutU32(static_cast<std::uint32_t>(value.size()));
+  pending_ += value;
+}
+
+void Journal::PutValue(const AttributeData& value) {
+  auto put_floats = [&](std::initializer_list<float> floats) {
+    for (float f : floats) {
+      pending_.append(reinterpret_cast<const char*>(&f), sizeof(f));
+    }
+  };
+  std::visit(
+      [&](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, int>) {
+          pending_ += static_cast<char>(AttributeType::kInt);
+          pending_.append(reinterpret_cast<const char*>(&v), sizeof(v));
+        } else if constexpr (std::is_same_v<T, float>) {
+          pending_ += static_cast<char>(AttributeType::kFloat);
+          put_floats({v});
+        } else if constexpr (std::is_same_v<T, glm::vec2>) {
+          pending_ += static_cast<char>(AttributeType::kVec2);
+          put_floats({v.x, v.y});
+        } else if constexpr (std::is_same_v<T, glm::vec3>) {
+          pending_ += static_cast<char>(AttributeType::kVec3);
+          put_floats({v.x, v.y, v.z});
+        } else if constexpr (std::is_same_v<T, glm::vec4>) {
+          pending_ += static_cast<char>(AttributeType::kVec4);
+          put_floats({v.x, v.y, v.z, v.w});
+        } else if constexpr (std::is_same_v<T, Texture>) {
+          pending_ += static_cast<char>(AttributeType::kTexture);
+          PutString(v.Path());
+        }
+      },
+      value);
+}
+
+void Journal::PutAttributes(
+    const std::vector<std::pair<std::string, AttributeData>>& attributes) {
+  PutU32(static_cast<std::uint32_t>(attributes.size()));
+  for (const auto& [name, value] : attributes) {
+    PutString(name);
+    PutValue(value);
+  }
+}
+
+void ReplayJournal(std::string_view scene_path, Scene& scene,
+                   bool load_textures) {
+  using Operation = Journal::Operation;
+  auto path = JournalPath(scene_path);
+  if (!std::filesystem::exists(path)) {
+    return;
+  }
+  // Closed before the journal is set aside, which Windows requires
+  std::optional<MappedFile> file(std::in_place, path);
+  auto header = Reader(file->Data(), file->Size()).Get<FileHeader>();
+  if (!header || header->magic != kMagic || header->version != kVersion) {
+    file.reset();
+    SetAside(path, 0);
+    PostLog("Not a scene journal, kept as " + path + ".bad",
+            LogLevel::kWarning);
+    return;
+  }
+  if (header->base != Stamp(scene_path)) {
+    return;  // Stale: already folded into a newer base file
+  }
+
+  // By path handle
+  std::unordered_map<std::uint32_t, unsigned int> textures;
+  auto load = [&](AttributeData value) {
+    if (auto* texture = std::get_if<Texture>(&value); texture && load_textures) {
+      auto [it, inserted] = textures.try_emplace(texture->path, 0U);
+      if (inserted) {
+        it->second = LoadTexture(texture->Path()).id;
+      }
+      texture->id = it->second;
+    }
+    return value;
+  };
+
+  using Attributes = std::vector<std::pair<std::string, AttributeData>>;
+  auto get_attributes = [&](Reader& entry, Attributes& attributes) {
+    auto count = entry.Get<std::uint32_t>();
+    Check(count.has_value());
+    for (std::uint32_t i = 0; i < *count; i++) {
+      auto name = entry.GetString();
+      auto value = entry.GetValue();
+      Check(name && value);
+      attributes.emplace_back(*name, load(*value));
+    }
+  };
+  auto set_attribute = [&](Reader& entry, Attributes& attributes) {
+    auto attribute = entry.Get<std::uint32_t>();
+    auto name = entry.GetString();
+    auto value = entry.GetValue();
+    Check(attribute && name && value && *attribute <= attributes.size());
+    if (*attribute == attributes.size()) {
+      attributes.emplace_back(*name, load(*value));
+    } else {
+      attributes[*attribute] = {std::string(*name), load(*value)};
+    }
+  };
+  auto remove_attribute = [&](Reader& entry, Attributes& attributes) {
+    auto attribute = entry.Get<std::uint32_t>();
+    Check(attribute && *attribute < attributes.size());
+    attributes.erase(attributes.begin() + *attribute);
+  };
+
+  std::size_t offset = sizeof(FileHeader);
+  // Each entry is checked before it changes the scene, so the entries before
+  // one that does not apply leave it consistent
+  std::size_t entry_start = offset;
+  try {
+    while (offset < file->Size()) {
+      entry_start = offset;
+      Reader frame(file->Data() + offset, file->Size() - offset);
+      auto size = frame.Get<std::uint32_t>();
+      if (!size || file->Size() - offset - sizeof(std::uint32_t) < *size) {
+        // From a crash mid-append. Cut off, or the next edit would be
+        // appended to it.
+        throw std::runtime_error("Journal ends in a truncated entry");
+      }
+      Reader entry(file->Data() + offset + sizeof(std::uint32_t), *size);
+      offset += sizeof(std::uint32_t) + *size;
+
+      auto operation = entry.Get<Operation>();
+      auto index = entry.Get<std::uint32_t>();
+      Check(operation && index);
+      auto& objects = scene.objects;
+      auto& prefabs = scene.prefabs;
+      switch (*operation) {
+        case Operation::kAddObject: {
+          Check(*index <= objects.size());
+          auto object = std::make_shared<Object>();
+          auto name = entry.GetString();
+          Check(name.has_value());
+          object->name = *name;
+          get_attributes(entry, object->attributes);
+          auto tag_count = entry.Get<std::uint32_t>();
+          Check(tag_count.has_value());
+          for (std::uint32_t i = 0; i < *tag_count; i++) {
+            auto tag = entry.GetString();
+            Check(tag.has_value());
+            object->tags.emplace_back(*tag);
+          }
+          objects.insert(objects.begin() + *index, std::move(object));
+          continue;
+        }
+        case Operation::kRemoveObject:
+          Check(*index < objects.size());
+          objects.erase(objects.begin() + *index);
+          continue;
+        case Operation::kAddPrefab: {
+          Check(*index <= prefabs.size());
+          auto prefab = std::make_shared<AttributeTemplate>();
+          auto name = entry.GetString();
+          Check(name.has_value());
+          prefab->name = *name;
+          get_attributes(entry, prefab->attributes);
+          prefabs.insert(prefabs.begin() + *index, std::move(prefab));
+          continue;
+        }
+        case Operation::kSetPrefabAttribute:
+          Check(*index < prefabs.size());
+          set_attribute(entry, DetachPrefab(scene, *index).attributes);
+          continue;
+        case Operation::kRemovePrefabAttribute:
+          Check(*index < prefabs.size());
+          remove_attribute(entry, DetachPrefab(scene, *index).attributes);
+          continue;
+        default:
+          break;
+      }
+
+      Check(*index < objects.size());
+      // A save may hold a snapshot of the scene that is being replayed into
+      auto& object = Detach(objects[*index]);
+      switch (*operation) {
+        case Operation::kSetName: {
+          auto name = entry.GetString();
+          Check(name.has_value());
+          object.name = *name;
+          break;
+        }
+        case Operation::kSetAttribute:
+          set_attribute(entry, object.attributes);
+          break;
+        case Operation::kRemoveAttribute:
+          remove_attribute(entry, object.attributes);
+          break;
+        case Operation::kSetTag: {
+          auto tag = entry.Get<std::uint32_t>();
+          auto value = entry.GetString();
+          Check(tag && value && *tag <= object.tags.size());
+          if (*tag == object.tags.size()) {
+            object.tags.emplace_back(*value);
+          } else {
+            object.tags[*tag] = *value;
+          }
+          break;
+        }
+        case Operation::kRemoveTag: {
+          auto tag = entry.Get<std::uint32_t>();
+          Check(tag && *tag < object.tags.size());
+          object.tags.erase(object.tags.begin() + *tag);
+          break;
+        }
+        case Operation::kSetPrefab: {
+          auto prefab = entry.Get<std::uint32_t>();
+          Check(prefab && (*prefab == kNoPrefab || *prefab < prefabs.size()));
+          object.prefab = *prefab == kNoPrefab ? nullptr : prefabs[*prefab];
+          break;
+        }
+        default:
+          Check(false);
+      }
+    }
+  } catch (const std::runtime_error& e) {
+    file.reset();
+    SetAside(path, entry_start);
+    PostLog(std::string(e.what()) + ": replayed up to the bad entry, kept as " +
+                path + ".bad",
+            LogLevel::kWarning);
+  }
+}
@@ -0,0 +1,184 @@
+#include "light_lod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+namespace {
+// Lights on the view are treated as this far away, so nearby lights still
+// merge with their immediate neighbours
+constexpr float kNearDistance = 0.1F;
+// Dimmer lights than this are all treated alike
+constexpr float kMinContribution = 1e-4F;
+// Coarsening steps, each doubling the error, before the least contributing
+// clusters are merged outright
+constexpr int kMaxCoarsening = 8;
+
+// Distance from the view, [0, 1] in both axes.
+float ViewDistance(glm::vec2 position) {
+  glm::vec2 outside = glm::max(glm::max(-position, position - 1.0F),
+                               glm::vec2(0.0F));
+  return glm::length(outside);
+}
+
+// Brightest the light gets anywhere on the view.
+float Contribution(const LightProxy& light, float distance) {
+  return light.intensity / (1.0F + light.falloff * distance * distance);
+}
+
+std::uint64_t CellKey(int level, glm::vec2 position, float size) {
+  auto x = static_cast<std::int64_t>(std::floor(position.x / size));
+  auto y = static_cast<std::int64_t>(std::floor(position.y / size));
+  return (static_cast<std::uint64_t>(level & 0xFF) << 56U) |
+         ((static_cast<std::uint64_t>(x) & 0xFFFFFFFU) << 28U) |
+         (static_cast<std::uint64_t>(y) & 0xFFFFFFFU);
+}
+}  // namespace
+
+LightLod::LightLod(LightLodOptions options) : options_(options) {}
+
+std::span<const LightProxy> LightLod::Reduce(
+    std::span<const LightProxy> lights) {
+  std::size_t global = std::ranges::count_if(
+      lights, [](const LightProxy& light) { return light.type != 1; });
+  auto limit = options_.budget > global ? options_.budget - global : 1;
+  float error = std::max(options_.error_bound, 0.0F);
+  Measure(lights);
+  Group(lights, error);
+  for (int step = 0; step < kMaxCoarsening && clusters_.size() > limit;
+       step++) {
+    error = std::max(error * 2.0F, kNearDistance);
+    Group(lights, error);
+  }
+  if (clusters_.size() > limit) {
+    Truncate(limit);
+  }
+  Emit(lights);
+  stats_.lights = lights.size();
+  stats_.shaded = shaded_.size();
+  stats_.error = error;
+  return shaded_;
+}
+
+void LightLod::Measure(std::span<const LightProxy> lights) {
+  measured_.clear();
+  for (std::size_t i = 0; i < lights.size(); i++) {
+    const auto& light = lights[i];
+    if (light.type != 1) {
+      continue;
+    }
+    float distance = ViewDistance(glm::vec2(light.position));
+    float contribution = Contribution(light, distance);
+    float dimming =
+        1.0F / std::sqrt(std::clamp(contribution, kMinContribution, 1.0F));
+    measured_.push_back({.index = i,
+                         .scale = (distance + kNearDistance) * dimming,
+                         .contribution = contribution});
+  }
+  cells_.reserve(measured_.size());
+}
+
+void LightLod::Group(std::span<const LightProxy> lights, float error) {
+  clusters_.clear();
+  cells_.clear();
+  for (const auto& [i, scale, contribution] : measured_) {
+    const auto& light = lights[i];
+    float size = error * scale;
+    std::size_t index = clusters_.size();
+    if (size > 0.0F) {
+      // Cells come in powers of two so that lights of similar size share them
+      int exponent;
+      std::frexp(size, &exponent);
+      auto [cell, inserted] = cells_.try_emplace(
+          CellKey(exponent, glm::vec2(light.position),
+                  std::ldexp(1.0F, exponent)),
+          index);
+      index = cell->second;
+    }
+    if (index == clusters_.size()) {
+      clusters_.push_back({.position = glm::vec3(0.0F),
+                           .color = glm::vec3(0.0F),
+                           .falloff = 0.0F,
+                           .volumetric_intensity = 0.0F,
+                           .intensity = 0.0F,
+                           .weight = 0.0F,
+                           .contribution = 0.0F,
+                           .first = i,
+                           .count = 0});
+    }
+    auto& cluster = clusters_[index];
+    float weight = std::max(light.intensity, kMinContribution);
+    cluster.position += light.position * weight;
+    cluster.color += light.color * weight;
+    cluster.falloff += light.falloff * weight;
+    cluster.volumetric_intensity += light.volumetric_intensity * weight;
+    cluster.intensity += light.intensity;
+    cluster.weight += weight;
+    cluster.contribution += contribution;
+    cluster.count++;
+  }
+}
+
+void LightLod::Truncate(std::size_t limit) {
+  // Keeps the original order of the survivors, so shadow map rows stay put
+  std::vector<std::size_t> order(clusters_.size());
+  for (std::size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::ranges::stable_sort(order, [&](std::size_t a, std::size_t b) {
+    return clusters_[a].contribution > clusters_[b].contribution;
+  });
+  std::vector<bool> kept(clusters_.size(), false);
+  for (std::size_t i = 0; i + 1 < limit; i++) {
+    kept[order[i]] = true;
+  }
+  std::vector<Cluster> truncated;
+  std::optional<Cluster> rest;
+  for (std::size_t i = 0; i < clusters_.size(); i++) {
+    const auto& cluster = clusters_[i];
+    if (kept[i]) {
+      truncated.push_back(cluster);
+    } else if (!rest) {
+      rest = cluster;
+    } else {
+      rest->position += cluster.position;
+      rest->color += cluster.color;
+      rest->falloff += cluster.falloff;
+      rest->volumetric_intensity += cluster.volumetric_intensity;
+      rest->intensity += cluster.intensity;
+      rest->weight += cluster.weight;
+      rest->contribution += cluster.contribution;
+      rest->count += cluster.count;
+    }
+  }
+  truncated.push_back(*rest);
+  clusters_ = std::move(truncated);
+}
+
+void LightLod::Emit(std::span<const LightProxy> lights) {
+  shaded_.clear();
+  for (const auto& light : lights) {
+    if (light.type != 1) {
+      shaded_.push_back(light);
+    }
+  }
+  stats_.merged = 0;
+  stats_.aggregates = 0;
+  for (const auto& cluster : clusters_) {
+    if (cluster.count == 1) {
+      shaded_.push_back(lights[cluster.first]);
+      continue;
+    }
+    // Centred on the cluster's light, with its total intensity so that the
+    // view receives about as much light from a distance
+    shaded_.push_back({.position = cluster.position / cluster.weight,
+                       .type = 1,
+                       .color = cluster.color / cluster.weight,
+                       .intensity = cluster.intensity,
+                       .falloff = cluster.falloff / cluster.weight,
+                       .volumetric_intensity =
+                           cluster.volumetric_intensity / cluster.weight});
+    stats_.merged += cluster.count;
+    stats_.aggregates++;
+  }
+}
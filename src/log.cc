@@ -0,0 +1,28 @@
+#include "log.h"
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+std::map<std::string, LogLevel> output_log;
+
+namespace {
+std::mutex posted_mutex;
+std::vector<std::pair<std::string, LogLevel>> posted;
+}  // namespace
+
+void PostLog(std::string message, LogLevel level) {
+  std::scoped_lock lock(posted_mutex);
+  posted.emplace_back(std::move(message), level);
+}
+
+void FlushLog() {
+  std::vector<std::pair<std::string, LogLevel>> messages;
+  {
+    std::scoped_lock lock(posted_mutex);
+    messages.swap(posted);
+  }
+  for (auto& [message, level] : messages) {
+    output_log[std::move(message)] = level;
+  }
+}
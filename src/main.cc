@@ -8,42 +8,37 @@
 
 #include <algorithm>
 #include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
 #include <tinyfiledialogs/tinyfiledialogs.h>
 
 #include <array>
+#include <chrono>
 #include <filesystem>
 #include <format>
+#include <fstream>
 #include <print>
 #include <string>
 #include <map>
+#include <optional>
+#include <thread>
+#include "asset_pack.h"
 #include "docs.h"
 #include "tutorial.h"
 #include "core.h"
 #include "helpers.h"
+#include "journal.h"
+#include "memory_report.h"
+#include "object_filter.h"
+#include "renderer.h"
 #include "scene.h"
+#include "scene_save.h"
+#include "scene_stream.h"
+#include "scene_watcher.h"
+#include "simulation.h"
+#include "static_lighting.h"
 #include "texture.h"
 #include "description.h"
-
-std::map<std::string, LogLevel> output_log;
-
-Texture LoadTexture(const std::string& path) {
-  int w;
-  int h;
-  int nr_channels;
-  auto* data = stbi_load(path.c_str(), &w, &h, &nr_channels, 0);
-  if (data) {
-    auto texture = CreateTextureObject(
-        {.width = w, .height = h, .channels = nr_channels, .data = data});
-    stbi_image_free(data);
-    return {.id=texture, .path=path};
-  }
-  stbi_image_free(data);
-  return {.id=0U, .path=path};
-}
+#include "frame_benchmark.h"
 
 namespace {
 void ClearAllInfo() {
@@ -58,19 +53,48 @@ void ClearAllInfo() {
   }
 }
 constexpr glm::ivec2 kDefaultWindowSize = {800, 600};
-constexpr std::array<float, 20> kSpriteVertices = {
-    0.5F,  0.5F,  0.0F, 1.0F, 1.0F, 0.5F,  -0.5F, 0.0F, 1.0F, 0.0F,
-    -0.5F, -0.5F, 0.0F, 0.0F, 0.0F, -0.5F, 0.5F,  0.0F, 0.0F, 1.0F};
-constexpr std::array<float, 16> kDeferredVertices = {
-    1.0F,  1.0F,  1.0F, 1.0F, 1.0F,  -1.0F, 1.0F, 0.0F,
-    -1.0F, -1.0F, 0.0F, 0.0F, -1.0F, 1.0F,  0.0F, 1.0F};
-constexpr std::array<unsigned int, 6> kSharedIndices = {0, 1, 3, 1, 2, 3};
+// Time per frame spent moving streamed objects into the scene
+constexpr auto kSceneStreamBudget = std::chrono::milliseconds(4);
 Scene scene;
+// Edits are appended to the scene's journal this often
+constexpr auto kAutosaveInterval = std::chrono::seconds(5);
+// A journal this large is folded back into the scene file
+constexpr std::size_t kJournalCompactionSize = 16 << 20;
+std::unique_ptr<SceneStream> scene_stream;
+std::unique_ptr<SceneSave> scene_save;
+// Follows scene_path, reloading changes other tools make to the file
+std::unique_ptr<SceneWatcher> scene_watcher;
+// A reload that would replace unsaved edits, held until the user picks one
+std::optional<SceneWatcher::Reload> held_reload;
+constexpr const char* kReloadPopup = "Scene Changed on Disk";
+// Scene updates run on their own thread, 60 ticks a second
+constexpr auto kSimulationTimestep = std::chrono::nanoseconds(1'000'000'000 / 60);
+// Created in main() once there is a window; every change to `scene` is
+// mirrored to it
+std::unique_ptr<Simulation> simulation;
+// Shadow maps redrawn per frame at most; the others wait their turn
+constexpr std::size_t kShadowRefreshesPerFrame = 4;
+// Created in main() once there is a window; its lightmap is saved with the
+// scene
+std::unique_ptr<Renderer> renderer;
+Journal journal;
+// The Edit window lists the filtered objects and inspects the selected ones
+ObjectFilter object_filter;
+std::string object_filter_query;
+std::vector<std::size_t> selected_objects;  // Sorted scene indices
+std::string scene_path;
 glm::vec3 clear_color = {0.1F, 0.1F, 0.1F};
 std::vector<AttributeTemplate> attribute_templates;
 bool show_template_window = false;
+bool show_prefab_window = false;
 bool show_edit_window = true;
 bool show_output_window = false;
+bool show_memory_window = false;
+// Measuring walks the whole scene, so the Memory window refreshes this often
+constexpr auto kMemoryReportInterval = std::chrono::seconds(1);
+MemoryReport memory_report;
+std::chrono::steady_clock::time_point memory_report_time;
+bool show_lighting_window = false;
 bool show_tutorial_window = false;
 bool show_documentation_window = false;
 bool show_demo_window = false;
@@ -81,25 +105,39 @@ void Hover(std::string_view text) {
   }
 }
 
-void GetInspector(AttributeData& data, std::string hover_text = "") {
+// Returns true once an edit to `data` is complete, for the journal. Sets
+// `changed`, if given, whenever a widget writes to `data`, as it does while
+// typing.
+bool GetInspector(AttributeData& data, std::string hover_text = "",
+                  bool* changed = nullptr) {
+  bool edited = false;
+  bool written = false;
   std::visit(
       [&](auto& v) {
         using T = std::decay_t<decltype(v)>;
         if constexpr (std::is_same_v<T, int>) {
           ImGui::SameLine();
           ImGui::InputInt("##value", &v);
+          written |= ImGui::IsItemEdited();
+          edited = ImGui::IsItemDeactivatedAfterEdit();
           Hover(hover_text);
         } else if constexpr (std::is_same_v<T, float>) {
           ImGui::SameLine();
           ImGui::InputFloat("##value", &v);
+          written |= ImGui::IsItemEdited();
+          edited = ImGui::IsItemDeactivatedAfterEdit();
           Hover(hover_text);
         } else if constexpr (std::is_same_v<T, glm::vec2>) {
           ImGui::SameLine();
           ImGui::InputFloat2("##value", glm::value_ptr(v));
+          written |= ImGui::IsItemEdited();
+          edited = ImGui::IsItemDeactivatedAfterEdit();
           Hover(hover_text);
         } else if constexpr (std::is_same_v<T, glm::vec3>) {
           ImGui::SameLine();
           ImGui::InputFloat3("##value", glm::value_ptr(v));
+          written |= ImGui::IsItemEdited();
+          edited = ImGui::IsItemDeactivatedAfterEdit();
           Hover(hover_text);
         } else if constexpr (std::is_same_v<T, Texture>) {
           ImGui::Image(v.id, ImVec2(64, 64));
@@ -110,7 +148,9 @@ void GetInspector(AttributeData& data, std::string hover_text = "") {
                                                "Image Files", 0);
             if (path) {
               try {
-                v = LoadTexture(std::string(path));
+                v = LoadTexture(path);
+                edited = true;
+                written = true;
               } catch (const std::runtime_error& e) {
                 std::print("Error loading texture: {}\n", e.what());
               }
@@ -118,8 +158,11 @@ void GetInspector(AttributeData& data, std::string hover_text = "") {
           }
           ImGui::SameLine();
           if (ImGui::Button("Remove Texture")) {
-            glDeleteTextures(1, &v.id);
-            v.id = 0;
+            // Only clears the attribute: loaded textures are shared by every
+            // object using the path, and freed at exit
+            v = {};
+            edited = true;
+            written = true;
           }
         } else {
           ImGui::Text("Unknown Attribute Type");
@@ -127,6 +170,204 @@ void GetInspector(AttributeData& data, std::string hover_text = "") {
         }
       },
       data);
+  if (changed != nullptr) {
+    *changed |= written;
+  }
+  return edited;
+}
+
+// Draws the "Select Attribute Type" modal and returns a default value of the
+// chosen type once Add is pressed.
+std::optional<AttributeData> AttributeTypePopup() {
+  std::optional<AttributeData> value;
+  if (ImGui::BeginPopupModal("Select Attribute Type")) {
+    static int attr_type = 0;
+    ImGui::RadioButton("int", &attr_type, 0);
+    ImGui::RadioButton("float", &attr_type, 1);
+    ImGui::RadioButton("vec2", &attr_type, 2);
+    ImGui::RadioButton("vec3", &attr_type, 3);
+    ImGui::RadioButton("texture", &attr_type, 4);
+    if (ImGui::Button("Add")) {
+      switch (attr_type) {
+        case 0:
+          value = 0;
+          break;
+        case 1:
+          value = 0.0F;
+          break;
+        case 2:
+          value = glm::vec2(0.0F);
+          break;
+        case 3:
+          value = glm::vec3(0.0F);
+          break;
+        case 4:
+          value = Texture{.id = 0U, .path = 0U};
+          break;
+        default:
+          break;
+      }
+      ImGui::CloseCurrentPopup();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Cancel")) {
+      ImGui::CloseCurrentPopup();
+    }
+    ImGui::EndPopup();
+  }
+  return value;
+}
+
+// Index of the scene's prefab made from `attr_template`, adding one if the
+// scene has none by that name yet.
+std::size_t UsePrefab(const AttributeTemplate& attr_template) {
+  for (std::size_t i = 0; i < scene.prefabs.size(); i++) {
+    if (scene.prefabs[i]->name == attr_template.name) {
+      return i;
+    }
+  }
+  scene.prefabs.push_back(std::make_shared<AttributeTemplate>(attr_template));
+  journal.AddPrefab(scene.prefabs.size() - 1, attr_template);
+  simulation->SetPrefab(scene, scene.prefabs.size() - 1);
+  return scene.prefabs.size() - 1;
+}
+
+void OpenScene(std::string_view path, glm::vec2 focus) {
+  // Streamed in over the next frames; the journal is attached once complete
+  scene_stream.reset();
+  scene = Scene();
+  journal = Journal();
+  journal.BeginStream();
+  scene_path.clear();
+  selected_objects.clear();
+  object_filter.Invalidate();
+  simulation->Reset(scene);
+  scene_stream = std::make_unique<SceneStream>(path, focus);
+}
+
+void SaveSceneInBackground(std::string_view path) {
+  journal.BeginCompaction(path);
+  scene_save = std::make_unique<SceneSave>(scene, path);
+}
+
+void PollSceneSave() {
+  if (!scene_save) {
+    return;
+  }
+  try {
+    if (!scene_save->Poll()) {
+      return;
+    }
+    scene_path = scene_save->Path();
+    journal.EndCompaction(true);
+    if (scene_watcher && scene_watcher->Path() == scene_path) {
+      scene_watcher->Ignore();
+    }
+  } catch (const std::runtime_error& e) {
+    std::print("Error saving scene: {}\n", e.what());
+    journal.EndCompaction(false);
+    scene_save.reset();
+    return;
+  }
+  scene_save.reset();
+  try {
+    renderer->SaveLightmap(LightmapPath(scene_path));
+  } catch (const std::runtime_error& e) {
+    output_log["Error saving lightmap: " + std::string(e.what())] =
+        LogLevel::kError;
+  }
+}
+
+void ApplyReload(SceneWatcher::Reload& reload) {
+  auto start = std::chrono::steady_clock::now();
+  const auto& diff = reload.diff;
+  ApplySceneDiff(scene, reload.file, diff, *simulation);
+  // Its edits were made to the scene the file replaced
+  journal = Journal(scene_path);
+  if (diff.added != 0 || !diff.removed.empty() || diff.reordered) {
+    selected_objects.clear();
+  }
+  object_filter.Invalidate();
+  output_log[std::format(
+      "Reloaded {}: {} added, {} removed, {} changed in {:.1f} ms",
+      scene_path, diff.added, diff.removed.size(), diff.changed.size(),
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - start)
+          .count())] = LogLevel::kInfo;
+}
+
+void PollSceneWatcher() {
+  if (scene_path.empty() || scene_stream) {
+    scene_watcher.reset();
+    held_reload.reset();
+    return;
+  }
+  if (!scene_watcher || scene_watcher->Path() != scene_path) {
+    scene_watcher = std::make_unique<SceneWatcher>(scene_path);
+  }
+  // The save about to finish would overwrite the reload
+  if (scene_save || held_reload) {
+    return;
+  }
+  std::optional<SceneWatcher::Reload> reload;
+  try {
+    reload = scene_watcher->Poll(scene);
+  } catch (const std::runtime_error& e) {
+    output_log["Error reloading scene: " + std::string(e.what())] =
+        LogLevel::kWarning;
+    return;
+  }
+  if (!reload) {
+    return;
+  }
+  // Unsaved edits are in the journal until a save folds them into the file.
+  // The reload modal blocks editing, so the diff still applies once answered.
+  if (journal.Size() != 0) {
+    held_reload = std::move(reload);
+    return;
+  }
+  ApplyReload(*reload);
+}
+
+// Asks whether the held reload replaces the unsaved edits or is dropped.
+void ReloadPopup() {
+  if (!held_reload) {
+    return;
+  }
+  if (!ImGui::IsPopupOpen(kReloadPopup)) {
+    ImGui::OpenPopup(kReloadPopup);
+  }
+  if (ImGui::BeginPopupModal(kReloadPopup, nullptr,
+                             ImGuiWindowFlags_AlwaysAutoResize)) {
+    ImGui::Text("%s was changed by another program, and the scene has "
+                "unsaved edits.",
+                scene_path.c_str());
+    if (ImGui::Button("Reload")) {
+      journal.SetAside();
+      output_log["Unsaved edits replaced by the reload were kept as " +
+                 JournalPath(scene_path) + ".bad"] = LogLevel::kWarning;
+      ApplyReload(*held_reload);
+      held_reload.reset();
+      ImGui::CloseCurrentPopup();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Keep Edits")) {
+      output_log["Kept unsaved edits; the next save overwrites the changes "
+                 "made to " +
+                 scene_path] = LogLevel::kWarning;
+      held_reload.reset();
+      ImGui::CloseCurrentPopup();
+    }
+    ImGui::EndPopup();
+  }
+}
+
+void Autosave() {
+  try {
+    journal.Flush();
+  } catch (const std::runtime_error& e) {
+    output_log["Autosave failed: " + std::string(e.what())] = LogLevel::kError;
+  }
 }
 
 void FramebufferResizeCallback(GLFWwindow* /*window*/, int w, int h) {
@@ -135,9 +376,7 @@ void FramebufferResizeCallback(GLFWwindow* /*window*/, int w, int h) {
         glm::ivec2(std::max(1, static_cast<int>(w * framebuffer->scale)),
                    std::max(1, static_cast<int>(h * framebuffer->scale)));
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->id);
-    glBindTexture(GL_TEXTURE_2D, framebuffer->colorbuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, framebuffer->size.x,
-                 framebuffer->size.y, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    AllocateFramebuffer(*framebuffer);
     assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
   }
@@ -151,52 +390,61 @@ void PresentGlfwErrorInfo() {
   }
 }
 
-void SetLightUniforms(std::vector<std::shared_ptr<Object>>& lights,
-                             unsigned int shader) {
-  auto light_objects = std::vector<std::shared_ptr<Object>>{};
-  for (auto& object : lights) {
-    if (object->HasTag("light")) {
-      light_objects.push_back(object);
+
+// Prints the memory report of a scene as JSON, or writes it to `output`.
+int ReportSceneMemory(std::string_view path, const char* output) {
+  try {
+    auto scene = LoadScene(path, false);
+    auto report = MeasureMemory(scene);
+    // Nothing is uploaded without an OpenGL context
+    report.textures = EstimateTextureBytes(scene);
+    if (output == nullptr) {
+      std::print("{}", report.ToJson());
+      return EXIT_SUCCESS;
     }
-  }
-  glUniform1i(glGetUniformLocation(shader, "light_count"),
-              light_objects.size());
-  for (int i = 0; i < light_objects.size(); i++) {
-    int type;
-    glm::vec3 position;
-    float intensity;
-    glm::vec3 color;
-    float falloff;
-    float volumetric_intensity;
-    try {
-      type = std::get<int>(light_objects[i]->GetAttribute("light.type"));
-      position = std::get<glm::vec3>(light_objects[i]->GetAttribute("transform.position"));
-      intensity = std::get<float>(light_objects[i]->GetAttribute("light.intensity"));
-      color = std::get<glm::vec3>(light_objects[i]->GetAttribute("light.color"));
-      falloff = std::get<float>(light_objects[i]->GetAttribute("light.radial_falloff"));
-      volumetric_intensity = std::get<float>(light_objects[i]->GetAttribute("light.volumetric_intensity"));
-    } catch (const std::runtime_error& e) {
-      output_log["Error retrieving light attributes: " + std::string(e.what())] = LogLevel::kError;
-      continue;
+    std::ofstream file(output);
+    file << report.ToJson();
+    if (!file) {
+      throw std::runtime_error("Failed to write file: " + std::string(output));
     }
-    auto prefix = std::format("lights[{}].", i);
-    glUniform1i(glGetUniformLocation(shader, (prefix + "type").c_str()), type);
-    glUniform3fv(glGetUniformLocation(shader, (prefix + "position").c_str()), 1,
-                glm::value_ptr(position));
-    glUniform1f(glGetUniformLocation(shader, (prefix + "intensity").c_str()),
-                intensity);
-    glUniform3fv(glGetUniformLocation(shader, (prefix + "color").c_str()), 1,
-                 glm::value_ptr(color));
-    glUniform1f(glGetUniformLocation(shader, (prefix + "falloff").c_str()),
-                falloff);
-    glUniform1f(
-        glGetUniformLocation(shader, (prefix + "volumetric_intensity").c_str()),
-        volumetric_intensity);
+  } catch (const std::runtime_error& e) {
+    std::print("Error reporting memory: {}\n", e.what());
+    return EXIT_FAILURE;
   }
+  return EXIT_SUCCESS;
 }
 }
 
-int main(int /*argc*/, char* /*argv*/[]) {
+int main(int argc, char* argv[]) {
+  // Installs read their assets from one pack; without it they are read loose
+  if (std::filesystem::exists(asset_pack::kDefaultPath)) {
+    try {
+      MountAssetPack(asset_pack::kDefaultPath);
+    } catch (const std::runtime_error& e) {
+      std::print("Error opening asset pack, using loose files: {}\n", e.what());
+    }
+  }
+  if (argc >= 2 && std::string_view(argv[1]) == "--benchmark") {
+    try {
+      return RunFrameBenchmark(ParseFrameBenchmarkOptions(argc, argv));
+    } catch (const std::exception& e) {
+      std::print("{}\n", e.what());
+      return EXIT_FAILURE;
+    }
+  }
+  if ((argc == 3 || argc == 4) &&
+      std::string_view(argv[1]) == "--memory-report") {
+    return ReportSceneMemory(argv[2], argc == 4 ? argv[3] : nullptr);
+  }
+  if (argc == 4 && std::string_view(argv[1]) == "--convert") {
+    try {
+      ConvertScene(argv[2], argv[3]);
+    } catch (const std::runtime_error& e) {
+      std::print("Error converting scene: {}\n", e.what());
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
   show_tutorial_window = !std::filesystem::exists("tutorial.txt");
   core::Initialize(core::InitializeFlags::kOpengl, nullptr);
   auto* window = glfwCreateWindow(kDefaultWindowSize.x, kDefaultWindowSize.y,
@@ -227,252 +475,123 @@ int main(int /*argc*/, char* /*argv*/[]) {
   ImGui::GetStyle().FrameRounding = 6;
   ImGui::GetStyle().PopupRounding = 12;
   ImGui::StyleColorsDark();
-  // Font
-  io.Fonts->AddFontFromFileTTF("assets/poppins/Poppins-Regular.ttf", 16.0F);
-
-  glEnable(GL_DEPTH_TEST);
-  glDepthFunc(GL_LESS);
-  auto color_buffer = CreateFramebuffer(window, 0.1F);
-  auto normal_buffer = CreateFramebuffer(window, 0.1F);
-  auto deferred_buffer = CreateFramebuffer(window, 0.1F);
-  auto sprite_shader =
-      LoadShaderProgram({{GL_VERTEX_SHADER, "assets/sprite_vertex.glsl"},
-                         {GL_FRAGMENT_SHADER, "assets/sprite_fragment.glsl"}});
-  auto deferred_shader = LoadShaderProgram(
-      {{GL_VERTEX_SHADER, "assets/deferred_vertex.glsl"},
-       {GL_FRAGMENT_SHADER, "assets/deferred_fragment.glsl"}});
-
-  auto sprite_uniform_buffer_create_info =
-      BufferCreateInfo<float>{.type = GL_UNIFORM_BUFFER,
-                              .usage = GL_STATIC_DRAW,
-                              .size = 2 * sizeof(glm::mat4),
-                              .data = NULL};
-  auto sprite_uniform_buffer =
-      CreateBufferObject(sprite_uniform_buffer_create_info);
-  auto uniform_block_index = glGetUniformBlockIndex(sprite_shader, "Matrices");
-  glUniformBlockBinding(sprite_shader, uniform_block_index, 0);
-  glBindBufferRange(GL_UNIFORM_BUFFER, 0, sprite_uniform_buffer, 0,
-                    2 * sizeof(glm::mat4));
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-  auto sprite_vertices_create_info =
-      BufferCreateInfo<float>{.type = GL_ARRAY_BUFFER,
-                              .usage = GL_STATIC_DRAW,
-                              .size = kSpriteVertices.size() * sizeof(float),
-                              .data = kSpriteVertices.data()};
-  auto sprite_indices_create_info = BufferCreateInfo<unsigned int>{
-      .type = GL_ELEMENT_ARRAY_BUFFER,
-      .usage = GL_STATIC_DRAW,
-      .size = kSharedIndices.size() * sizeof(unsigned int),
-      .data = kSharedIndices.data()};
-  auto sprite_vertex_buffer = CreateBufferObject(sprite_vertices_create_info);
-  auto sprite_indices_buffer = CreateBufferObject(sprite_indices_create_info);
-  auto sprite_vertex_array_create_info = VertexArrayCreateInfo{
-      .attributes = {{
-        .index = 0,
-        .size = 3,
-        .type = GL_FLOAT,
-        .normalized = GL_FALSE,
-        .stride = 5 * sizeof(float),
-        .pointer = static_cast<void*>(nullptr)},
-                     {
-        .index = 1,
-        .size = 2,
-        .type = GL_FLOAT,
-        .normalized = GL_FALSE,
-        .stride = 5 * sizeof(float),
-        .pointer = (void*)(3 * sizeof(float))}},
-      .buffers = {
-          {GL_ARRAY_BUFFER, sprite_vertex_buffer},
-          {GL_ELEMENT_ARRAY_BUFFER, sprite_indices_buffer},
-      }};
-  auto sprite_vertex_array =
-      CreateVertexArrayObject(sprite_vertex_array_create_info);
-  glBindVertexArray(0);
-
-  auto deferred_vertices_create_info =
-      BufferCreateInfo<float>{.type = GL_ARRAY_BUFFER,
-                              .usage = GL_STATIC_DRAW,
-                              .size = kDeferredVertices.size() * sizeof(float),
-                              .data = kDeferredVertices.data()};
-  auto deferred_indices_create_info = BufferCreateInfo<unsigned int>{
-      .type = GL_ELEMENT_ARRAY_BUFFER,
-      .usage = GL_STATIC_DRAW,
-      .size = kSharedIndices.size() * sizeof(unsigned int),
-      .data = kSharedIndices.data()};
-  auto deferred_vertex_buffer =
-      CreateBufferObject(deferred_vertices_create_info);
-  auto deferred_indices_buffer =
-      CreateBufferObject(deferred_indices_create_info);
-  auto deferred_vertex_array_create_info = VertexArrayCreateInfo{
-      .attributes = {{0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
-                      (void*)nullptr},
-                     {1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
-                      (void*)(2 * sizeof(float))}},
-      .buffers = {{GL_ARRAY_BUFFER, deferred_vertex_buffer},
-                  {GL_ELEMENT_ARRAY_BUFFER, deferred_indices_buffer}}};
-  auto deferred_vertex_attrib =
-      CreateVertexArrayObject(deferred_vertex_array_create_info);
-  glBindVertexArray(0);
-
-  auto combine_shader =
-      LoadShaderProgram({{GL_VERTEX_SHADER, "assets/deferred_vertex.glsl"},
-                         {GL_FRAGMENT_SHADER, "assets/combine_fragment.glsl"}});
-
-  if (std::filesystem::exists("attributes.xml")) {
+  // Font, read by ImGui straight from the asset, which outlives the atlas
+  static auto font = FindAsset("assets/poppins/Poppins-Regular.ttf");
+  if (font) {
+    ImFontConfig font_config;
+    font_config.FontDataOwnedByAtlas = false;
+    io.Fonts->AddFontFromMemoryTTF(const_cast<std::byte*>(font->Data()),
+                                   static_cast<int>(font->Size()), 16.0F,
+                                   &font_config);
+  } else {
+    io.Fonts->AddFontDefault();
+  }
+
+  renderer = std::make_unique<Renderer>(window, kShadowRefreshesPerFrame);
+
+  if (AssetExists("attributes.xml")) {
     attribute_templates = attributes::LoadTemplates();
   }
 
+  simulation = std::make_unique<Simulation>(kSimulationTimestep);
+  auto last_autosave = std::chrono::steady_clock::now();
   while (!glfwWindowShouldClose(window)) {
     ClearAllInfo();
+    FlushLog();
+    if (std::chrono::steady_clock::now() - last_autosave >= kAutosaveInterval) {
+      Autosave();
+      last_autosave = std::chrono::steady_clock::now();
+      if (journal.Size() > kJournalCompactionSize && !scene_save &&
+          !held_reload && !scene_path.empty()) {
+        SaveSceneInBackground(scene_path);
+      }
+    }
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
-    auto model = glm::mat4(1.0F);
     auto view = glm::mat4(1.0F);
-    auto projection = glm::mat4(1.0F);
-    float ortho_scale = 10.0F;
     int window_width;
     int window_height;
     glfwGetFramebufferSize(window, &window_width, &window_height);
-    float aspect =
-        static_cast<float>(window_width) / static_cast<float>(window_height);
-    projection = glm::ortho(-ortho_scale * aspect, ortho_scale * aspect,
-                            -ortho_scale, ortho_scale, -1.0F, 1.0F);
-    glBindBuffer(GL_UNIFORM_BUFFER, sprite_uniform_buffer);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4),
-                    glm::value_ptr(projection));
-    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4),
-                    glm::value_ptr(view));
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, color_buffer->id);
-    glViewport(0, 0, color_buffer->size.x, color_buffer->size.y);
-    glClearColor(clear_color.r, clear_color.g, clear_color.b, 1.0F);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glUseProgram(sprite_shader);
-    glBindVertexArray(sprite_vertex_array);
-    for (auto& object : scene.objects) {
-      if (!object->HasTag("sprite")) continue;
-      glm::vec3 position;
-      glm::vec3 scale;
-      float rotation;
-      try {
-        position = std::get<glm::vec3>(object->GetAttribute("transform.position"));
-        scale = std::get<glm::vec3>(object->GetAttribute("transform.scale"));
-        rotation = std::get<float>(object->GetAttribute("transform.rotation"));
-      } catch (const std::runtime_error& e) {
-        output_log["Error retrieving transform attributes: " + std::string(e.what())] = LogLevel::kError;
-        continue;
-      }
-      Texture texture;
-      try {
-        texture = std::get<Texture>(object->GetAttribute("texture.color"));
-      } catch (const std::runtime_error& e) {
-        output_log["Error retrieving texture attribute: " + std::string(e.what())] = LogLevel::kError;
-        continue;
-      }
-      model = glm::translate(glm::mat4(1.0F), position);
-      model = glm::rotate(model, glm::radians(rotation),
-                          glm::vec3(0.0F, 0.0F, 1.0F));
-      model = glm::scale(model, scale);
-      glUniformMatrix4fv(glGetUniformLocation(sprite_shader, "model"), 1,
-                         GL_FALSE, glm::value_ptr(model));
-      glUniform1i(glGetUniformLocation(sprite_shader, "sprite"), 0);
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, texture.id);
-      glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
-    }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, normal_buffer->id);
-    glViewport(0, 0, normal_buffer->size.x, normal_buffer->size.y);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glUseProgram(sprite_shader);
-    glBindVertexArray(sprite_vertex_array);
-    for (auto& object : scene.objects) {
-      if (!object->HasTag("sprite")) continue;
-      glm::vec3 position;
-      glm::vec3 scale;
-      float rotation;
+    if (scene_stream) {
       try {
-        position = std::get<glm::vec3>(object->GetAttribute("transform.position"));
-        scale = std::get<glm::vec3>(object->GetAttribute("transform.scale"));
-        rotation = std::get<float>(object->GetAttribute("transform.rotation"));
-      } catch (const std::runtime_error& e) {
-        output_log["Error retrieving transform attributes: " + std::string(e.what())] = LogLevel::kError;
-        continue;
-      }
-      Texture texture;
-      try {
-        texture = std::get<Texture>(object->GetAttribute("texture.normal"));
+        auto prefab_count = scene.prefabs.size();
+        auto object_count = scene.objects.size();
+        scene_stream->Publish(scene, kSceneStreamBudget);
+        for (auto p = prefab_count; p < scene.prefabs.size(); p++) {
+          simulation->SetPrefab(scene, p);
+        }
+        simulation->InsertObjects(scene, object_count,
+                                  scene.objects.size() - object_count);
+        if (scene_stream->Done()) {
+          scene_path = scene_stream->Path();
+          // Back in file order, which is draw order
+          auto positions =
+              journal.EndStream(scene_path, scene_stream->FileOrder());
+          ReorderObjects(scene.objects, positions);
+          for (auto& selected : selected_objects) {
+            selected = positions[selected];
+          }
+          std::ranges::sort(selected_objects);
+          simulation->Reorder(std::move(positions));
+          object_filter.Invalidate();
+          scene_stream.reset();
+          if (std::filesystem::exists(LightmapPath(scene_path))) {
+            try {
+              renderer->LoadLightmap(LightmapPath(scene_path));
+            } catch (const std::runtime_error& e) {
+              // Baked again instead
+              output_log["Error loading lightmap: " + std::string(e.what())] =
+                  LogLevel::kWarning;
+            }
+          }
+        }
       } catch (const std::runtime_error& e) {
-        output_log["Error retrieving normal texture attribute: " + std::string(e.what())] = LogLevel::kError;
-        continue;
+        std::print("Error loading scene: {}\n", e.what());
+        scene_stream.reset();
+        journal = Journal();
+        // Keeps what was published before the error
+        simulation->Reset(scene);
       }
-      model = glm::translate(glm::mat4(1.0F), position);
-      model = glm::rotate(model, glm::radians(rotation),
-                          glm::vec3(0.0F, 0.0F, 1.0F));
-      model = glm::scale(model, scale);
-      glUniformMatrix4fv(glGetUniformLocation(sprite_shader, "model"), 1,
-                         GL_FALSE, glm::value_ptr(model));
-      glUniform1i(glGetUniformLocation(sprite_shader, "sprite"), 0);
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, texture.id);
-      glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
     }
+    PollSceneWatcher();
+    ReloadPopup();
 
-    glBindFramebuffer(GL_FRAMEBUFFER, deferred_buffer->id);
-    glViewport(0, 0, deferred_buffer->size.x, deferred_buffer->size.y);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glUseProgram(deferred_shader);
-    SetLightUniforms(scene.objects, deferred_shader);
-    glUniform1i(glGetUniformLocation(deferred_shader, "color_buffer"), 0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, color_buffer->colorbuffer);
-    glUniform1i(glGetUniformLocation(deferred_shader, "normal_buffer"), 1);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, normal_buffer->colorbuffer);
-    glBindVertexArray(deferred_vertex_attrib);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, window_width, window_height);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glUseProgram(combine_shader);
-    glUniform1i(glGetUniformLocation(combine_shader, "deferred_buffer"), 0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, deferred_buffer->colorbuffer);
-    glBindVertexArray(deferred_vertex_attrib);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+    const auto& render_state = simulation->Acquire();
+    renderer->Advance(ImGui::GetIO().DeltaTime);
+    renderer->Draw(render_state.sprites, render_state.lights,
+                   render_state.occluders, render_state.emitters, view,
+                   {window_width, window_height}, clear_color);
 
     ImGui::BeginMainMenuBar();
     if (ImGui::BeginMenu("File")) {
       // Due for implementation
       if (ImGui::MenuItem("New")) {
-        scene.objects.clear();
+        scene_stream.reset();
+        scene = Scene();
+        journal = Journal();
+        scene_path.clear();
+        selected_objects.clear();
+        object_filter.Invalidate();
+        simulation->Reset(scene);
       }
       if (ImGui::MenuItem("Open")) {
-        const char* filters[] = {"*.xml"};
-        auto* path = tinyfd_openFileDialog("Select Scene", "", 1, filters,
+        const char* filters[] = {"*.xml", "*.vbscene"};
+        auto* path = tinyfd_openFileDialog("Select Scene", "", 2, filters,
                                            "Scene Files", 0);
         if (path) {
-          try {
-            scene = LoadScene(path);
-          } catch (const std::runtime_error& e) {
-            std::print("Error loading scene: {}\n", e.what());
-          }
+          OpenScene(path, glm::vec2(-view[3].x, -view[3].y));
         }
       }
-      if (ImGui::MenuItem("Save")) {
-        const char* filters[] = {"*.xml"};
-        auto* path = tinyfd_saveFileDialog("Save Scene", "scene.xml", 1, filters,
+      // Not a scene that is still streaming in
+      if (ImGui::MenuItem("Save", nullptr, false,
+                          !scene_save && !scene_stream)) {
+        const char* filters[] = {"*.xml", "*.vbscene"};
+        auto* path = tinyfd_saveFileDialog("Save Scene", "scene.xml", 2, filters,
                                            "Scene Files");
         if (path) {
-          try {
-            SaveScene(scene, path);
-          } catch (const std::runtime_error& e) {
-            std::print("Error saving scene: {}\n", e.what());
-          }
+          SaveSceneInBackground(path);
         }
       }
       ImGui::EndMenu();
@@ -480,7 +599,10 @@ int main(int /*argc*/, char* /*argv*/[]) {
     if (ImGui::BeginMenu("View")) {
       ImGui::MenuItem("Edit Window", nullptr, &show_edit_window);
       ImGui::MenuItem("Attribute Templates", nullptr, &show_template_window);
+      ImGui::MenuItem("Prefabs", nullptr, &show_prefab_window);
       ImGui::MenuItem("Output Log", nullptr, &show_output_window);
+      ImGui::MenuItem("Memory", nullptr, &show_memory_window);
+      ImGui::MenuItem("Lighting", nullptr, &show_lighting_window);
 #ifndef NDEBUG
       ImGui::MenuItem("ImGui Demo Window", nullptr, &show_demo_window);
 #endif
@@ -491,13 +613,24 @@ int main(int /*argc*/, char* /*argv*/[]) {
       ImGui::MenuItem("Documentation", nullptr, &show_documentation_window);
       ImGui::EndMenu();
     }
+    if (scene_stream) {
+      ImGui::ProgressBar(scene_stream->Progress(), ImVec2(200.0F, 0.0F),
+                         "Loading scene...");
+    }
+    PollSceneSave();
+    if (scene_save) {
+      ImGui::ProgressBar(scene_save->Progress(), ImVec2(200.0F, 0.0F),
+                         "Saving scene...");
+    }
     ImGui::EndMainMenuBar();
 
     if (show_demo_window) {
       ImGui::ShowDemoWindow(&show_demo_window);
     }
 
-    TutorialWindow(show_tutorial_window, scene);
+    TutorialWindow(show_tutorial_window, [&](std::string_view path) {
+      OpenScene(path, glm::vec2(-view[3].x, -view[3].y));
+    });
 
     if (show_documentation_window) {
       DocumentationWindow();
@@ -512,37 +645,157 @@ int main(int /*argc*/, char* /*argv*/[]) {
         object->SetAttribute("transform.scale", glm::vec3(1.0F, 1.0F, 1.0F));
         object->SetAttribute("transform.rotation", 0.0F);
         scene.objects.push_back(object);
+        journal.AddObject(scene.objects.size() - 1, *object);
+        simulation->InsertObjects(scene, scene.objects.size() - 1, 1);
+        selected_objects = {scene.objects.size() - 1};
+      }
+      if (ImGui::InputTextWithHint("##filter", "Filter by name or tag",
+                                   &object_filter_query)) {
+        object_filter.SetQuery(object_filter_query);
       }
-      for (auto& object : scene.objects) {
-        ImGui::PushID(object.get());
+      const auto& matches = object_filter.Matches(scene);
+      ImGui::SameLine();
+      ImGui::Text("%zu of %zu", matches.size(), scene.objects.size());
+      // Only the visible rows are submitted, however large the scene
+      ImGui::BeginChild("Objects",
+                        ImVec2(0.0F, ImGui::GetTextLineHeightWithSpacing() * 10),
+                        true);
+      ImGuiListClipper clipper;
+      clipper.Begin(static_cast<int>(matches.size()));
+      while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+          auto index = matches[row];
+          auto selected = std::ranges::lower_bound(selected_objects, index);
+          bool is_selected =
+              selected != selected_objects.end() && *selected == index;
+          // Names may be empty or shared, so rows are told apart by index
+          const auto& name = scene.objects[index]->name;
+          auto label =
+              std::format("{}##{}", name.empty() ? "(unnamed)" : name, index);
+          if (ImGui::Selectable(label.c_str(), is_selected)) {
+            if (!ImGui::GetIO().KeyCtrl) {
+              selected_objects = {index};
+            } else if (is_selected) {
+              selected_objects.erase(selected);
+            } else {
+              selected_objects.insert(selected, index);
+            }
+          }
+        }
+      }
+      ImGui::EndChild();
+      for (auto index : selected_objects) {
+        auto& object = scene.objects[index];
+        // By index, which stays put while the object is edited, unlike the
+        // object's address
+        ImGui::PushID(static_cast<int>(index));
         if (ImGui::CollapsingHeader(std::format("Object {}", object->name).c_str(),
                                     ImGuiTreeNodeFlags_DefaultOpen)) {
-        if (ImGui::Button("Delete")) {
-          objects_to_erase.push_back(object);
+        // Widgets below edit a copy, which replaces the object only once one
+        // of them changes it: detaching an object shared with a snapshot
+        // (a save, or the scene watcher's) clones it
+        Object draft = *object;
+        bool changed = false;
+        ImGui::BeginGroup();
+        bool erase = ImGui::Button("Delete");
+        changed |= ImGui::InputText("Name", &draft.name);
+        if (ImGui::IsItemDeactivatedAfterEdit()) {
+          journal.SetName(index, draft.name);
+          object_filter.Invalidate();
+        }
+        if (draft.prefab) {
+          ImGui::Text("Prefab: %s", draft.prefab->name.c_str());
+          ImGui::SameLine();
+          if (ImGui::Button("Unlink")) {
+            // Keeps the inherited values as the object's own
+            for (const auto& [attr_name, attr_data] :
+                 draft.prefab->attributes) {
+              if (attributes::Find(draft.attributes, attr_name) == nullptr) {
+                journal.SetAttribute(index,
+                                     draft.SetAttribute(attr_name, attr_data),
+                                     attr_name, attr_data);
+              }
+            }
+            draft.prefab = nullptr;
+            journal.SetPrefab(index, std::nullopt);
+            changed = true;
+          }
         }
-        ImGui::InputText("Name", &object->name);
         ImGui::SeparatorText("Tags");
-        for (auto& tag : object->tags) {
-          ImGui::PushID(&tag);
-          ImGui::InputText("", &tag);
+        std::optional<std::size_t> tag_to_remove;
+        for (std::size_t t = 0; t < draft.tags.size(); t++) {
+          auto& tag = draft.tags[t];
+          ImGui::PushID(static_cast<int>(t));
+          changed |= ImGui::InputText("", &tag);
+          if (ImGui::IsItemDeactivatedAfterEdit()) {
+            journal.SetTag(index, t, tag);
+            object_filter.Invalidate();
+          }
           ImGui::SameLine();
           if (ImGui::Button("Remove")) {
-            objects_to_erase.push_back(object);
+            tag_to_remove = t;
           }
           ImGui::PopID();
         }
+        if (tag_to_remove) {
+          draft.tags.erase(draft.tags.begin() + *tag_to_remove);
+          journal.RemoveTag(index, *tag_to_remove);
+          object_filter.Invalidate();
+          changed = true;
+        }
         if (ImGui::Button("Add Tag")) {
-          object->tags.emplace_back("guten tag");
+          draft.tags.emplace_back("guten tag");
+          journal.SetTag(index, draft.tags.size() - 1, draft.tags.back());
+          object_filter.Invalidate();
+          changed = true;
         }
         ImGui::SeparatorText("Attributes");
-        for (auto& attr : object->attributes) {
-          ImGui::PushID(&attr);
+        std::optional<std::size_t> attribute_to_revert;
+        for (std::size_t a = 0; a < draft.attributes.size(); a++) {
+          auto& attr = draft.attributes[a];
+          ImGui::PushID(static_cast<int>(a));
           ImGui::PushItemWidth(ImGui::GetWindowWidth() / 2.5F);
-          ImGui::InputText("##name", &attr.first);
-          GetInspector(attr.second, kDescriptionMap.contains(attr.first) ? kDescriptionMap.at(attr.first) : "");
+          changed |= ImGui::InputText("##name", &attr.first);
+          bool edited = ImGui::IsItemDeactivatedAfterEdit();
+          edited |= GetInspector(attr.second, kDescriptionMap.contains(attr.first) ? kDescriptionMap.at(attr.first) : "", &changed);
+          if (edited) {
+            journal.SetAttribute(index, a, attr.first, attr.second);
+          }
+          if (draft.prefab &&
+              attributes::Find(draft.prefab->attributes, attr.first)) {
+            ImGui::SameLine();
+            if (ImGui::Button("Revert")) {
+              attribute_to_revert = a;
+            }
+          }
           ImGui::PopItemWidth();
           ImGui::PopID();
         }
+        if (attribute_to_revert) {
+          draft.attributes.erase(draft.attributes.begin() +
+                                 *attribute_to_revert);
+          journal.RemoveAttribute(index, *attribute_to_revert);
+          changed = true;
+        }
+        if (draft.prefab) {
+          // Inherited values are edited in the Prefabs window, or overridden
+          for (const auto& [attr_name, attr_data] :
+               draft.prefab->attributes) {
+            if (attributes::Find(draft.attributes, attr_name) != nullptr) {
+              continue;
+            }
+            ImGui::PushID(attr_name.c_str());
+            ImGui::TextDisabled("%s (prefab)", attr_name.c_str());
+            ImGui::SameLine();
+            if (ImGui::Button("Override")) {
+              journal.SetAttribute(index,
+                                   draft.SetAttribute(attr_name, attr_data),
+                                   attr_name, attr_data);
+              changed = true;
+            }
+            ImGui::PopID();
+          }
+        }
         if (ImGui::Button("Add Attribute")) {
           ImGui::OpenPopup("Select Attribute Type");
         }
@@ -550,40 +803,11 @@ int main(int /*argc*/, char* /*argv*/[]) {
         if (ImGui::Button("Use Template")) {
           ImGui::OpenPopup("Select Template");
         }
-        if (ImGui::BeginPopupModal("Select Attribute Type")) {
-          static int attr_type = 0;
-          ImGui::RadioButton("int", &attr_type, 0);
-          ImGui::RadioButton("float", &attr_type, 1);
-          ImGui::RadioButton("vec2", &attr_type, 2);
-          ImGui::RadioButton("vec3", &attr_type, 3);
-          ImGui::RadioButton("texture", &attr_type, 4);
-          if (ImGui::Button("Add")) {
-            switch (attr_type) {
-              case 0:
-                object->SetAttribute("new attribute", 0);
-                break;
-              case 1:
-                object->SetAttribute("new attribute", 0.0F);
-                break;
-              case 2:
-                object->SetAttribute("new attribute", glm::vec2(0.0F));
-                break;
-              case 3:
-                object->SetAttribute("new attribute", glm::vec3(0.0F));
-                break;
-              case 4:
-                object->SetAttribute("new attribute", Texture{.id=0U, .path=""});
-                break;
-              default:
-                break;
-            }
-            ImGui::CloseCurrentPopup();
-          }
-          ImGui::SameLine();
-          if (ImGui::Button("Cancel")) {
-            ImGui::CloseCurrentPopup();
-          }
-          ImGui::EndPopup();
+        if (auto value = AttributeTypePopup()) {
+          journal.SetAttribute(index,
+                               draft.SetAttribute("new attribute", *value),
+                               "new attribute", *value);
+          changed = true;
         }
         if (ImGui::BeginPopupModal("Select Template")) {
           static int selected_template = 0;
@@ -595,11 +819,13 @@ int main(int /*argc*/, char* /*argv*/[]) {
           if (attribute_templates.empty()) {
             ImGui::Text("No templates available");
           }
-          if (ImGui::Button("Apply")) {
-            auto it = attribute_templates.begin();
-            std::advance(it, selected_template);
-            for (const auto& [attr_name, attr_data] : it->attributes)
-              object->SetAttribute(attr_name, attr_data);
+          if (ImGui::Button("Apply") && !attribute_templates.empty()) {
+            // Shared rather than copied; the object keeps its own values as
+            // overrides.
+            auto prefab = UsePrefab(attribute_templates.at(selected_template));
+            draft.prefab = scene.prefabs[prefab];
+            journal.SetPrefab(index, prefab);
+            changed = true;
             ImGui::CloseCurrentPopup();
           }
           ImGui::SameLine();
@@ -608,13 +834,29 @@ int main(int /*argc*/, char* /*argv*/[]) {
           }
           ImGui::EndPopup();
         }
+        ImGui::EndGroup();
+        if (changed) {
+          Detach(object) = std::move(draft);
+          simulation->SetObject(scene, index);
+        }
+        if (erase) {
+          objects_to_erase.push_back(object);
+        }
       }
         ImGui::PopID();
       }
       for (const auto& object : objects_to_erase) {
         for (auto it = scene.objects.begin(); it != scene.objects.end(); it++) {
           if (*it == object) {
+            auto removed = static_cast<std::size_t>(it - scene.objects.begin());
+            journal.RemoveObject(removed);
+            simulation->EraseObject(removed);
             scene.objects.erase(it);
+            std::erase(selected_objects, removed);
+            for (auto& selected : selected_objects) {
+              selected -= selected > removed ? 1 : 0;
+            }
+            object_filter.Invalidate();
             break;
           }
         }
@@ -622,6 +864,92 @@ int main(int /*argc*/, char* /*argv*/[]) {
       ImGui::End();
     }
 
+    if (show_memory_window) {
+      ImGui::Begin("Memory");
+      auto now = std::chrono::steady_clock::now();
+      if (now - memory_report_time >= kMemoryReportInterval) {
+        memory_report = MeasureMemory(scene);
+        memory_report.simulation = simulation->MemoryBytes();
+        memory_report_time = now;
+      }
+      if (ImGui::BeginTable("Memory", 2)) {
+        auto row = [](const char* label, std::size_t bytes) {
+          ImGui::TableNextRow();
+          ImGui::TableNextColumn();
+          ImGui::TextUnformatted(label);
+          ImGui::TableNextColumn();
+          ImGui::TextUnformatted(FormatBytes(bytes).c_str());
+        };
+        row("CPU", memory_report.Cpu());
+        row("  Objects", memory_report.objects);
+        row("  Attributes", memory_report.attributes);
+        row("  Strings", memory_report.strings);
+        row("  Logs", memory_report.logs);
+        row("  Simulation", memory_report.simulation);
+        row("GPU", memory_report.Gpu());
+        row("  Textures", memory_report.textures);
+        row("  Buffers", memory_report.buffers);
+        row("  Framebuffers", memory_report.framebuffers);
+        ImGui::EndTable();
+      }
+      ImGui::TextDisabled("Headless: vibrant --memory-report <scene> [out.json]");
+      ImGui::End();
+    }
+
+    if (show_lighting_window) {
+      ImGui::Begin("Lighting");
+      auto options = renderer->Lod().Options();
+      int budget = static_cast<int>(options.budget);
+      bool changed = ImGui::SliderFloat("Error Bound", &options.error_bound,
+                                        0.0F, 2.0F);
+      Hover("How far a light may move when merged, relative to its distance "
+            "from the view");
+      changed |= ImGui::SliderInt("Light Budget", &budget, 1,
+                                  static_cast<int>(ShadowMaps::kMaxLights));
+      Hover("Most lights shaded per frame; more are merged until they fit");
+      if (changed) {
+        options.budget = static_cast<std::size_t>(budget);
+        renderer->Lod().SetOptions(options);
+      }
+      const auto& stats = renderer->Lod().Stats();
+      ImGui::Text("Lights: %zu", stats.lights);
+      ImGui::Text("Shaded: %zu", stats.shaded);
+      ImGui::Text("Merged: %zu into %zu", stats.merged, stats.aggregates);
+      ImGui::Text("Error used: %.2f", stats.error);
+      ImGui::SeparatorText("Sprites");
+      auto debug_options = renderer->DebugOptions();
+      bool debug_changed =
+          ImGui::Checkbox("Depth Sort", &debug_options.depth_sort);
+      Hover("Draw sprites by layer (position z) with the depth test; off, in "
+            "list order");
+      debug_changed |= ImGui::Checkbox("Show Overdraw", &debug_options.overdraw);
+      Hover("How often each pixel is shaded, an eighth of white per sprite");
+      debug_changed |=
+          ImGui::Checkbox("Static Batching", &debug_options.static_batching);
+      Hover("Draw opaque static sprites from per-chunk vertex buffers; needs "
+            "Depth Sort");
+      debug_changed |=
+          ImGui::Checkbox("Texture Atlas", &debug_options.texture_atlas);
+      Hover("Draw sprites from textures packed into shared pages instead of "
+            "binding their own");
+      if (debug_changed) {
+        renderer->SetDebugOptions(debug_options);
+      }
+      ImGui::Text("Overdraw: %.2f fragments per pixel", renderer->Overdraw());
+      const auto& batches = renderer->BatchStats();
+      ImGui::Text("Batched: %zu sprites in %zu chunks", batches.sprites,
+                  batches.chunks);
+      ImGui::Text("Chunks drawn: %zu in %zu calls, %zu rebuilt", batches.drawn,
+                  batches.draw_calls, batches.rebuilt);
+      ImGui::Text("Atlas: %zu texture pairs on %d pages",
+                  renderer->Atlas().Packed(), renderer->Atlas().Pages());
+      const auto& graph = renderer->GraphStats();
+      ImGui::Text("Render passes: %zu of %zu, %zu framebuffers",
+                  graph.passes - graph.culled, graph.passes,
+                  graph.framebuffers);
+      ImGui::End();
+    }
+
     if (show_output_window) {
       ImGui::Begin("Output Log");
       for (const auto& [message, level] : output_log) {
@@ -652,6 +980,73 @@ int main(int /*argc*/, char* /*argv*/[]) {
       ImGui::End();
     }
 
+    if (show_prefab_window) {
+      ImGui::Begin("Prefabs");
+      if (scene.prefabs.empty()) {
+        ImGui::Text("Use a template on an object to make a prefab");
+      }
+      for (std::size_t p = 0; p < scene.prefabs.size(); p++) {
+        // By index: an edit replaces the prefab
+        ImGui::PushID(static_cast<int>(p));
+        if (ImGui::CollapsingHeader(scene.prefabs[p]->name.c_str(),
+                                    ImGuiTreeNodeFlags_DefaultOpen)) {
+          // Edited as a copy, as the simulation and a running save share the
+          // prefab; it is only replaced (see DetachPrefab) if this changes
+          auto draft = *scene.prefabs[p];
+          bool changed = false;
+          ImGui::BeginGroup();
+          std::optional<std::size_t> attribute_to_remove;
+          for (std::size_t a = 0; a < draft.attributes.size(); a++) {
+            auto& attr = draft.attributes[a];
+            ImGui::PushID(static_cast<int>(a));
+            ImGui::PushItemWidth(ImGui::GetWindowWidth() / 2.5F);
+            changed |= ImGui::InputText("##name", &attr.first);
+            bool edited = ImGui::IsItemDeactivatedAfterEdit();
+            edited |= GetInspector(attr.second, kDescriptionMap.contains(attr.first) ? kDescriptionMap.at(attr.first) : "", &changed);
+            if (edited) {
+              journal.SetPrefabAttribute(p, a, attr.first, attr.second);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Remove")) {
+              attribute_to_remove = a;
+            }
+            ImGui::PopItemWidth();
+            ImGui::PopID();
+          }
+          if (attribute_to_remove) {
+            draft.attributes.erase(draft.attributes.begin() +
+                                   *attribute_to_remove);
+            journal.RemovePrefabAttribute(p, *attribute_to_remove);
+            changed = true;
+          }
+          if (ImGui::Button("Add Attribute")) {
+            ImGui::OpenPopup("Select Attribute Type");
+          }
+          if (auto value = AttributeTypePopup()) {
+            std::size_t a = 0;
+            while (a < draft.attributes.size() &&
+                   draft.attributes[a].first != "new attribute") {
+              a++;
+            }
+            if (a == draft.attributes.size()) {
+              draft.attributes.emplace_back("new attribute", *value);
+            } else {
+              draft.attributes[a].second = *value;
+            }
+            journal.SetPrefabAttribute(p, a, "new attribute", *value);
+            changed = true;
+          }
+          ImGui::EndGroup();
+          if (changed) {
+            DetachPrefab(scene, p) = std::move(draft);
+            simulation->SetPrefab(scene, p);
+          }
+        }
+        ImGui::PopID();
+      }
+      ImGui::End();
+    }
+
     if (show_template_window) {
       std::vector<AttributeTemplate> templates_to_erase;
       ImGui::Begin("Attribute Templates");
@@ -693,7 +1088,7 @@ int main(int /*argc*/, char* /*argv*/[]) {
                                                         glm::vec4(0.0F));
                   break;
                 case 5:
-                  attr_template.attributes.emplace_back("new attribute", Texture{.id=0U, .path=""});
+                  attr_template.attributes.emplace_back("new attribute", Texture{.id = 0U, .path = 0U});
                   break;
                 default:
                   break;
@@ -736,7 +1131,7 @@ int main(int /*argc*/, char* /*argv*/[]) {
       }
       ImGui::SameLine();
       if (ImGui::Button("Load Templates")) {
-        if (std::filesystem::exists("attributes.xml"))
+        if (AssetExists("attributes.xml"))
           attribute_templates = attributes::LoadTemplates();
         else {
           ImGui::OpenPopup("Load Failed");
@@ -772,12 +1167,19 @@ int main(int /*argc*/, char* /*argv*/[]) {
     glfwPollEvents();
   }
 
+  // Let a running save finish so its compaction completes, then write out
+  // whatever is left in the journal.
+  while (scene_save) {
+    PollSceneSave();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  Autosave();
+  simulation.reset();
+  renderer.reset();
+
   glDeleteVertexArrays(loaded_vertex_arrays.size(),
                        loaded_vertex_arrays.data());
   glDeleteBuffers(loaded_buffers.size(), loaded_buffers.data());
-  glDeleteProgram(sprite_shader);
-  glDeleteProgram(deferred_shader);
-  glDeleteProgram(combine_shader);
   glDeleteTextures(loaded_textures.size(), loaded_textures.data());
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
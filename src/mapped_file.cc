@@ -0,0 +1,88 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(std::string_view path, bool writable) {
+  file_ = CreateFileA(std::string(path).c_str(), GENERIC_READ, FILE_SHARE_READ,
+                      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE) {
+    file_ = nullptr;
+    throw std::runtime_error("Failed to open file: " + std::string(path));
+  }
+  LARGE_INTEGER size;
+  GetFileSizeEx(file_, &size);
+  size_ = static_cast<std::size_t>(size.QuadPart);
+  if (size_ == 0) {
+    return;
+  }
+  mapping_ = CreateFileMappingA(file_, nullptr,
+                                writable ? PAGE_WRITECOPY : PAGE_READONLY, 0,
+                                0, nullptr);
+  if (mapping_ == nullptr) {
+    CloseHandle(file_);
+    throw std::runtime_error("Failed to map file: " + std::string(path));
+  }
+  data_ = static_cast<std::byte*>(MapViewOfFile(
+      mapping_, writable ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+  if (data_ == nullptr) {
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+    throw std::runtime_error("Failed to map file: " + std::string(path));
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_ != nullptr) {
+    CloseHandle(mapping_);
+  }
+  if (file_ != nullptr) {
+    CloseHandle(file_);
+  }
+}
+#else
+MappedFile::MappedFile(std::string_view path, bool writable) {
+  int fd = open(std::string(path).c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open file: " + std::string(path));
+  }
+  struct stat info{};
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    throw std::runtime_error("Failed to stat file: " + std::string(path));
+  }
+  size_ = static_cast<std::size_t>(info.st_size);
+  if (size_ != 0) {
+    void* data = mmap(nullptr, size_, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                      MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("Failed to map file: " + std::string(path));
+    }
+    data_ = static_cast<std::byte*>(data);
+  }
+  // The mapping keeps its own reference to the file.
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+}
+#endif
@@ -0,0 +1,127 @@
+#include "memory_report.h"
+
+#include <array>
+#include <format>
+#include <unordered_set>
+
+#include "helpers.h"
+#include "log.h"
+
+namespace {
+// make_shared keeps the reference counts in the same allocation
+constexpr std::size_t kSharedOverhead = 2 * sizeof(void*);
+// Colour, parent and two children per std::map node
+constexpr std::size_t kMapNodeOverhead = 4 * sizeof(void*);
+
+std::size_t HeapBytes(const std::string& s) {
+  // Short strings are stored inside the std::string itself
+  static const std::size_t kInline = std::string().capacity();
+  return s.capacity() > kInline ? s.capacity() + 1 : 0;
+}
+
+void MeasureAttributes(
+    const std::vector<std::pair<std::string, AttributeData>>& list,
+    MemoryReport& report) {
+  report.attributes += list.capacity() * sizeof(list.front());
+  for (const auto& [name, value] : list) {
+    report.strings += HeapBytes(name);
+  }
+}
+
+void MeasureObject(const Object& object, MemoryReport& report) {
+  report.objects += sizeof(Object) + kSharedOverhead +
+                    object.tags.capacity() * sizeof(std::string);
+  report.strings += HeapBytes(object.name);
+  for (const auto& tag : object.tags) {
+    report.strings += HeapBytes(tag);
+  }
+  MeasureAttributes(object.attributes, report);
+}
+}  // namespace
+
+std::string MemoryReport::ToJson() const {
+  return std::format(
+      "{{\n"
+      "  \"cpu\": {{\"objects\": {}, \"attributes\": {}, \"strings\": {}, "
+      "\"logs\": {}, \"simulation\": {}, \"total\": {}}},\n"
+      "  \"gpu\": {{\"textures\": {}, \"buffers\": {}, \"framebuffers\": {}, "
+      "\"total\": {}}}\n"
+      "}}\n",
+      objects, attributes, strings, logs, simulation, Cpu(), textures, buffers,
+      framebuffers, Gpu());
+}
+
+MemoryReport MeasureMemory(const Scene& scene) {
+  MemoryReport report;
+  report.objects += scene.objects.capacity() * sizeof(scene.objects.front());
+  for (const auto& object : scene.objects) {
+    MeasureObject(*object, report);
+  }
+  for (const auto& prefab : scene.prefabs) {
+    report.attributes += sizeof(AttributeTemplate) + kSharedOverhead;
+    report.strings += HeapBytes(prefab->name);
+    MeasureAttributes(prefab->attributes, report);
+  }
+  // Shared by every texture attribute using them
+  report.strings += TexturePathBytes();
+  for (const auto& [message, level] : output_log) {
+    report.logs += kMapNodeOverhead + sizeof(std::pair<const std::string, LogLevel>) +
+                   HeapBytes(message);
+  }
+
+  std::unordered_set<unsigned int> attachments;
+  for (const auto& framebuffer : all_framebuffers) {
+    attachments.insert(framebuffer->colorbuffer);
+    if (framebuffer->depthbuffer != 0) {
+      attachments.insert(framebuffer->depthbuffer);
+    }
+  }
+  for (const auto& [texture, bytes] : texture_bytes) {
+    (attachments.contains(texture) ? report.framebuffers : report.textures) +=
+        bytes;
+  }
+  for (const auto& [buffer, bytes] : buffer_bytes) {
+    report.buffers += bytes;
+  }
+  return report;
+}
+
+std::size_t ObjectBytes(const Object& object) {
+  MemoryReport report;
+  MeasureObject(object, report);
+  return report.Cpu();
+}
+
+std::size_t EstimateTextureBytes(const Scene& scene) {
+  std::unordered_set<std::uint32_t> paths;
+  auto collect = [&](const auto& list) {
+    for (const auto& [name, value] : list) {
+      if (const auto* texture = std::get_if<Texture>(&value)) {
+        paths.insert(texture->path);
+      }
+    }
+  };
+  for (const auto& prefab : scene.prefabs) {
+    collect(prefab->attributes);
+  }
+  for (const auto& object : scene.objects) {
+    collect(object->attributes);
+  }
+  std::size_t bytes = 0;
+  for (auto path : paths) {
+    bytes += TextureFileBytes(TexturePath(path));
+  }
+  return bytes;
+}
+
+std::string FormatBytes(std::size_t bytes) {
+  constexpr std::array<const char*, 4> kUnits = {"B", "KB", "MB", "GB"};
+  auto value = static_cast<double>(bytes);
+  std::size_t unit = 0;
+  while (value >= 1024.0 && unit + 1 < kUnits.size()) {
+    value /= 1024.0;
+    unit++;
+  }
+  return unit == 0 ? std::format("{} B", bytes)
+                   : std::format("{:.1f} {}", value, kUnits[unit]);
+}
@@ -1,82 +1,160 @@
 #include "object.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <filesystem>
 #include <pugixml.hpp>
-#include <sstream>
 #include <iostream>
+#include "asset_pack.h"
+#include "mapped_file.h"
 
 namespace {
-std::vector<std::string> Split(std::string_view s, char delimiter) {
-  std::vector<std::string> tokens;
-  std::string token;
-  std::istringstream token_stream(s.data());
-  while (std::getline(token_stream, token, delimiter)) {
-    tokens.push_back(token);
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Reads one number from the front of [first, last), skipping leading
+// whitespace and a '+' as stoi and stof did. Returns the end of the number, or
+// nullptr if there is none.
+template <typename T>
+const char* ParseNumber(const char* first, const char* last, T& value) {
+  while (first != last && IsSpace(*first)) {
+    first++;
+  }
+  if (first != last && *first == '+' &&
+      (first + 1 == last || first[1] != '-')) {
+    first++;
+  }
+  auto [ptr, error] = std::from_chars(first, last, value);
+  return error == std::errc() ? ptr : nullptr;
+}
+
+// True if nothing but whitespace follows the value
+bool OnlySpaceLeft(const char* first, const char* last) {
+  return std::all_of(first, last, IsSpace);
+}
+
+// Reads exactly `N` comma or space separated floats without copying the text.
+template <std::size_t N>
+std::optional<std::array<float, N>> ParseFloats(std::string_view text) {
+  std::array<float, N> values{};
+  const char* first = text.data();
+  const char* last = first + text.size();
+  for (auto& value : values) {
+    while (first != last && (*first == ',' || IsSpace(*first))) {
+      first++;
+    }
+    first = ParseNumber(first, last, value);
+    if (first == nullptr) {
+      return std::nullopt;
+    }
+  }
+  if (!OnlySpaceLeft(first, last)) {
+    return std::nullopt;
   }
-  return tokens;
+  return values;
 }
 }
 
-std::vector<AttributeTemplate> attributes::LoadTemplates() {
+std::optional<AttributeData> attributes::ParseValue(std::string_view type,
+                                                    std::string_view value) {
+  if (type == "int") {
+    int v;
+    const char* last = value.data() + value.size();
+    const char* end = ParseNumber(value.data(), last, v);
+    if (end == nullptr || !OnlySpaceLeft(end, last)) {
+      return std::nullopt;
+    }
+    return v;
+  }
+  if (type == "float") {
+    if (auto v = ParseFloats<1>(value)) {
+      return (*v)[0];
+    }
+  } else if (type == "vec2") {
+    if (auto v = ParseFloats<2>(value)) {
+      return glm::vec2((*v)[0], (*v)[1]);
+    }
+  } else if (type == "vec3") {
+    if (auto v = ParseFloats<3>(value)) {
+      return glm::vec3((*v)[0], (*v)[1], (*v)[2]);
+    }
+  } else if (type == "vec4") {
+    if (auto v = ParseFloats<4>(value)) {
+      return glm::vec4((*v)[0], (*v)[1], (*v)[2], (*v)[3]);
+    }
+  } else if (type == "texture") {
+    return Texture{.id = 0U, .path = InternTexturePath(value)};
+  }
+  return std::nullopt;
+}
+
+std::vector<AttributeTemplate> attributes::LoadTemplates(
+    std::string_view path) {
   std::vector<AttributeTemplate> templates;
   pugi::xml_document doc;
-  pugi::xml_parse_result result = doc.load_file("attributes.xml");
+  pugi::xml_parse_result result;
+  // A loose file, which the editor saves over, is parsed in place from a
+  // private mapping; the document must not outlive it. Otherwise the packed
+  // copy, which is read-only, is parsed from a copy.
+  std::optional<MappedFile> file;
+  try {
+    if (std::filesystem::is_regular_file(path)) {
+      file.emplace(path, true);
+      result = doc.load_buffer_inplace(file->MutableData(), file->Size());
+    } else if (auto packed = FindAsset(path)) {
+      result = doc.load_buffer(packed->Data(), packed->Size());
+    } else {
+      throw std::runtime_error("Failed to open file: " + std::string(path));
+    }
+  } catch (const std::runtime_error& e) {
+    std::cerr << "Failed to load " << path << ": " << e.what() << std::endl;
+    return templates;
+  }
   if (!result) {
-    std::cerr << "Failed to load attributes.xml: " << result.description()
+    std::cerr << "Failed to load " << path << ": " << result.description()
               << std::endl;
     return templates;
   }
 
   for (pugi::xml_node template_node : doc.child("Attributes").children("Template")) {
-    std::string template_name = template_node.attribute("name").as_string();
     AttributeTemplate attr_template;
-    attr_template.name = template_name;
+    attr_template.name = template_node.attribute("name").as_string();
 
     for (pugi::xml_node attr_node : template_node.children("Attribute")) {
-      std::string attr_name = attr_node.attribute("name").as_string();
-      std::string type = attr_node.attribute("type").as_string();
-      std::string value_str = attr_node.attribute("value").as_string();
+      std::string_view type = attr_node.attribute("type").as_string();
+      std::string_view value = attr_node.attribute("value").as_string();
 
-      if (type == "int") {
-        attr_template.attributes.emplace_back(attr_name, std::stoi(value_str));
-      } else if (type == "float") {
-        attr_template.attributes.emplace_back(attr_name, std::stof(value_str));
-      } else if (type == "vec2") {
-        auto parts = Split(value_str, ',');
-        if (parts.size() == 2) {
-          attr_template.attributes.emplace_back(
-              attr_name, glm::vec2(std::stof(parts[0]), std::stof(parts[1])));
-        }
-      } else if (type == "vec3") {
-        auto parts = Split(value_str, ',');
-        if (parts.size() == 3) {
-          attr_template.attributes.emplace_back(
-              attr_name, glm::vec3(std::stof(parts[0]), std::stof(parts[1]),
-                                  std::stof(parts[2])));
-        }
-      } else if (type == "vec4") {
-        auto parts = Split(value_str, ',');
-        if (parts.size() == 4) {
-          attr_template.attributes.emplace_back(
-              attr_name,
-              glm::vec4(std::stof(parts[0]), std::stof(parts[1]),
-                        std::stof(parts[2]), std::stof(parts[3])));
-        }
-      } else if (type == "texture") {
-        auto parts = Split(value_str, ',');
-        if (parts.size() == 2) {
-          Texture texture{.id = static_cast<unsigned int>(std::stoul(parts[0])),
-                          .path = parts[1]};
-          attr_template.attributes.emplace_back(attr_name, texture);
+      // Template textures are stored as "id,path"
+      unsigned int texture_id = 0;
+      if (type == "texture") {
+        auto comma = value.find(',');
+        if (comma == std::string_view::npos ||
+            std::from_chars(value.data(), value.data() + comma, texture_id)
+                    .ec != std::errc()) {
+          continue;
         }
+        value.remove_prefix(comma + 1);
+      }
+      auto data = ParseValue(type, value);
+      if (!data) {
+        continue;
+      }
+      if (auto* texture = std::get_if<Texture>(&*data)) {
+        texture->id = texture_id;
       }
+      attr_template.attributes.emplace_back(
+          attr_node.attribute("name").as_string(), std::move(*data));
     }
 
-    templates.push_back(attr_template);
+    templates.push_back(std::move(attr_template));
   }
 
   return templates;
 }
 
-void attributes::SaveTemplates(const std::vector<AttributeTemplate> &templates) {
+void attributes::SaveTemplates(const std::vector<AttributeTemplate> &templates,
+                               std::string_view path) {
   pugi::xml_document doc;
   pugi::xml_node root = doc.append_child("Attributes");
 
@@ -118,12 +196,12 @@ void attributes::SaveTemplates(const std::vector<AttributeTemplate> &templates)
         Texture texture = std::get<Texture>(attr_data);
         attr_node.append_attribute("type") = "texture";
         attr_node.append_attribute("value") =
-            (std::to_string(texture.id) + "," + texture.path).c_str();
+            (std::to_string(texture.id) + "," + texture.Path()).c_str();
       }
     }
   }
 
-  if (!doc.save_file("attributes.xml")) {
-    std::cerr << "Failed to save attributes.xml" << std::endl;
+  if (!doc.save_file(std::string(path).c_str())) {
+    std::cerr << "Failed to save " << path << std::endl;
   }
 }
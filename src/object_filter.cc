@@ -0,0 +1,59 @@
+#include "object_filter.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace {
+bool ContainsIgnoringCase(std::string_view text, std::string_view query) {
+  return query.empty() ||
+         !std::ranges::search(text, query, [](char a, char b) {
+            return std::tolower(static_cast<unsigned char>(a)) ==
+                   std::tolower(static_cast<unsigned char>(b));
+          }).empty();
+}
+}  // namespace
+
+void ObjectFilter::SetQuery(std::string_view query) {
+  if (query == query_) {
+    return;
+  }
+  // Anything matching the new query also matched the old one it contains
+  narrow_ = valid_ && ContainsIgnoringCase(query, query_);
+  valid_ = narrow_;
+  query_ = query;
+}
+
+const std::vector<std::size_t>& ObjectFilter::Matches(const Scene& scene) {
+  const auto& objects = scene.objects;
+  if (valid_ && object_count_ <= objects.size()) {
+    if (narrow_) {
+      std::erase_if(matches_, [&](std::size_t index) {
+        return !Match(*objects[index]);
+      });
+    }
+    // Objects are only added at the end, so only those are new to the query
+    for (std::size_t i = object_count_; i < objects.size(); i++) {
+      if (Match(*objects[i])) {
+        matches_.push_back(i);
+      }
+    }
+  } else {
+    matches_.clear();
+    for (std::size_t i = 0; i < objects.size(); i++) {
+      if (Match(*objects[i])) {
+        matches_.push_back(i);
+      }
+    }
+  }
+  object_count_ = objects.size();
+  valid_ = true;
+  narrow_ = false;
+  return matches_;
+}
+
+bool ObjectFilter::Match(const Object& object) const {
+  return ContainsIgnoringCase(object.name, query_) ||
+         std::ranges::any_of(object.tags, [&](const std::string& tag) {
+           return ContainsIgnoringCase(tag, query_);
+         });
+}
@@ -0,0 +1,198 @@
+#include "particles.h"
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "helpers.h"
+
+namespace {
+// Position (vec2), velocity (vec2), age and generation, interleaved
+constexpr int kParticleFloats = 6;
+constexpr int kParticleStride = kParticleFloats * sizeof(float);
+
+// Points attribute `location` at the particle field `offset` floats in.
+void ParticleAttribute(int location, int size, int offset, bool instanced) {
+  glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, kParticleStride,
+                        reinterpret_cast<void*>(offset * sizeof(float)));
+  glEnableVertexAttribArray(location);
+  glVertexAttribDivisor(location, instanced ? 1 : 0);
+}
+}  // namespace
+
+ParticleSystem::ParticleSystem(unsigned int quad_vertex_buffer,
+                               unsigned int quad_index_buffer)
+    : quad_vertex_buffer_(quad_vertex_buffer),
+      quad_index_buffer_(quad_index_buffer) {
+  update_shader_ = LoadShaderProgram(
+      {{GL_VERTEX_SHADER, "assets/particle_update.glsl"}},
+      {"Position", "Velocity", "Age", "Generation"});
+  draw_shader_ =
+      LoadShaderProgram({{GL_VERTEX_SHADER, "assets/particle_vertex.glsl"},
+                         {GL_FRAGMENT_SHADER, "assets/sprite_fragment.glsl"}});
+  auto uniform_block_index = glGetUniformBlockIndex(draw_shader_, "Matrices");
+  glUniformBlockBinding(draw_shader_, uniform_block_index, 0);
+}
+
+ParticleSystem::~ParticleSystem() {
+  for (auto& particles : particles_) {
+    Release(particles);
+  }
+  glDeleteProgram(update_shader_);
+  glDeleteProgram(draw_shader_);
+}
+
+std::size_t ParticleSystem::ParticleCount() const {
+  std::size_t count = 0;
+  for (const auto& particles : particles_) {
+    count += particles.count;
+  }
+  return count;
+}
+
+void ParticleSystem::Allocate(Particles& particles,
+                              const EmitterProxy& emitter) {
+  Release(particles);
+  particles.count = emitter.count;
+  particles.current = 0;
+  // Unborn, each a fraction of a lifetime from being born
+  std::vector<float> initial(static_cast<std::size_t>(emitter.count) *
+                             kParticleFloats);
+  for (std::uint32_t i = 0; i < emitter.count; i++) {
+    initial[i * kParticleFloats + 4] = -emitter.lifetime *
+                                       static_cast<float>(i) /
+                                       static_cast<float>(emitter.count);
+  }
+  auto bytes = initial.size() * sizeof(float);
+  glGenBuffers(2, particles.buffers);
+  glGenVertexArrays(2, particles.update_arrays);
+  glGenVertexArrays(2, particles.draw_arrays);
+  for (int i = 0; i < 2; i++) {
+    glBindBuffer(GL_ARRAY_BUFFER, particles.buffers[i]);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(bytes),
+                 i == 0 ? initial.data() : nullptr, GL_DYNAMIC_COPY);
+    buffer_bytes[particles.buffers[i]] = bytes;
+
+    glBindVertexArray(particles.update_arrays[i]);
+    glBindBuffer(GL_ARRAY_BUFFER, particles.buffers[i]);
+    ParticleAttribute(0, 2, 0, false);
+    ParticleAttribute(1, 2, 2, false);
+    ParticleAttribute(2, 1, 4, false);
+    ParticleAttribute(3, 1, 5, false);
+
+    // The quad at locations 0 and 1, as in the sprite vertex array
+    glBindVertexArray(particles.draw_arrays[i]);
+    glBindBuffer(GL_ARRAY_BUFFER, quad_vertex_buffer_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_index_buffer_);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
+                          nullptr);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
+                          reinterpret_cast<void*>(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, particles.buffers[i]);
+    // One position and age per instance
+    ParticleAttribute(2, 2, 0, true);
+    ParticleAttribute(3, 1, 4, true);
+  }
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ParticleSystem::Release(Particles& particles) {
+  if (particles.count == 0) {
+    return;
+  }
+  for (auto buffer : particles.buffers) {
+    buffer_bytes.erase(buffer);
+  }
+  glDeleteVertexArrays(2, particles.update_arrays);
+  glDeleteVertexArrays(2, particles.draw_arrays);
+  glDeleteBuffers(2, particles.buffers);
+  particles = Particles();
+}
+
+void ParticleSystem::Update(std::span<const EmitterProxy> emitters,
+                            float seconds) {
+  for (std::size_t i = emitters.size(); i < particles_.size(); i++) {
+    Release(particles_[i]);
+  }
+  particles_.resize(emitters.size());
+  for (std::size_t i = 0; i < emitters.size(); i++) {
+    if (particles_[i].count != emitters[i].count) {
+      Allocate(particles_[i], emitters[i]);
+    }
+  }
+  if (emitters.empty() || seconds <= 0.0F) {
+    return;
+  }
+
+  glUseProgram(update_shader_);
+  glUniform1f(glGetUniformLocation(update_shader_, "delta"), seconds);
+  auto origin_location = glGetUniformLocation(update_shader_, "origin");
+  auto direction_location = glGetUniformLocation(update_shader_, "direction");
+  auto spread_location = glGetUniformLocation(update_shader_, "spread");
+  auto speed_location = glGetUniformLocation(update_shader_, "speed");
+  auto gravity_location = glGetUniformLocation(update_shader_, "gravity");
+  auto lifetime_location = glGetUniformLocation(update_shader_, "lifetime");
+  // Only the captured vertices are wanted
+  glEnable(GL_RASTERIZER_DISCARD);
+  for (std::size_t i = 0; i < emitters.size(); i++) {
+    const auto& emitter = emitters[i];
+    auto& particles = particles_[i];
+    glUniform2f(origin_location, emitter.position.x, emitter.position.y);
+    glUniform1f(direction_location, emitter.direction);
+    glUniform1f(spread_location, emitter.spread);
+    glUniform1f(speed_location, emitter.speed);
+    glUniform2f(gravity_location, emitter.gravity.x, emitter.gravity.y);
+    glUniform1f(lifetime_location, emitter.lifetime);
+    auto next = 1 - particles.current;
+    glBindVertexArray(particles.update_arrays[particles.current]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, particles.buffers[next]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, static_cast<int>(particles.count));
+    glEndTransformFeedback();
+    particles.current = next;
+  }
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  glDisable(GL_RASTERIZER_DISCARD);
+  glBindVertexArray(0);
+}
+
+void ParticleSystem::Draw(std::span<const EmitterProxy> emitters,
+                          bool normals, bool overdraw, float alpha_cutoff) {
+  glUseProgram(draw_shader_);
+  glUniform1i(glGetUniformLocation(draw_shader_, "sprite"), 0);
+  glUniform1i(glGetUniformLocation(draw_shader_, "mask"), 1);
+  // Unused, but samplers of another type need other units
+  glUniform1i(glGetUniformLocation(draw_shader_, "atlas"), 2);
+  glUniform1i(glGetUniformLocation(draw_shader_, "atlas_mask"), 3);
+  glUniform1i(glGetUniformLocation(draw_shader_, "atlas_layer"), -1);
+  glUniform1i(glGetUniformLocation(draw_shader_, "overdraw"),
+              overdraw ? 1 : 0);
+  glUniform1f(glGetUniformLocation(draw_shader_, "alpha_cutoff"),
+              alpha_cutoff);
+  auto size_location = glGetUniformLocation(draw_shader_, "size");
+  auto layer_location = glGetUniformLocation(draw_shader_, "layer");
+  for (std::size_t i = 0; i < emitters.size() && i < particles_.size(); i++) {
+    const auto& emitter = emitters[i];
+    auto texture = normals ? emitter.normal_texture : emitter.color_texture;
+    if (texture == SpriteProxy::kMissingTexture) {
+      continue;
+    }
+    glUniform1f(size_location, emitter.size);
+    glUniform1f(layer_location, emitter.position.z);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D,
+                  emitter.color_texture != SpriteProxy::kMissingTexture
+                      ? emitter.color_texture
+                      : texture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    const auto& particles = particles_[i];
+    glBindVertexArray(particles.draw_arrays[particles.current]);
+    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr,
+                            static_cast<int>(particles.count));
+  }
+  glBindVertexArray(0);
+}
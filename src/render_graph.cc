@@ -0,0 +1,159 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+#include "helpers.h"
+
+RenderGraph::RenderGraph(GLFWwindow* window, float scale)
+    : window_(window), scale_(scale) {}
+
+void RenderGraph::Reset() {
+  targets_.clear();
+  passes_.clear();
+}
+
+RenderGraph::Target RenderGraph::CreateTarget(std::string name, bool depth) {
+  targets_.push_back({.name = std::move(name), .depth = depth});
+  return targets_.size() - 1;
+}
+
+RenderGraph::Target RenderGraph::Import(std::string name,
+                                        unsigned int framebuffer,
+                                        glm::ivec2 size, unsigned int texture) {
+  targets_.push_back({.name = std::move(name),
+                      .imported = true,
+                      .framebuffer = framebuffer,
+                      .size = size,
+                      .texture = texture});
+  return targets_.size() - 1;
+}
+
+void RenderGraph::AddPass(std::string name, std::vector<Target> inputs,
+                          Target output, std::function<void()> execute) {
+  passes_.push_back({.name = std::move(name),
+                     .inputs = std::move(inputs),
+                     .output = output,
+                     .execute = std::move(execute)});
+}
+
+void RenderGraph::AddCopy(std::string name, Target source,
+                          Target destination) {
+  passes_.push_back({.name = std::move(name),
+                     .inputs = {source},
+                     .output = destination,
+                     .execute = nullptr});
+}
+
+void RenderGraph::Compile() {
+  // From the last pass back: a pass is kept if it draws into an imported
+  // target or one that a kept pass reads
+  std::vector<bool> read(targets_.size(), false);
+  stats_ = {.passes = passes_.size(), .targets = targets_.size()};
+  for (auto pass = passes_.rbegin(); pass != passes_.rend(); pass++) {
+    pass->culled = !targets_[pass->output].imported && !read[pass->output];
+    if (pass->culled) {
+      stats_.culled++;
+      continue;
+    }
+    for (auto input : pass->inputs) {
+      read[input] = true;
+    }
+  }
+
+  std::vector<std::size_t> last_use(targets_.size(), 0);
+  std::vector<bool> written(targets_.size(), false);
+  for (std::size_t i = 0; i < passes_.size(); i++) {
+    const auto& pass = passes_[i];
+    if (pass.culled) {
+      continue;
+    }
+    for (auto input : pass.inputs) {
+      if (!targets_[input].imported && !written[input]) {
+        throw std::runtime_error(
+            std::format("Render pass {} reads {} before it is drawn into",
+                        pass.name, targets_[input].name));
+      }
+      last_use[input] = i;
+    }
+    written[pass.output] = true;
+    last_use[pass.output] = std::max(last_use[pass.output], i);
+  }
+
+  // A target takes a framebuffer from the pool from the pass that first
+  // draws into it, which is free once the last pass using its previous
+  // target has run
+  for (auto& slot : pool_) {
+    slot.busy_until = kNone;
+  }
+  for (std::size_t i = 0; i < passes_.size(); i++) {
+    if (passes_[i].culled) {
+      continue;
+    }
+    auto& target = targets_[passes_[i].output];
+    if (target.imported || target.slot != kNone) {
+      continue;
+    }
+    auto slot = std::ranges::find_if(pool_, [&](const Slot& slot) {
+      return slot.depth == target.depth &&
+             (slot.busy_until == kNone || slot.busy_until < i);
+    });
+    if (slot == pool_.end()) {
+      pool_.push_back({.framebuffer =
+                           CreateFramebuffer(window_, scale_, target.depth),
+                       .depth = target.depth,
+                       .busy_until = kNone});
+      slot = pool_.end() - 1;
+    }
+    slot->busy_until = last_use[passes_[i].output];
+    target.slot = static_cast<std::size_t>(slot - pool_.begin());
+  }
+  stats_.framebuffers = pool_.size();
+}
+
+glm::ivec2 RenderGraph::Bind(GLenum binding, Target target) const {
+  const auto& info = targets_[target];
+  if (info.imported) {
+    glBindFramebuffer(binding, info.framebuffer);
+    return info.size;
+  }
+  const auto& framebuffer = *pool_[info.slot].framebuffer;
+  glBindFramebuffer(binding, framebuffer.id);
+  return framebuffer.size;
+}
+
+void RenderGraph::Execute() {
+  for (const auto& pass : passes_) {
+    if (pass.culled) {
+      continue;
+    }
+    if (!pass.execute) {
+      auto source = Bind(GL_READ_FRAMEBUFFER, pass.inputs.front());
+      auto destination = Bind(GL_DRAW_FRAMEBUFFER, pass.output);
+      glBlitFramebuffer(0, 0, source.x, source.y, 0, 0, destination.x,
+                        destination.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+      continue;
+    }
+    auto size = Bind(GL_FRAMEBUFFER, pass.output);
+    glViewport(0, 0, size.x, size.y);
+    pass.execute();
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+unsigned int RenderGraph::Texture(Target target) const {
+  const auto& info = targets_[target];
+  if (info.imported) {
+    return info.texture;
+  }
+  return info.slot != kNone ? pool_[info.slot].framebuffer->colorbuffer : 0;
+}
+
+glm::ivec2 RenderGraph::TransientSize() const {
+  int width;
+  int height;
+  glfwGetFramebufferSize(window_, &width, &height);
+  return {std::max(1, static_cast<int>(static_cast<float>(width) * scale_)),
+          std::max(1, static_cast<int>(static_cast<float>(height) * scale_))};
+}
@@ -0,0 +1,361 @@
+#include "render_proxy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "log.h"
+#include "transform.h"
+
+namespace {
+// The id of the object's texture attribute, or kMissingTexture
+unsigned int TextureId(Object& object, std::string_view name) {
+  auto* value = object.FindAttribute(name);
+  if (value == nullptr || !std::holds_alternative<Texture>(*value)) {
+    PostLog("Error retrieving texture attribute: " + std::string(name),
+            LogLevel::kError);
+    return SpriteProxy::kMissingTexture;
+  }
+  return std::get<Texture>(*value).id;
+}
+
+// The path handle of the object's texture attribute, or 0
+std::uint32_t TexturePathHandle(Object& object, std::string_view name) {
+  auto* value = object.FindAttribute(name);
+  return value != nullptr && std::holds_alternative<Texture>(*value)
+             ? std::get<Texture>(*value).path
+             : 0;
+}
+
+std::optional<SpriteProxy> CompileSprite(Object& object) {
+  if (!object.HasTag("sprite")) {
+    return std::nullopt;
+  }
+  SpriteProxy sprite{};
+  try {
+    sprite.model = ModelMatrix(
+        {std::get<glm::vec3>(object.GetAttribute("transform.position")),
+         std::get<glm::vec3>(object.GetAttribute("transform.scale")),
+         std::get<float>(object.GetAttribute("transform.rotation"))});
+  } catch (const std::exception& e) {
+    PostLog("Error retrieving transform attributes: " + std::string(e.what()),
+            LogLevel::kError);
+    return std::nullopt;
+  }
+  sprite.color_texture = TextureId(object, "texture.color");
+  sprite.normal_texture = TextureId(object, "texture.normal");
+  sprite.color_path = TexturePathHandle(object, "texture.color");
+  sprite.normal_path = TexturePathHandle(object, "texture.normal");
+  sprite.is_static = object.HasTag("static");
+  sprite.is_transparent = object.HasTag("transparent");
+  if (object.HasTag("animated")) {
+    try {
+      auto grid = std::get<glm::vec2>(object.GetAttribute("animation.grid"));
+      auto frames = std::get<int>(object.GetAttribute("animation.frames"));
+      auto mode = std::get<int>(object.GetAttribute("animation.mode"));
+      if (grid.x < 1.0F || grid.y < 1.0F || frames < 1 || mode < 0 ||
+          mode > static_cast<int>(AnimationMode::kPingPong)) {
+        throw std::runtime_error(
+            "grid and frames must be at least 1, mode 0, 1 or 2");
+      }
+      grid = glm::floor(grid);
+      sprite.animation = {
+          .grid = grid,
+          .frames = std::min(static_cast<float>(frames), grid.x * grid.y),
+          .rate = std::get<float>(object.GetAttribute("animation.rate")),
+          .mode = static_cast<AnimationMode>(mode),
+          .start = std::get<float>(object.GetAttribute("animation.start"))};
+    } catch (const std::exception& e) {
+      PostLog("Error retrieving animation attributes: " + std::string(e.what()),
+              LogLevel::kError);
+    }
+  }
+  return sprite;
+}
+
+std::optional<LightProxy> CompileLight(Object& object) {
+  if (!object.HasTag("light")) {
+    return std::nullopt;
+  }
+  try {
+    return LightProxy{
+        .position =
+            std::get<glm::vec3>(object.GetAttribute("transform.position")),
+        .type = std::get<int>(object.GetAttribute("light.type")),
+        .color = std::get<glm::vec3>(object.GetAttribute("light.color")),
+        .intensity = std::get<float>(object.GetAttribute("light.intensity")),
+        .falloff = std::get<float>(object.GetAttribute("light.radial_falloff")),
+        .volumetric_intensity =
+            std::get<float>(object.GetAttribute("light.volumetric_intensity")),
+        .is_static = object.HasTag("static")};
+  } catch (const std::exception& e) {
+    PostLog("Error retrieving light attributes: " + std::string(e.what()),
+            LogLevel::kError);
+    return std::nullopt;
+  }
+}
+
+std::optional<OccluderProxy> CompileOccluder(Object& object) {
+  if (!object.HasTag("occluder")) {
+    return std::nullopt;
+  }
+  try {
+    return OccluderProxy{.model = ModelMatrix(
+        {std::get<glm::vec3>(object.GetAttribute("transform.position")),
+         std::get<glm::vec3>(object.GetAttribute("transform.scale")),
+         std::get<float>(object.GetAttribute("transform.rotation"))})};
+  } catch (const std::exception& e) {
+    PostLog("Error retrieving occluder transform: " + std::string(e.what()),
+            LogLevel::kError);
+    return std::nullopt;
+  }
+}
+
+std::optional<EmitterProxy> CompileEmitter(Object& object) {
+  if (!object.HasTag("emitter")) {
+    return std::nullopt;
+  }
+  try {
+    auto count = std::get<int>(object.GetAttribute("particle.count"));
+    auto lifetime = std::get<float>(object.GetAttribute("particle.lifetime"));
+    if (count <= 0 || lifetime <= 0.0F) {
+      throw std::runtime_error("count and lifetime must be positive");
+    }
+    return EmitterProxy{
+        .position =
+            std::get<glm::vec3>(object.GetAttribute("transform.position")),
+        .direction = glm::radians(
+            std::get<float>(object.GetAttribute("transform.rotation"))),
+        .spread = glm::radians(
+            std::get<float>(object.GetAttribute("particle.spread"))),
+        .speed = std::get<float>(object.GetAttribute("particle.speed")),
+        .gravity = std::get<glm::vec2>(object.GetAttribute("particle.gravity")),
+        .size = std::get<float>(object.GetAttribute("particle.size")),
+        .lifetime = lifetime,
+        .count = static_cast<std::uint32_t>(count),
+        .color_texture = TextureId(object, "texture.color"),
+        .normal_texture = TextureId(object, "texture.normal")};
+  } catch (const std::exception& e) {
+    PostLog("Error retrieving emitter attributes: " + std::string(e.what()),
+            LogLevel::kError);
+    return std::nullopt;
+  }
+}
+
+bool SameObject(const std::weak_ptr<Object>& a,
+                const std::shared_ptr<Object>& b) {
+  return !a.owner_before(b) && !b.owner_before(a);
+}
+}  // namespace
+
+glm::vec4 AnimationFrame(const SpriteAnimation& animation, float time) {
+  float step =
+      animation.rate > 0.0F
+          ? std::floor(std::max(time - animation.start, 0.0F) * animation.rate)
+          : 0.0F;
+  float frame = 0.0F;
+  float period = 2.0F * animation.frames - 2.0F;
+  if (animation.mode == AnimationMode::kOnce) {
+    frame = std::min(step, animation.frames - 1.0F);
+  } else if (animation.mode == AnimationMode::kPingPong && period > 0.0F) {
+    frame = step - period * std::floor(step / period);
+    if (frame >= animation.frames) {
+      frame = period - frame;
+    }
+  } else {
+    frame = step - animation.frames * std::floor(step / animation.frames);
+  }
+  float column = frame - animation.grid.x * std::floor(frame / animation.grid.x);
+  float row = std::floor(frame / animation.grid.x);
+  return {glm::vec2(column, row) / animation.grid,
+          glm::vec2(1.0F) / animation.grid};
+}
+
+float LightReach(const LightProxy& light) {
+  // Light contributions below this are invisible
+  constexpr float kAttenuationCutoff = 1.0F / 256.0F;
+  if (light.falloff <= 0.0F) {
+    return std::numeric_limits<float>::infinity();
+  }
+  // Diffuse and volumetric together, for colors and albedo up to 1
+  float brightest =
+      light.intensity * (1.0F + std::max(light.volumetric_intensity, 0.0F));
+  float squared = (brightest / kAttenuationCutoff - 1.0F) / light.falloff;
+  return std::sqrt(std::max(squared, 0.0F));
+}
+
+void RenderProxies::Sync(Scene& scene) {
+  auto& objects = scene.objects;
+  changes_ = {};
+  // Replaced objects keep their index, so unless objects were reordered,
+  // only a change in count can have moved the others. Packing starts at the
+  // first slot that moved or became another kind of proxy.
+  bool repack = touched_order_ || slots_.size() != objects.size();
+  auto repack_from = repack ? Realign(objects) : objects.size();
+
+  std::vector<std::size_t> compiled;
+  auto compile = [&](std::size_t index) {
+    if (!Compile(slots_[index], objects[index])) {
+      repack = true;
+      repack_from = std::min(repack_from, index);
+    }
+    compiled.push_back(index);
+  };
+  for (auto index : touched_) {
+    if (index < objects.size()) {
+      compile(index);
+    }
+  }
+  for (std::size_t i = 0; i < objects.size(); i++) {
+    const auto& object = objects[i];
+    if (touched_all_ || !SameObject(slots_[i].object, object) ||
+        (object->prefab &&
+         std::ranges::find(touched_prefabs_, object->prefab.get()) !=
+             touched_prefabs_.end())) {
+      compile(i);
+    }
+  }
+  touched_.clear();
+  touched_prefabs_.clear();
+  touched_all_ = false;
+  touched_order_ = false;
+
+  if (repack) {
+    Pack(repack_from);
+  }
+  // Before the repacked slots, still the same sprites and lights, so their
+  // proxies update in place
+  for (auto index : compiled) {
+    if (repack && index >= repack_from) {
+      continue;
+    }
+    const auto& slot = slots_[index];
+    if (slot.sprite) {
+      sprites_[slot.sprite_index] = *slot.sprite;
+      changes_.sprites.Add(slot.sprite_index);
+    }
+    if (slot.light) {
+      lights_[slot.light_index] = *slot.light;
+      changes_.lights.Add(slot.light_index);
+    }
+    if (slot.occluder) {
+      occluders_[slot.occluder_index] = *slot.occluder;
+      changes_.occluders.Add(slot.occluder_index);
+    }
+    if (slot.emitter) {
+      emitters_[slot.emitter_index] = *slot.emitter;
+      changes_.emitters.Add(slot.emitter_index);
+    }
+  }
+}
+
+std::size_t RenderProxies::MemoryBytes() const {
+  return slots_.capacity() * sizeof(Slot) +
+         sprites_.capacity() * sizeof(SpriteProxy) +
+         lights_.capacity() * sizeof(LightProxy) +
+         occluders_.capacity() * sizeof(OccluderProxy) +
+         emitters_.capacity() * sizeof(EmitterProxy);
+}
+
+std::size_t RenderProxies::Realign(
+    const std::vector<std::shared_ptr<Object>>& objects) {
+  // Usually a single run of objects was added or removed, and the slots
+  // around it are only shifted
+  auto old_size = slots_.size();
+  auto common = std::min(old_size, objects.size());
+  std::size_t prefix = 0;
+  while (prefix < common && SameObject(slots_[prefix].object, objects[prefix])) {
+    prefix++;
+  }
+  std::size_t suffix = 0;
+  while (suffix < common - prefix &&
+         SameObject(slots_[old_size - 1 - suffix].object,
+                    objects[objects.size() - 1 - suffix])) {
+    suffix++;
+  }
+
+  // Between them, slots are found by their object
+  std::unordered_map<const Object*, std::size_t> indices;
+  indices.reserve(objects.size() - prefix - suffix);
+  for (auto i = prefix; i < objects.size() - suffix; i++) {
+    indices.emplace(objects[i].get(), i - prefix);
+  }
+  std::vector<Slot> middle(objects.size() - prefix - suffix);
+  for (auto i = prefix; i < old_size - suffix; i++) {
+    // Locked, as only a live object's address cannot belong to another
+    if (auto object = slots_[i].object.lock()) {
+      if (auto it = indices.find(object.get()); it != indices.end()) {
+        middle[it->second] = std::move(slots_[i]);
+      }
+    }
+  }
+  slots_.erase(slots_.begin() + static_cast<std::ptrdiff_t>(prefix),
+               slots_.end() - static_cast<std::ptrdiff_t>(suffix));
+  slots_.insert(slots_.begin() + static_cast<std::ptrdiff_t>(prefix),
+                std::make_move_iterator(middle.begin()),
+                std::make_move_iterator(middle.end()));
+  return prefix;
+}
+
+bool RenderProxies::Compile(Slot& slot,
+                            const std::shared_ptr<Object>& object) {
+  bool was_sprite = slot.sprite.has_value();
+  bool was_light = slot.light.has_value();
+  bool was_occluder = slot.occluder.has_value();
+  bool was_emitter = slot.emitter.has_value();
+  slot.object = object;
+  slot.sprite = CompileSprite(*object);
+  slot.light = CompileLight(*object);
+  slot.occluder = CompileOccluder(*object);
+  slot.emitter = CompileEmitter(*object);
+  return was_sprite == slot.sprite.has_value() &&
+         was_light == slot.light.has_value() &&
+         was_occluder == slot.occluder.has_value() &&
+         was_emitter == slot.emitter.has_value();
+}
+
+void RenderProxies::Pack(std::size_t first) {
+  // The slots before `first` kept their proxies' places
+  std::size_t sprites = 0;
+  std::size_t lights = 0;
+  std::size_t occluders = 0;
+  std::size_t emitters = 0;
+  for (std::size_t i = 0; i < first; i++) {
+    const auto& slot = slots_[i];
+    sprites += slot.sprite ? 1 : 0;
+    lights += slot.light ? 1 : 0;
+    occluders += slot.occluder ? 1 : 0;
+    emitters += slot.emitter ? 1 : 0;
+  }
+  sprites_.resize(sprites);
+  lights_.resize(lights);
+  occluders_.resize(occluders);
+  emitters_.resize(emitters);
+  for (auto i = first; i < slots_.size(); i++) {
+    auto& slot = slots_[i];
+    if (slot.sprite) {
+      slot.sprite_index = sprites_.size();
+      sprites_.push_back(*slot.sprite);
+    }
+    if (slot.light) {
+      slot.light_index = lights_.size();
+      lights_.push_back(*slot.light);
+    }
+    if (slot.occluder) {
+      slot.occluder_index = occluders_.size();
+      occluders_.push_back(*slot.occluder);
+    }
+    if (slot.emitter) {
+      slot.emitter_index = emitters_.size();
+      emitters_.push_back(*slot.emitter);
+    }
+  }
+  changes_.sprites.Merge({sprites, sprites_.size()});
+  changes_.lights.Merge({lights, lights_.size()});
+  changes_.occluders.Merge({occluders, occluders_.size()});
+  changes_.emitters.Merge({emitters, emitters_.size()});
+}
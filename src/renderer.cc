@@ -0,0 +1,572 @@
+#include "renderer.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <format>
+#include <stdexcept>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "helpers.h"
+
+namespace {
+constexpr float kOrthoScale = 10.0F;
+constexpr std::array<float, 20> kSpriteVertices = {
+    0.5F,  0.5F,  0.0F, 1.0F, 1.0F, 0.5F,  -0.5F, 0.0F, 1.0F, 0.0F,
+    -0.5F, -0.5F, 0.0F, 0.0F, 0.0F, -0.5F, 0.5F,  0.0F, 0.0F, 1.0F};
+constexpr std::array<float, 16> kDeferredVertices = {
+    1.0F,  1.0F,  1.0F, 1.0F, 1.0F,  -1.0F, 1.0F, 0.0F,
+    -1.0F, -1.0F, 0.0F, 0.0F, -1.0F, 1.0F,  0.0F, 1.0F};
+constexpr std::array<unsigned int, 6> kSharedIndices = {0, 1, 3, 1, 2, 3};
+// Alpha below which sprite_fragment.glsl discards
+constexpr float kOpaqueCutoff = 0.5F;
+constexpr float kTransparentCutoff = 1.0F / 255.0F;
+
+void SetLightUniforms(std::span<const LightProxy> lights,
+                      unsigned int shader) {
+  glUniform1i(glGetUniformLocation(shader, "light_count"), lights.size());
+  for (std::size_t i = 0; i < lights.size(); i++) {
+    const auto& light = lights[i];
+    auto prefix = std::format("lights[{}].", i);
+    glUniform1i(glGetUniformLocation(shader, (prefix + "type").c_str()),
+                light.type);
+    glUniform3fv(glGetUniformLocation(shader, (prefix + "position").c_str()), 1,
+                 glm::value_ptr(light.position));
+    glUniform1f(glGetUniformLocation(shader, (prefix + "intensity").c_str()),
+                light.intensity);
+    glUniform3fv(glGetUniformLocation(shader, (prefix + "color").c_str()), 1,
+                 glm::value_ptr(light.color));
+    glUniform1f(glGetUniformLocation(shader, (prefix + "falloff").c_str()),
+                light.falloff);
+    glUniform1f(
+        glGetUniformLocation(shader, (prefix + "volumetric_intensity").c_str()),
+        light.volumetric_intensity);
+  }
+}
+
+// One pass over the sprites at `order`, sampling the texture selected by
+// `texture` where the color texture's alpha covers them. Sprites packed in
+// `atlas`, if any, are drawn from its arrays, which DrawLayers binds.
+void DrawSprites(std::span<const SpriteProxy> sprites,
+                 std::span<const std::uint32_t> order, unsigned int shader,
+                 unsigned int SpriteProxy::*texture,
+                 const TextureAtlas* atlas) {
+  auto model_location = glGetUniformLocation(shader, "model");
+  auto layer_location = glGetUniformLocation(shader, "atlas_layer");
+  for (auto index : order) {
+    const auto& sprite = sprites[index];
+    if (sprite.*texture == SpriteProxy::kMissingTexture) {
+      continue;
+    }
+    glUniformMatrix4fv(model_location, 1, GL_FALSE,
+                       glm::value_ptr(sprite.model));
+    // Constant attributes, as static batches give them per vertex
+    const auto& animation = sprite.animation;
+    glVertexAttrib4f(2, animation.grid.x, animation.grid.y, animation.frames,
+                     animation.rate);
+    glVertexAttrib2f(3, static_cast<float>(animation.mode), animation.start);
+    const auto* entry =
+        atlas != nullptr
+            ? atlas->Find(sprite.color_texture, sprite.normal_texture)
+            : nullptr;
+    if (entry != nullptr) {
+      glVertexAttrib4fv(4, glm::value_ptr(entry->rect));
+      glUniform1i(layer_location, entry->layer);
+      glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+      continue;
+    }
+    glVertexAttrib4f(4, 0.0F, 0.0F, 1.0F, 1.0F);
+    glUniform1i(layer_location, -1);
+    // Without a color texture, the pass's own texture's alpha
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D,
+                  sprite.color_texture != SpriteProxy::kMissingTexture
+                      ? sprite.color_texture
+                      : sprite.*texture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, sprite.*texture);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+  }
+}
+
+// A float's bits, reordered so they sort as unsigned integers in the order
+// the floats do
+std::uint32_t OrderedBits(float value) {
+  auto bits = std::bit_cast<std::uint32_t>(value + 0.0F);
+  return (bits & 0x80000000U) != 0 ? ~bits : bits | 0x80000000U;
+}
+}  // namespace
+
+glm::mat4 Projection(glm::ivec2 viewport) {
+  float aspect = static_cast<float>(viewport.x) / static_cast<float>(viewport.y);
+  return glm::ortho(-kOrthoScale * aspect, kOrthoScale * aspect, -kOrthoScale,
+                    kOrthoScale, -1.0F, 1.0F);
+}
+
+Renderer::Renderer(GLFWwindow* window, std::size_t shadow_refresh_limit)
+    : graph_(window, 0.1F), shadow_maps_(shadow_refresh_limit) {
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_LESS);
+  sprite_shader_ =
+      LoadShaderProgram({{GL_VERTEX_SHADER, "assets/sprite_vertex.glsl"},
+                         {GL_FRAGMENT_SHADER, "assets/sprite_fragment.glsl"}});
+  deferred_shader_ = LoadShaderProgram(
+      {{GL_VERTEX_SHADER, "assets/deferred_vertex.glsl"},
+       {GL_FRAGMENT_SHADER, "assets/deferred_fragment.glsl"}});
+  bake_shader_ =
+      LoadShaderProgram({{GL_VERTEX_SHADER, "assets/deferred_vertex.glsl"},
+                         {GL_FRAGMENT_SHADER, "assets/bake_fragment.glsl"}});
+
+  auto sprite_uniform_buffer_create_info =
+      BufferCreateInfo<float>{.type = GL_UNIFORM_BUFFER,
+                              .usage = GL_STATIC_DRAW,
+                              .size = 2 * sizeof(glm::mat4),
+                              .data = NULL};
+  sprite_uniform_buffer_ =
+      CreateBufferObject(sprite_uniform_buffer_create_info);
+  auto uniform_block_index = glGetUniformBlockIndex(sprite_shader_, "Matrices");
+  glUniformBlockBinding(sprite_shader_, uniform_block_index, 0);
+  glBindBufferRange(GL_UNIFORM_BUFFER, 0, sprite_uniform_buffer_, 0,
+                    2 * sizeof(glm::mat4));
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  auto sprite_vertices_create_info =
+      BufferCreateInfo<float>{.type = GL_ARRAY_BUFFER,
+                              .usage = GL_STATIC_DRAW,
+                              .size = kSpriteVertices.size() * sizeof(float),
+                              .data = kSpriteVertices.data()};
+  auto sprite_indices_create_info = BufferCreateInfo<unsigned int>{
+      .type = GL_ELEMENT_ARRAY_BUFFER,
+      .usage = GL_STATIC_DRAW,
+      .size = kSharedIndices.size() * sizeof(unsigned int),
+      .data = kSharedIndices.data()};
+  auto sprite_vertex_buffer = CreateBufferObject(sprite_vertices_create_info);
+  auto sprite_indices_buffer = CreateBufferObject(sprite_indices_create_info);
+  auto sprite_vertex_array_create_info = VertexArrayCreateInfo{
+      .attributes = {{
+        .index = 0,
+        .size = 3,
+        .type = GL_FLOAT,
+        .normalized = GL_FALSE,
+        .stride = 5 * sizeof(float),
+        .pointer = static_cast<void*>(nullptr)},
+                     {
+        .index = 1,
+        .size = 2,
+        .type = GL_FLOAT,
+        .normalized = GL_FALSE,
+        .stride = 5 * sizeof(float),
+        .pointer = (void*)(3 * sizeof(float))}},
+      .buffers = {
+          {GL_ARRAY_BUFFER, sprite_vertex_buffer},
+          {GL_ELEMENT_ARRAY_BUFFER, sprite_indices_buffer},
+      }};
+  sprite_vertex_array_ =
+      CreateVertexArrayObject(sprite_vertex_array_create_info);
+  glBindVertexArray(0);
+
+  auto deferred_vertices_create_info =
+      BufferCreateInfo<float>{.type = GL_ARRAY_BUFFER,
+                              .usage = GL_STATIC_DRAW,
+                              .size = kDeferredVertices.size() * sizeof(float),
+                              .data = kDeferredVertices.data()};
+  auto deferred_indices_create_info = BufferCreateInfo<unsigned int>{
+      .type = GL_ELEMENT_ARRAY_BUFFER,
+      .usage = GL_STATIC_DRAW,
+      .size = kSharedIndices.size() * sizeof(unsigned int),
+      .data = kSharedIndices.data()};
+  auto deferred_vertex_buffer =
+      CreateBufferObject(deferred_vertices_create_info);
+  auto deferred_indices_buffer =
+      CreateBufferObject(deferred_indices_create_info);
+  auto deferred_vertex_array_create_info = VertexArrayCreateInfo{
+      .attributes = {{0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
+                      (void*)nullptr},
+                     {1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
+                      (void*)(2 * sizeof(float))}},
+      .buffers = {{GL_ARRAY_BUFFER, deferred_vertex_buffer},
+                  {GL_ELEMENT_ARRAY_BUFFER, deferred_indices_buffer}}};
+  deferred_vertex_array_ =
+      CreateVertexArrayObject(deferred_vertex_array_create_info);
+  glBindVertexArray(0);
+
+  // Wraps around the angle, not between lights
+  glGenTextures(1, &shadow_atlas_);
+  glBindTexture(GL_TEXTURE_2D, shadow_atlas_);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, ShadowMaps::kResolution,
+               ShadowMaps::kMaxLights, 0, GL_RED, GL_FLOAT,
+               shadow_maps_.Atlas().data());
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  loaded_textures.push_back(shadow_atlas_);
+  texture_bytes[shadow_atlas_] = shadow_maps_.Atlas().size_bytes();
+
+  glGenQueries(1, &overdraw_query_);
+
+  glGenFramebuffers(1, &lightmap_framebuffer_);
+  glGenTextures(1, &baked_diffuse_);
+  glGenTextures(1, &baked_volumetric_);
+  loaded_textures.push_back(baked_diffuse_);
+  loaded_textures.push_back(baked_volumetric_);
+  ResizeLightmap();
+
+  particles_ = std::make_unique<ParticleSystem>(sprite_vertex_buffer,
+                                                sprite_indices_buffer);
+}
+
+Renderer::~Renderer() {
+  glDeleteProgram(sprite_shader_);
+  glDeleteProgram(deferred_shader_);
+  glDeleteProgram(bake_shader_);
+  glDeleteFramebuffers(1, &lightmap_framebuffer_);
+  glDeleteQueries(1, &overdraw_query_);
+}
+
+void Renderer::SetDebugOptions(RenderDebugOptions options) {
+  // The baked normals were drawn in another order
+  if (options.depth_sort != debug_options_.depth_sort ||
+      options.static_batching != debug_options_.static_batching) {
+    static_lighting_.Invalidate();
+  }
+  debug_options_ = options;
+  if (!Batching()) {
+    static_batches_.Clear();
+  }
+}
+
+void Renderer::Sort(std::span<const SpriteProxy> sprites,
+                    const glm::mat4& view) {
+  opaque_order_.clear();
+  transparent_order_.clear();
+  if (!debug_options_.depth_sort) {
+    for (std::uint32_t i = 0; i < sprites.size(); i++) {
+      (sprites[i].is_transparent ? transparent_order_ : opaque_order_)
+          .push_back(i);
+    }
+    return;
+  }
+  // The layer as seen: z of the sprite's centre in view space
+  glm::vec4 depth_row(view[0][2], view[1][2], view[2][2], view[3][2]);
+  sort_keys_.clear();
+  bool batching = Batching();
+  for (std::uint32_t i = 0; i < sprites.size(); i++) {
+    if (batching && StaticBatches::Batched(sprites[i])) {
+      continue;
+    }
+    auto layer = glm::dot(depth_row, sprites[i].model[3]);
+    sort_keys_.push_back((std::uint64_t{OrderedBits(layer)} << 32U) | i);
+  }
+  std::ranges::sort(sort_keys_);
+  // Back to front, and of sprites on a layer, earlier first
+  for (auto key : sort_keys_) {
+    auto index = static_cast<std::uint32_t>(key);
+    if (sprites[index].is_transparent) {
+      transparent_order_.push_back(index);
+    }
+  }
+  for (auto key = sort_keys_.rbegin(); key != sort_keys_.rend(); key++) {
+    auto index = static_cast<std::uint32_t>(*key);
+    if (!sprites[index].is_transparent) {
+      opaque_order_.push_back(index);
+    }
+  }
+}
+
+void Renderer::DrawLayers(std::span<const SpriteProxy> sprites,
+                          std::span<const EmitterProxy> emitters,
+                          unsigned int SpriteProxy::*texture, bool overdraw) {
+  glUseProgram(sprite_shader_);
+  glBindVertexArray(sprite_vertex_array_);
+  // The atlas stays bound for the pass, beside the sprites' own textures
+  glUniform1i(glGetUniformLocation(sprite_shader_, "sprite"), 0);
+  glUniform1i(glGetUniformLocation(sprite_shader_, "mask"), 1);
+  glUniform1i(glGetUniformLocation(sprite_shader_, "atlas"), 2);
+  glUniform1i(glGetUniformLocation(sprite_shader_, "atlas_mask"), 3);
+  glUniform1f(glGetUniformLocation(sprite_shader_, "time"),
+              static_cast<float>(time_));
+  glActiveTexture(GL_TEXTURE2);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture == &SpriteProxy::normal_texture
+                                         ? atlas_.NormalArray()
+                                         : atlas_.ColorArray());
+  glActiveTexture(GL_TEXTURE3);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, atlas_.ColorArray());
+  glActiveTexture(GL_TEXTURE0);
+  glUniform1i(glGetUniformLocation(sprite_shader_, "overdraw"),
+              overdraw ? 1 : 0);
+  auto cutoff_location = glGetUniformLocation(sprite_shader_, "alpha_cutoff");
+  if (!debug_options_.depth_sort) {
+    glDisable(GL_DEPTH_TEST);
+  }
+  if (overdraw) {
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+  }
+  // Front to back: the nearest sprite on a pixel hides the rest from shading,
+  // and of equal layers the one drawn first, which comes later in the list
+  glUniform1f(cutoff_location, kOpaqueCutoff);
+  DrawSprites(sprites, opaque_order_, sprite_shader_, texture,
+              ActiveAtlas());
+  if (Batching()) {
+    static_batches_.Draw(view_projection_, sprite_shader_, texture);
+    glBindVertexArray(sprite_vertex_array_);
+  }
+  // Particles are too many to sort, so are cut out like opaque sprites
+  if (!emitters.empty()) {
+    particles_->Draw(emitters, texture == &SpriteProxy::normal_texture,
+                     overdraw, kOpaqueCutoff);
+    glUseProgram(sprite_shader_);
+    glBindVertexArray(sprite_vertex_array_);
+  }
+
+  // Over the opaque sprites of their layer, without hiding each other
+  glUniform1f(cutoff_location, kTransparentCutoff);
+  glDepthFunc(GL_LEQUAL);
+  glDepthMask(GL_FALSE);
+  if (!overdraw) {
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  }
+  DrawSprites(sprites, transparent_order_, sprite_shader_, texture,
+              ActiveAtlas());
+  glDepthMask(GL_TRUE);
+  glDepthFunc(GL_LESS);
+  glDisable(GL_BLEND);
+  glEnable(GL_DEPTH_TEST);
+}
+
+void Renderer::LoadLightmap(const std::string& path) {
+  loaded_lightmap_ = ::LoadLightmap(path);
+}
+
+void Renderer::SaveLightmap(const std::string& path) {
+  LightmapFile lightmap{.signature = static_lighting_.Signature(),
+                        .size = lightmap_size_,
+                        .diffuse = {},
+                        .volumetric = {}};
+  auto floats = static_cast<std::size_t>(lightmap_size_.x) *
+                static_cast<std::size_t>(lightmap_size_.y) * 4;
+  lightmap.diffuse.resize(floats);
+  lightmap.volumetric.resize(floats);
+  glBindTexture(GL_TEXTURE_2D, baked_diffuse_);
+  glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, lightmap.diffuse.data());
+  glBindTexture(GL_TEXTURE_2D, baked_volumetric_);
+  glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT,
+                lightmap.volumetric.data());
+  ::SaveLightmap(path, lightmap);
+}
+
+void Renderer::ResizeLightmap() {
+  lightmap_size_ = graph_.TransientSize();
+  for (auto texture : {baked_diffuse_, baked_volumetric_}) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, lightmap_size_.x,
+                 lightmap_size_.y, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // Four half floats
+    texture_bytes[texture] = static_cast<std::size_t>(lightmap_size_.x) *
+                             static_cast<std::size_t>(lightmap_size_.y) * 8;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, lightmap_framebuffer_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         baked_diffuse_, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+                         baked_volumetric_, 0);
+  constexpr std::array<GLenum, 2> kDrawBuffers = {GL_COLOR_ATTACHMENT0,
+                                                  GL_COLOR_ATTACHMENT1};
+  glDrawBuffers(kDrawBuffers.size(), kDrawBuffers.data());
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    throw std::runtime_error("Lightmap framebuffer is not complete...");
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Renderer::Bake(StaticLighting::Region region, const glm::mat4& view,
+                    glm::vec3 clear_color, RenderGraph::Target lightmap) {
+  auto scissor = [region] {
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(region.first.x, region.first.y, region.last.x - region.first.x,
+              region.last.y - region.first.y);
+  };
+
+  // Normals of the static sprites alone, cleared the way the normal pass is.
+  // Runs before the color pass, which sorts the frame's sprites again.
+  auto static_normals = graph_.CreateTarget("static normals", true);
+  graph_.AddPass("static normals", {}, static_normals, [=, this] {
+    scissor();
+    glClearColor(clear_color.r, clear_color.g, clear_color.b, 1.0F);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    Sort(static_lighting_.Sprites(), view);
+    DrawLayers(static_lighting_.Sprites(), {}, &SpriteProxy::normal_texture,
+               false);
+    glDisable(GL_SCISSOR_TEST);
+  });
+
+  graph_.AddPass("bake", {static_normals}, lightmap, [=, this] {
+    scissor();
+    glClearColor(0.0F, 0.0F, 0.0F, 0.0F);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glUseProgram(bake_shader_);
+    glUniform1i(glGetUniformLocation(bake_shader_, "normal_buffer"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, graph_.Texture(static_normals));
+    glBindVertexArray(deferred_vertex_array_);
+    // The shader takes ShadowMaps::kMaxLights lights at a time
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    auto lights = static_lighting_.Lights();
+    for (std::size_t first = 0; first < lights.size();
+         first += ShadowMaps::kMaxLights) {
+      SetLightUniforms(
+          lights.subspan(first, std::min(lights.size() - first,
+                                         ShadowMaps::kMaxLights)),
+          bake_shader_);
+      glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+    }
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+  });
+}
+
+void Renderer::Draw(std::span<const SpriteProxy> sprites,
+                    std::span<const LightProxy> lights,
+                    std::span<const OccluderProxy> occluders,
+                    std::span<const EmitterProxy> emitters,
+                    const glm::mat4& view, glm::ivec2 viewport,
+                    glm::vec3 clear_color) {
+  auto projection = Projection(viewport);
+  view_projection_ = projection * view;
+  dynamic_lights_.clear();
+  std::ranges::copy_if(lights, std::back_inserter(dynamic_lights_),
+                       [](const LightProxy& light) { return !light.is_static; });
+  auto shaded = light_lod_.Reduce(dynamic_lights_);
+  if (shadow_maps_.Update(shaded, occluders, projection * view)) {
+    glBindTexture(GL_TEXTURE_2D, shadow_atlas_);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ShadowMaps::kResolution,
+                    ShadowMaps::kMaxLights, GL_RED, GL_FLOAT,
+                    shadow_maps_.Atlas().data());
+  }
+  glBindBuffer(GL_UNIFORM_BUFFER, sprite_uniform_buffer_);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4),
+                  glm::value_ptr(projection));
+  glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4),
+                  glm::value_ptr(view));
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  if (debug_options_.texture_atlas) {
+    atlas_.Update(sprites);
+  }
+  if (Batching()) {
+    static_batches_.Update(sprites, ActiveAtlas());
+  }
+
+  if (lightmap_size_ != graph_.TransientSize()) {
+    ResizeLightmap();
+  }
+  graph_.Reset();
+  auto window = graph_.Import("window", 0, viewport);
+  auto lightmap = graph_.Import("lightmap", lightmap_framebuffer_,
+                                lightmap_size_, baked_diffuse_);
+  auto region = static_lighting_.Update(sprites, lights, projection * view,
+                                        clear_color, lightmap_size_);
+  if (loaded_lightmap_ && loaded_lightmap_->size == lightmap_size_ &&
+      loaded_lightmap_->signature == static_lighting_.Signature()) {
+    glBindTexture(GL_TEXTURE_2D, baked_diffuse_);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, lightmap_size_.x, lightmap_size_.y,
+                    GL_RGBA, GL_FLOAT, loaded_lightmap_->diffuse.data());
+    glBindTexture(GL_TEXTURE_2D, baked_volumetric_);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, lightmap_size_.x, lightmap_size_.y,
+                    GL_RGBA, GL_FLOAT, loaded_lightmap_->volumetric.data());
+    loaded_lightmap_.reset();
+  } else if (!region.Empty()) {
+    Bake(region, view, clear_color, lightmap);
+  }
+
+  if (overdraw_query_pending_) {
+    GLuint available = 0;
+    glGetQueryObjectuiv(overdraw_query_, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available != 0) {
+      GLuint samples = 0;
+      glGetQueryObjectuiv(overdraw_query_, GL_QUERY_RESULT, &samples);
+      auto size = graph_.TransientSize();
+      overdraw_ = static_cast<float>(samples) /
+                  static_cast<float>(size.x * size.y);
+      overdraw_query_pending_ = false;
+    }
+  }
+
+  particles_->Update(emitters, pending_seconds_);
+  pending_seconds_ = 0.0F;
+
+  auto color = graph_.CreateTarget("color", true);
+  graph_.AddPass("color", {}, color, [=, this] {
+    Sort(sprites, view);
+    glClearColor(clear_color.r, clear_color.g, clear_color.b, 1.0F);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    bool measure = !overdraw_query_pending_;
+    if (measure) {
+      glBeginQuery(GL_SAMPLES_PASSED, overdraw_query_);
+    }
+    DrawLayers(sprites, emitters, &SpriteProxy::color_texture,
+               debug_options_.overdraw);
+    if (measure) {
+      glEndQuery(GL_SAMPLES_PASSED);
+      overdraw_query_pending_ = true;
+    }
+  });
+
+  // In the order the color pass sorted them
+  auto normal = graph_.CreateTarget("normal", true);
+  graph_.AddPass("normal", {}, normal, [=, this] {
+    glClearColor(clear_color.r, clear_color.g, clear_color.b, 1.0F);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    DrawLayers(sprites, emitters, &SpriteProxy::normal_texture, false);
+  });
+
+  // Only point lights are shaded by the sprites' normals
+  std::vector<RenderGraph::Target> lighting_inputs = {color, lightmap};
+  if (std::ranges::any_of(shaded, [](const LightProxy& light) {
+        return light.type == 1;
+      })) {
+    lighting_inputs.push_back(normal);
+  }
+  auto lit = graph_.CreateTarget("lit");
+  graph_.AddPass("lighting", lighting_inputs, lit, [=, this] {
+    glClearColor(clear_color.r, clear_color.g, clear_color.b, 1.0F);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glUseProgram(deferred_shader_);
+    SetLightUniforms(shaded, deferred_shader_);
+    glUniform1i(glGetUniformLocation(deferred_shader_, "color_buffer"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, graph_.Texture(color));
+    glUniform1i(glGetUniformLocation(deferred_shader_, "normal_buffer"), 1);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, graph_.Texture(normal));
+    glUniform1i(glGetUniformLocation(deferred_shader_, "shadow_atlas"), 2);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, shadow_atlas_);
+    glUniform1i(glGetUniformLocation(deferred_shader_, "baked_diffuse"), 3);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, baked_diffuse_);
+    glUniform1i(glGetUniformLocation(deferred_shader_, "baked_volumetric"),
+                4);
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_2D, baked_volumetric_);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(deferred_vertex_array_);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+  });
+
+  // Scaled up into the window; showing overdraw, the color pass as it is
+  graph_.AddCopy("present", debug_options_.overdraw ? color : lit, window);
+
+  graph_.Compile();
+  graph_.Execute();
+  glViewport(0, 0, viewport.x, viewport.y);
+}
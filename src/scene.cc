@@ -1,85 +1,420 @@
 #include "scene.h"
+#include <array>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <optional>
 #include <pugixml.hpp>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include "binary_scene.h"
+#include "journal.h"
+#include "mapped_file.h"
+#include "parallel.h"
 #include "texture.h"
-Scene LoadScene(std::string_view path) {
-  Scene scene;
+
+namespace {
+constexpr std::size_t kMinObjectsPerThread = 4096;
+
+bool IsBinaryScene(std::string_view path) {
+  return std::filesystem::path(path).extension() == binary_scene::kExtension;
+}
+
+using PrefabLookup =
+    std::unordered_map<std::string_view, std::shared_ptr<AttributeTemplate>>;
+
+void ParseAttributes(
+    pugi::xml_node node,
+    std::vector<std::pair<std::string, AttributeData>>& attributes) {
+  for (auto attribute_node : node.children("attribute")) {
+    std::string_view type = attribute_node.attribute("type").as_string();
+    auto value = attributes::ParseValue(
+        type, attribute_node.attribute("value").as_string());
+    if (!value) {
+      throw std::runtime_error("Unknown attribute type or malformed value: " +
+                               std::string(type));
+    }
+    // Not SetAttribute: this runs on worker threads and must not log.
+    attributes.emplace_back(attribute_node.attribute("name").as_string(),
+                            std::move(*value));
+  }
+}
+
+std::vector<std::shared_ptr<AttributeTemplate>> ParsePrefabs(
+    pugi::xml_node scene_node) {
+  std::vector<std::shared_ptr<AttributeTemplate>> prefabs;
+  for (auto prefab_node : scene_node.children("prefab")) {
+    auto prefab = std::make_shared<AttributeTemplate>();
+    prefab->name = prefab_node.attribute("name").as_string();
+    ParseAttributes(prefab_node, prefab->attributes);
+    prefabs.push_back(std::move(prefab));
+  }
+  return prefabs;
+}
+
+PrefabLookup MakePrefabLookup(
+    const std::vector<std::shared_ptr<AttributeTemplate>>& prefabs) {
+  PrefabLookup lookup;
+  for (const auto& prefab : prefabs) {
+    if (!lookup.emplace(prefab->name, prefab).second) {
+      throw std::runtime_error("Duplicate prefab: " + prefab->name);
+    }
+  }
+  return lookup;
+}
+
+std::shared_ptr<Object> ParseObject(pugi::xml_node object_node,
+                                    const PrefabLookup& prefabs) {
+  auto object = std::make_shared<Object>();
+  object->name = object_node.attribute("name").as_string();
+  std::string_view prefab = object_node.attribute("prefab").as_string();
+  if (!prefab.empty()) {
+    auto it = prefabs.find(prefab);
+    if (it == prefabs.end()) {
+      throw std::runtime_error("Unknown prefab: " + std::string(prefab));
+    }
+    object->prefab = it->second;
+  }
+  ParseAttributes(object_node, object->attributes);
+  for (auto tag_node : object_node.children("tag")) {
+    object->tags.emplace_back(tag_node.attribute("name").as_string());
+  }
+  return object;
+}
+
+// Textures need the GL context, so they are loaded here on the calling thread,
+// once per distinct path.
+void LoadSceneTextures(Scene& scene) {
+  // By path handle
+  std::unordered_map<std::uint32_t, unsigned int> loaded;
+  auto load = [&](auto& attributes) {
+    for (auto& [name, value] : attributes) {
+      if (auto* texture = std::get_if<Texture>(&value)) {
+        auto [it, inserted] = loaded.try_emplace(texture->path, 0U);
+        if (inserted) {
+          it->second = LoadTexture(texture->Path()).id;
+        }
+        texture->id = it->second;
+      }
+    }
+  };
+  for (auto& prefab : scene.prefabs) {
+    load(prefab->attributes);
+  }
+  for (auto& object : scene.objects) {
+    load(object->attributes);
+  }
+}
+
+// Returns indices in increasing distance from `focus`; objects without a
+// position go last. Ties keep file order.
+template <typename PositionFn>
+std::vector<std::size_t> NearestFirst(std::size_t count, glm::vec2 focus,
+                                      PositionFn position) {
+  std::vector<float> distances(count);
+  for (std::size_t i = 0; i < count; i++) {
+    auto p = position(i);
+    distances[i] = p ? glm::length(glm::vec2(p->x, p->y) - focus)
+                     : std::numeric_limits<float>::infinity();
+  }
+  std::vector<std::size_t> order(count);
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::stable_sort(order, {},
+                           [&](std::size_t i) { return distances[i]; });
+  return order;
+}
+
+// The prefabs go with the first chunk, which is sent even when the scene has
+// no objects.
+void EmitChunks(std::span<const std::size_t> order, std::size_t chunk_size,
+                std::vector<std::shared_ptr<AttributeTemplate>> prefabs,
+                const std::function<std::shared_ptr<Object>(std::size_t)>& read,
+                const std::function<bool(SceneChunk&&)>& sink) {
+  for (std::size_t begin = 0; begin == 0 || begin < order.size();
+       begin += chunk_size) {
+    auto indices =
+        order.subspan(begin, std::min(chunk_size, order.size() - begin));
+    SceneChunk chunk{.total = order.size(),
+                     .indices = {indices.begin(), indices.end()},
+                     .objects = std::vector<std::shared_ptr<Object>>(
+                         indices.size()),
+                     .prefabs = std::exchange(prefabs, {})};
+    ParallelChunks(indices.size(), kMinObjectsPerThread,
+                   [&](std::size_t first, std::size_t last) {
+                     for (auto i = first; i < last; i++) {
+                       chunk.objects[i] = read(indices[i]);
+                     }
+                   });
+    if (!sink(std::move(chunk))) {
+      return;
+    }
+  }
+}
+
+Scene LoadXmlScene(std::string_view path, bool load_textures) {
+  // Parsed in place from a private mapping, so attribute values are views
+  // into the file rather than copies.
+  MappedFile file(path, true);
   pugi::xml_document doc;
-  auto result = doc.load_file(path.data());
+  auto result = doc.load_buffer_inplace(file.MutableData(), file.Size());
   if (!result) {
     throw std::runtime_error("Failed to load scene");
   }
-  auto root = doc.child("scene");
-  for (auto object_node : root.children("object")) {
-    auto object = std::make_shared<Object>();
-    for (auto attribute_node : object_node.children("attribute")) {
-      const std::string name = attribute_node.attribute("name").as_string();
-      const std::string type = attribute_node.attribute("type").as_string();
-      const std::string value = attribute_node.attribute("value").as_string();
-      if (type == "int") {
-        object->SetAttribute(name, std::stoi(value));
-      } else if (type == "float") {
-        object->SetAttribute(name, std::stof(value));
-      } else if (type == "vec2") {
-        glm::vec2 vec;
-        sscanf(value.c_str(), "%f,%f", &vec.x, &vec.y);
-        object->SetAttribute(name, vec);
-      } else if (type == "vec3") {
-        glm::vec3 vec;
-        sscanf(value.c_str(), "%f,%f,%f", &vec.x, &vec.y,
-                &vec.z);
-        object->SetAttribute(name, vec);
-      } else if (type == "texture") {
-        object->SetAttribute(name, LoadTexture(value));
-      } else {
-        throw std::runtime_error("Unknown attribute type");
+  std::vector<pugi::xml_node> object_nodes;
+  for (auto object_node : doc.child("scene").children("object")) {
+    object_nodes.push_back(object_node);
+  }
+  Scene scene;
+  scene.prefabs = ParsePrefabs(doc.child("scene"));
+  auto prefabs = MakePrefabLookup(scene.prefabs);
+  scene.objects.resize(object_nodes.size());
+  ParallelChunks(object_nodes.size(), kMinObjectsPerThread,
+                 [&](std::size_t begin, std::size_t end) {
+                   for (auto i = begin; i < end; i++) {
+                     scene.objects[i] = ParseObject(object_nodes[i], prefabs);
+                   }
+                 });
+  if (load_textures) {
+    LoadSceneTextures(scene);
+  }
+  return scene;
+}
+
+// Writes the XML text directly through a fixed-size buffer, formatting
+// numbers with std::to_chars (shortest round-trip form) instead of building a
+// DOM of temporary strings.
+class XmlWriter {
+ public:
+  explicit XmlWriter(std::string_view path)
+      : file_(std::string(path), std::ios::binary | std::ios::trunc) {
+    if (!file_.is_open()) {
+      throw std::runtime_error("Failed to open file: " + std::string(path));
+    }
+    buffer_.reserve(kBufferSize);
+  }
+
+  XmlWriter& operator<<(std::string_view text) {
+    buffer_ += text;
+    if (buffer_.size() >= kBufferSize) {
+      Flush();
+    }
+    return *this;
+  }
+
+  template <typename T>
+    requires std::is_arithmetic_v<T>
+  XmlWriter& operator<<(T value) {
+    std::array<char, 32> digits;
+    auto [end, error] =
+        std::to_chars(digits.data(), digits.data() + digits.size(), value);
+    return *this << std::string_view(digits.data(), end);
+  }
+
+  XmlWriter& Escaped(std::string_view text) {
+    for (char c : text) {
+      switch (c) {
+        case '&':
+          *this << "&amp;";
+          break;
+        case '<':
+          *this << "&lt;";
+          break;
+        case '>':
+          *this << "&gt;";
+          break;
+        case '"':
+          *this << "&quot;";
+          break;
+        default:
+          buffer_ += c;
+          break;
       }
     }
-    for (auto tag_node : object_node.children("tag")) {
-      object->tags.emplace_back(tag_node.attribute("name").as_string());
+    return *this;
+  }
+
+  void Flush() {
+    file_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+    if (!file_) {
+      throw std::runtime_error("Failed to write scene");
     }
-    scene.objects.push_back(object);
   }
-  return scene;
+
+ private:
+  static constexpr std::size_t kBufferSize = 1 << 20;
+  std::ofstream file_;
+  std::string buffer_;
+};
+
+void WriteAttributes(
+    XmlWriter& writer,
+    const std::vector<std::pair<std::string, AttributeData>>& attributes) {
+  for (const auto& [name, value] : attributes) {
+    writer << "\t\t<attribute name=\"";
+    writer.Escaped(name) << "\" type=\"";
+    std::visit(
+        [&](const auto& v) {
+          using T = std::decay_t<decltype(v)>;
+          if constexpr (std::is_same_v<T, int>) {
+            writer << "int\" value=\"" << v;
+          } else if constexpr (std::is_same_v<T, float>) {
+            writer << "float\" value=\"" << v;
+          } else if constexpr (std::is_same_v<T, glm::vec2>) {
+            writer << "vec2\" value=\"" << v.x << "," << v.y;
+          } else if constexpr (std::is_same_v<T, glm::vec3>) {
+            writer << "vec3\" value=\"" << v.x << "," << v.y << "," << v.z;
+          } else if constexpr (std::is_same_v<T, glm::vec4>) {
+            writer << "vec4\" value=\"" << v.x << "," << v.y << "," << v.z
+                   << "," << v.w;
+          } else if constexpr (std::is_same_v<T, Texture>) {
+            writer << "texture\" value=\"";
+            writer.Escaped(v.Path());
+          }
+        },
+        value);
+    writer << "\" />\n";
+  }
 }
 
-void SaveScene(const Scene& scene, std::string_view path) {
-  pugi::xml_document doc;
-  auto root = doc.append_child("scene");
+void SaveXmlScene(const Scene& scene, std::string_view path,
+                  std::atomic<std::size_t>* progress) {
+  auto prefabs = PrefabIndices(scene);
+  XmlWriter writer(path);
+  writer << "<?xml version=\"1.0\"?>\n<scene>\n";
+  for (const auto& prefab : scene.prefabs) {
+    writer << "\t<prefab name=\"";
+    writer.Escaped(prefab->name) << "\">\n";
+    WriteAttributes(writer, prefab->attributes);
+    writer << "\t</prefab>\n";
+  }
   for (const auto& object : scene.objects) {
-    auto object_node = root.append_child("object");
-    for (auto& [name, value] : object->attributes) {
-      auto attribute_node = object_node.append_child("attribute");
-      attribute_node.append_attribute("name") = name.c_str();
-      if (std::holds_alternative<int>(value)) {
-        attribute_node.append_attribute("type") = "int";
-        attribute_node.append_attribute("value") =
-            std::to_string(std::get<int>(value)).c_str();
-      } else if (std::holds_alternative<float>(value)) {
-        attribute_node.append_attribute("type") = "float";
-        attribute_node.append_attribute("value") =
-            std::to_string(std::get<float>(value)).c_str();
-      } else if (std::holds_alternative<glm::vec2>(value)) {
-        attribute_node.append_attribute("type") = "vec2";
-        auto vec = std::get<glm::vec2>(value);
-        attribute_node.append_attribute("value") =
-            std::to_string(vec.x) + "," + std::to_string(vec.y);
-      } else if (std::holds_alternative<glm::vec3>(value)) {
-        attribute_node.append_attribute("type") = "vec3";
-        auto vec = std::get<glm::vec3>(value);
-        attribute_node.append_attribute("value") =
-            (std::to_string(vec.x) + "," + std::to_string(vec.y) + "," +
-             std::to_string(vec.z))
-                .c_str();
-      } else if (std::holds_alternative<Texture>(value)) {
-        attribute_node.append_attribute("type") = "texture";
-        Texture texture = std::get<Texture>(value);
-        attribute_node.append_attribute("value") = texture.path.c_str();
+    writer << "\t<object";
+    if (!object->name.empty()) {
+      writer << " name=\"";
+      writer.Escaped(object->name) << "\"";
+    }
+    if (object->prefab) {
+      if (!prefabs.contains(object->prefab.get())) {
+        throw std::runtime_error("Prefab is not part of the scene: " +
+                                 object->prefab->name);
       }
+      writer << " prefab=\"";
+      writer.Escaped(object->prefab->name) << "\"";
+    }
+    writer << ">\n";
+    WriteAttributes(writer, object->attributes);
+    for (const auto& tag : object->tags) {
+      writer << "\t\t<tag name=\"";
+      writer.Escaped(tag) << "\" />\n";
+    }
+    writer << "\t</object>\n";
+    if (progress != nullptr) {
+      (*progress)++;
     }
-    for (auto& tag : object->tags) {
-      auto tag_node = object_node.append_child("tag");
-      tag_node.append_attribute("name") = tag.c_str();
+  }
+  writer << "</scene>\n";
+  writer.Flush();
+}
+}  // namespace
+
+std::unordered_map<const AttributeTemplate*, std::uint32_t> PrefabIndices(
+    const Scene& scene) {
+  std::unordered_map<const AttributeTemplate*, std::uint32_t> indices;
+  std::unordered_map<std::string_view, std::uint32_t> names;
+  for (std::uint32_t i = 0; i < scene.prefabs.size(); i++) {
+    if (!names.emplace(scene.prefabs[i]->name, i).second) {
+      throw std::runtime_error("Duplicate prefab: " + scene.prefabs[i]->name);
+    }
+    indices.emplace(scene.prefabs[i].get(), i);
+  }
+  return indices;
+}
+
+Scene LoadScene(std::string_view path, bool load_textures) {
+  auto scene = IsBinaryScene(path) ? LoadBinaryScene(path, load_textures)
+                                   : LoadXmlScene(path, load_textures);
+  ReplayJournal(path, scene, load_textures);
+  return scene;
+}
+
+void SaveScene(const Scene& scene, std::string_view path,
+               std::atomic<std::size_t>* progress) {
+  // Written next to the target and renamed over it, so a failed save never
+  // leaves a half-written scene behind.
+  auto temporary = std::string(path) + ".tmp";
+  try {
+    if (IsBinaryScene(path)) {
+      SaveBinaryScene(scene, temporary, progress);
+    } else {
+      SaveXmlScene(scene, temporary, progress);
     }
+    std::filesystem::rename(temporary, path);
+  } catch (...) {
+    std::error_code error;
+    std::filesystem::remove(temporary, error);
+    throw;
+  }
+}
+
+void ConvertScene(std::string_view from, std::string_view to) {
+  SaveScene(LoadScene(from, false), to);
+}
+
+void ReadSceneChunks(std::string_view path, glm::vec2 focus,
+                     std::size_t chunk_size,
+                     const std::function<bool(SceneChunk&&)>& sink) {
+  // The journal addresses objects by their index in the file, so a scene
+  // with one is read whole and replayed before any of it is handed out.
+  // Binary scenes are already near-zero parsing, so only the hand-off is
+  // chunked.
+  if (IsBinaryScene(path) || std::filesystem::exists(JournalPath(path))) {
+    auto scene = LoadScene(path, false);
+    auto order = NearestFirst(
+        scene.objects.size(), focus,
+        [&](std::size_t i) -> std::optional<glm::vec3> {
+          for (const auto& [name, value] : scene.objects[i]->attributes) {
+            if (name == "transform.position" &&
+                std::holds_alternative<glm::vec3>(value)) {
+              return std::get<glm::vec3>(value);
+            }
+          }
+          return std::nullopt;
+        });
+    EmitChunks(order, chunk_size, std::move(scene.prefabs),
+               [&](std::size_t i) { return std::move(scene.objects[i]); }, sink);
+    return;
+  }
+
+  MappedFile file(path, true);
+  pugi::xml_document doc;
+  if (!doc.load_buffer_inplace(file.MutableData(), file.Size())) {
+    throw std::runtime_error("Failed to load scene");
+  }
+  std::vector<pugi::xml_node> object_nodes;
+  for (auto object_node : doc.child("scene").children("object")) {
+    object_nodes.push_back(object_node);
   }
-  doc.save_file(path.data());
+  auto prefabs = ParsePrefabs(doc.child("scene"));
+  auto lookup = MakePrefabLookup(prefabs);
+  auto order = NearestFirst(
+      object_nodes.size(), focus,
+      [&](std::size_t i) -> std::optional<glm::vec3> {
+        auto value = attributes::ParseValue(
+            "vec3", object_nodes[i]
+                        .find_child_by_attribute("attribute", "name",
+                                                 "transform.position")
+                        .attribute("value")
+                        .as_string());
+        if (!value) {
+          return std::nullopt;
+        }
+        return std::get<glm::vec3>(*value);
+      });
+  EmitChunks(order, chunk_size, std::move(prefabs),
+             [&](std::size_t i) { return ParseObject(object_nodes[i], lookup); },
+             sink);
 }
@@ -0,0 +1,72 @@
+#include "scene_generator.h"
+
+#include <memory>
+#include <string>
+
+namespace {
+constexpr std::size_t kGridWidth = 1000;
+constexpr float kGridSpacing = 0.5F;
+constexpr std::size_t kLightEvery = 8;
+
+// SplitMix64. The standard distributions are implementation-defined, so the
+// mapping to floats is done here to keep scenes identical across toolchains.
+class Random {
+ public:
+  explicit Random(std::uint64_t seed) : state_(seed) {}
+
+  float Uniform(float min, float max) {
+    state_ += 0x9E3779B97F4A7C15ULL;
+    auto z = state_;
+    z = (z ^ (z >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27U)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31U;
+    // Top 24 bits give every float in [0, 1) the same weight
+    auto unit = static_cast<float>(z >> 40U) / static_cast<float>(1U << 24U);
+    return min + ((max - min) * unit);
+  }
+
+ private:
+  std::uint64_t state_;
+};
+}  // namespace
+
+Scene GenerateScene(std::size_t object_count, std::uint64_t seed) {
+  Random random(seed);
+  Scene scene;
+  scene.objects.reserve(object_count);
+  for (std::size_t i = 0; i < object_count; i++) {
+    auto object = std::make_shared<Object>();
+    object->name = "object " + std::to_string(i);
+    auto x = static_cast<float>(i % kGridWidth) * kGridSpacing;
+    auto y = static_cast<float>(i / kGridWidth) * kGridSpacing;
+    object->attributes.emplace_back("transform.position",
+                                    glm::vec3(x, y, 0.0F));
+    auto size = random.Uniform(0.5F, 2.0F);
+    object->attributes.emplace_back("transform.scale",
+                                    glm::vec3(size, size, 1.0F));
+    object->attributes.emplace_back("transform.rotation",
+                                    random.Uniform(0.0F, 360.0F));
+    if (i % kLightEvery == 0) {
+      object->attributes.emplace_back("light.type", 1);
+      object->attributes.emplace_back("light.intensity",
+                                      random.Uniform(0.2F, 1.0F));
+      object->attributes.emplace_back(
+          "light.color",
+          glm::vec3(random.Uniform(0.5F, 1.0F), random.Uniform(0.5F, 1.0F),
+                    random.Uniform(0.5F, 1.0F)));
+      object->attributes.emplace_back("light.radial_falloff", 1.0F);
+      object->attributes.emplace_back("light.volumetric_intensity", 1.0F);
+      object->tags.emplace_back("light");
+    } else {
+      object->attributes.emplace_back(
+          "texture.color",
+          Texture{.id = 0U, .path = InternTexturePath("assets/color.png")});
+      object->attributes.emplace_back(
+          "texture.normal",
+          Texture{.id = 0U, .path = InternTexturePath("assets/normal.png")});
+      object->tags.emplace_back("sprite");
+    }
+    scene.objects.push_back(std::move(object));
+  }
+  return scene;
+}
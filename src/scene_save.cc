@@ -0,0 +1,37 @@
+#include "scene_save.h"
+
+#include <stdexcept>
+#include <utility>
+
+SceneSave::SceneSave(Scene snapshot, std::string_view path)
+    : snapshot_(std::move(snapshot)),
+      path_(path),
+      total_(snapshot_.objects.size()),
+      worker_([this] {
+        try {
+          SaveScene(snapshot_, path_, &written_);
+        } catch (const std::exception& e) {
+          std::scoped_lock lock(mutex_);
+          error_ = e.what();
+        }
+        // Release the shared objects here rather than on the UI thread.
+        snapshot_.objects.clear();
+        finished_ = true;
+      }) {}
+
+float SceneSave::Progress() const {
+  return total_ == 0
+             ? 1.0F
+             : static_cast<float>(written_) / static_cast<float>(total_);
+}
+
+bool SceneSave::Poll() {
+  if (!finished_) {
+    return false;
+  }
+  std::scoped_lock lock(mutex_);
+  if (!error_.empty()) {
+    throw std::runtime_error(std::exchange(error_, ""));
+  }
+  return true;
+}
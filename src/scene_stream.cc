@@ -0,0 +1,87 @@
+#include "scene_stream.h"
+
+#include <stdexcept>
+#include <utility>
+
+#include "texture.h"
+
+namespace {
+constexpr std::size_t kChunkSize = 2048;
+}
+
+SceneStream::SceneStream(std::string_view path, glm::vec2 focus)
+    : path_(path),
+      worker_([this](const std::stop_token& stop, std::string path,
+                     glm::vec2 focus) { Read(stop, std::move(path), focus); },
+              std::string(path), focus) {}
+
+void SceneStream::Read(const std::stop_token& stop, std::string path,
+                       glm::vec2 focus) {
+  try {
+    ReadSceneChunks(path, focus, kChunkSize, [&](SceneChunk&& chunk) {
+      total_ = chunk.total;
+      std::scoped_lock lock(mutex_);
+      chunks_.push_back(std::move(chunk));
+      return !stop.stop_requested();
+    });
+  } catch (const std::exception& e) {
+    std::scoped_lock lock(mutex_);
+    error_ = e.what();
+  }
+  finished_ = true;
+}
+
+void SceneStream::Publish(Scene& scene, std::chrono::microseconds budget) {
+  auto deadline = std::chrono::steady_clock::now() + budget;
+  while (std::chrono::steady_clock::now() < deadline) {
+    SceneChunk chunk;
+    {
+      std::scoped_lock lock(mutex_);
+      if (chunks_.empty()) {
+        if (!error_.empty()) {
+          throw std::runtime_error(std::exchange(error_, ""));
+        }
+        break;
+      }
+      chunk = std::move(chunks_.front());
+      chunks_.pop_front();
+    }
+    for (auto& prefab : chunk.prefabs) {
+      LoadTextures(prefab->attributes);
+      scene.prefabs.push_back(std::move(prefab));
+    }
+    for (auto& object : chunk.objects) {
+      LoadTextures(object->attributes);
+      scene.objects.push_back(std::move(object));
+    }
+    file_order_.insert(file_order_.end(), chunk.indices.begin(),
+                       chunk.indices.end());
+  }
+}
+
+// Textures need the GL context, so they are loaded here rather than on the
+// worker, once per distinct path.
+void SceneStream::LoadTextures(
+    std::vector<std::pair<std::string, AttributeData>>& attributes) {
+  for (auto& [name, value] : attributes) {
+    if (auto* texture = std::get_if<Texture>(&value)) {
+      auto [it, inserted] = textures_.try_emplace(texture->path, 0U);
+      if (inserted) {
+        it->second = LoadTexture(texture->Path()).id;
+      }
+      texture->id = it->second;
+    }
+  }
+}
+
+float SceneStream::Progress() const {
+  auto total = total_.load();
+  return total == 0 ? 0.0F
+                    : static_cast<float>(file_order_.size()) / static_cast<float>(total);
+}
+
+bool SceneStream::Done() const {
+  std::scoped_lock lock(mutex_);
+  // An unreported error keeps the stream alive until Publish throws it.
+  return finished_ && chunks_.empty() && error_.empty();
+}
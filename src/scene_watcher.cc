@@ -0,0 +1,473 @@
+#include "scene_watcher.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "texture.h"
+
+namespace {
+// How often the watcher wakes to check for changes and stop requests
+constexpr auto kPollInterval = std::chrono::milliseconds(100);
+// Writes closer together than this are reloaded once
+constexpr auto kSettleTime = std::chrono::milliseconds(150);
+// Above this fraction of objects added, removed or changed, the simulation
+// gets the whole scene again rather than a command per object
+constexpr std::size_t kResetFraction = 4;
+
+struct Identity {
+  std::string_view name;
+  std::size_t occurrence;
+  bool operator==(const Identity&) const = default;
+};
+
+struct IdentityHash {
+  std::size_t operator()(const Identity& identity) const {
+    return std::hash<std::string_view>{}(identity.name) ^
+           (identity.occurrence * 0x9E3779B97F4A7C15ULL);
+  }
+};
+
+std::vector<Identity> Identities(const Scene& scene) {
+  std::vector<Identity> identities;
+  identities.reserve(scene.objects.size());
+  std::unordered_map<std::string_view, std::size_t> counts;
+  for (const auto& object : scene.objects) {
+    identities.push_back({object->name, counts[object->name]++});
+  }
+  return identities;
+}
+
+bool SameValue(const AttributeData& a, const AttributeData& b) {
+  if (a.index() != b.index()) {
+    return false;
+  }
+  return std::visit(
+      [&](const auto& value) {
+        using T = std::decay_t<decltype(value)>;
+        const auto& other = std::get<T>(b);
+        if constexpr (std::is_same_v<T, Texture>) {
+          return value.path == other.path;
+        } else {
+          return value == other;
+        }
+      },
+      a);
+}
+
+bool SameAttributes(
+    const std::vector<std::pair<std::string, AttributeData>>& a,
+    const std::vector<std::pair<std::string, AttributeData>>& b) {
+  return std::ranges::equal(a, b, [](const auto& first, const auto& second) {
+    return first.first == second.first && SameValue(first.second, second.second);
+  });
+}
+
+bool SameObject(const Object& a, const Object& b) {
+  if (a.name != b.name || a.tags != b.tags ||
+      !SameAttributes(a.attributes, b.attributes) ||
+      (a.prefab == nullptr) != (b.prefab == nullptr)) {
+    return false;
+  }
+  return a.prefab == nullptr || a.prefab->name == b.prefab->name;
+}
+
+// Whether a diff made against `base` still holds for `live`: the objects are
+// the same, or copies (see Detach) that no edit has changed since
+bool SameObjects(const std::vector<std::shared_ptr<Object>>& base,
+                 const std::vector<std::shared_ptr<Object>>& live) {
+  return std::ranges::equal(base, live, [](const auto& a, const auto& b) {
+    return a == b || SameObject(*a, *b);
+  });
+}
+}  // namespace
+
+SceneWatcher::SceneWatcher(std::string_view path)
+    : path_(path),
+      ignored_(FileStamp(path_)),
+      worker_([this](const std::stop_token& stop) { Watch(stop); }) {}
+
+SceneWatcher::Stamp SceneWatcher::FileStamp(const std::string& path) {
+  std::error_code error;
+  auto size = std::filesystem::file_size(path, error);
+  if (error) {
+    return {.size = 0, .modified = 0};
+  }
+  auto modified = std::filesystem::last_write_time(path, error);
+  return {.size = size,
+          .modified = error ? 0 : modified.time_since_epoch().count()};
+}
+
+void SceneWatcher::Watch(const std::stop_token& stop) {
+  std::filesystem::path path(path_);
+  auto file_name = path.filename().string();
+  auto directory = path.parent_path();
+  if (directory.empty()) {
+    directory = ".";
+  }
+  // Without inotify, or if it cannot watch the directory, the file's stamp
+  // is polled instead
+  int descriptor = -1;
+#ifdef __linux__
+  descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (descriptor >= 0 &&
+      inotify_add_watch(descriptor, directory.c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    close(descriptor);
+    descriptor = -1;
+  }
+#endif
+  auto seen = FileStamp(path_);
+  bool pending = false;
+  auto last_change = std::chrono::steady_clock::now();
+  while (!stop.stop_requested()) {
+    bool changed = false;
+#ifdef __linux__
+    if (descriptor >= 0) {
+      pollfd request{.fd = descriptor, .events = POLLIN, .revents = 0};
+      if (poll(&request, 1, static_cast<int>(kPollInterval.count())) > 0) {
+        alignas(inotify_event) std::array<char, 4096> events;
+        ssize_t length;
+        while ((length = read(descriptor, events.data(), events.size())) > 0) {
+          for (ssize_t offset = 0; offset < length;) {
+            const auto* event =
+                reinterpret_cast<const inotify_event*>(events.data() + offset);
+            changed |= event->len > 0 && file_name == event->name;
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+          }
+        }
+      }
+    }
+#endif
+    if (descriptor < 0) {
+      std::this_thread::sleep_for(kPollInterval);
+      auto stamp = FileStamp(path_);
+      changed = stamp != seen;
+      seen = stamp;
+    }
+    if (changed) {
+      pending = true;
+      last_change = std::chrono::steady_clock::now();
+    } else if (pending &&
+               std::chrono::steady_clock::now() - last_change >= kSettleTime) {
+      pending = false;
+      Load(stop);
+    }
+  }
+#ifdef __linux__
+  if (descriptor >= 0) {
+    close(descriptor);
+  }
+#endif
+}
+
+// Changes made to the file meanwhile wait in the inotify queue, and are
+// loaded next.
+void SceneWatcher::Load(const std::stop_token& stop) {
+  auto stamp = FileStamp(path_);
+  {
+    std::scoped_lock lock(mutex_);
+    if (stamp == ignored_) {
+      return;
+    }
+  }
+  Scene file;
+  try {
+    file = LoadScene(path_, false);
+  } catch (const std::exception& e) {
+    std::scoped_lock lock(mutex_);
+    error_ = e.what();
+    return;
+  }
+  while (true) {
+    Scene snapshot;
+    {
+      std::unique_lock lock(mutex_);
+      state_ = State::kWaitingForSnapshot;
+      if (!changed_.wait(lock, stop, [&] { return snapshot_.has_value(); })) {
+        return;
+      }
+      snapshot = std::move(*snapshot_);
+      snapshot_.reset();
+      state_ = State::kDiffing;
+    }
+    // The editor detaches objects before changing them, so the snapshot's
+    // stay as they are while they are read
+    auto diff = DiffScenes(snapshot, file);
+    std::unique_lock lock(mutex_);
+    reload_ = Reload{.file = std::move(file), .diff = std::move(diff)};
+    reload_stamp_ = stamp;
+    base_ = std::move(snapshot.objects);
+    state_ = State::kReady;
+    if (!changed_.wait(lock, stop,
+                       [&] { return state_ != State::kReady; }) ||
+        state_ != State::kStale) {
+      return;
+    }
+    file = std::move(reload_->file);
+    reload_.reset();
+  }
+}
+
+std::optional<SceneWatcher::Reload> SceneWatcher::Poll(const Scene& live) {
+  std::scoped_lock lock(mutex_);
+  if (!error_.empty()) {
+    throw std::runtime_error(std::exchange(error_, ""));
+  }
+  if (state_ == State::kWaitingForSnapshot && !snapshot_) {
+    // Shares the objects, which is cheap
+    snapshot_ = live;
+    changed_.notify_all();
+    return std::nullopt;
+  }
+  if (state_ != State::kReady) {
+    return std::nullopt;
+  }
+  std::optional<Reload> reload;
+  if (reload_stamp_ != ignored_ && !SameObjects(base_, live.objects)) {
+    // Diffed again against the scene as it is now, keeping the parsed file
+    state_ = State::kStale;
+    snapshot_ = live;
+  } else {
+    if (reload_stamp_ != ignored_) {
+      reload = std::move(reload_);
+    }
+    reload_.reset();
+    state_ = State::kIdle;
+  }
+  base_.clear();
+  changed_.notify_all();
+  return reload;
+}
+
+void SceneWatcher::Ignore() {
+  auto stamp = FileStamp(path_);
+  std::scoped_lock lock(mutex_);
+  ignored_ = stamp;
+}
+
+SceneDiff DiffScenes(const Scene& live, const Scene& file) {
+  SceneDiff diff;
+  // Usually only values changed, and every object is where it was
+  diff.sources.resize(file.objects.size());
+  if (std::ranges::equal(live.objects, file.objects,
+                         [](const auto& a, const auto& b) {
+                           return a->name == b->name;
+                         })) {
+    for (std::size_t i = 0; i < file.objects.size(); i++) {
+      diff.sources[i] = i;
+    }
+  } else {
+    auto file_identities = Identities(file);
+    std::unordered_map<Identity, std::size_t, IdentityHash> file_index;
+    file_index.reserve(file_identities.size());
+    for (std::size_t i = 0; i < file_identities.size(); i++) {
+      file_index.emplace(file_identities[i], i);
+    }
+    std::ranges::fill(diff.sources, SceneDiff::kNew);
+    auto live_identities = Identities(live);
+    for (std::size_t i = 0; i < live_identities.size(); i++) {
+      auto it = file_index.find(live_identities[i]);
+      if (it == file_index.end()) {
+        diff.removed.push_back(i);
+      } else {
+        diff.sources[it->second] = i;
+      }
+    }
+  }
+
+  std::size_t last_source = 0;
+  bool first = true;
+  for (std::size_t i = 0; i < file.objects.size(); i++) {
+    auto source = diff.sources[i];
+    if (source == SceneDiff::kNew) {
+      diff.added++;
+      continue;
+    }
+    diff.reordered |= !first && source < last_source;
+    last_source = source;
+    first = false;
+    if (!SameObject(*live.objects[source], *file.objects[i])) {
+      diff.changed.push_back(i);
+    }
+  }
+  return diff;
+}
+
+void ApplySceneDiff(Scene& live, Scene& file, const SceneDiff& diff,
+                    Simulation& simulation) {
+  std::unordered_map<std::string_view, std::size_t> live_prefabs;
+  for (std::size_t i = 0; i < live.prefabs.size(); i++) {
+    live_prefabs.emplace(live.prefabs[i]->name, i);
+  }
+  std::vector<bool> prefab_changed(file.prefabs.size());
+  for (std::size_t i = 0; i < file.prefabs.size(); i++) {
+    auto it = live_prefabs.find(file.prefabs[i]->name);
+    prefab_changed[i] = it == live_prefabs.end() ||
+                        !SameAttributes(live.prefabs[it->second]->attributes,
+                                        file.prefabs[i]->attributes);
+  }
+  if (diff.Empty() && std::ranges::none_of(prefab_changed, std::identity())) {
+    return;
+  }
+
+  // Texture ids by path handle, for the paths the file's new and changed
+  // objects and prefabs use: the live scene's where it has them, which are
+  // looked for until all are found, otherwise loaded
+  std::unordered_map<std::uint32_t, std::optional<unsigned int>> textures;
+  auto need = [&](const auto& attributes) {
+    for (const auto& [name, value] : attributes) {
+      if (const auto* texture = std::get_if<Texture>(&value)) {
+        textures.try_emplace(texture->path);
+      }
+    }
+  };
+  for (std::size_t i = 0; i < file.prefabs.size(); i++) {
+    if (prefab_changed[i]) {
+      need(file.prefabs[i]->attributes);
+    }
+  }
+  for (std::size_t i = 0; i < file.objects.size(); i++) {
+    if (diff.sources[i] == SceneDiff::kNew) {
+      need(file.objects[i]->attributes);
+    }
+  }
+  for (auto i : diff.changed) {
+    need(file.objects[i]->attributes);
+  }
+  auto missing = textures.size();
+  auto find = [&](const auto& attributes) {
+    for (const auto& [name, value] : attributes) {
+      const auto* texture = std::get_if<Texture>(&value);
+      if (texture == nullptr) {
+        continue;
+      }
+      auto it = textures.find(texture->path);
+      if (it != textures.end() && !it->second) {
+        it->second = texture->id;
+        missing--;
+      }
+    }
+  };
+  for (const auto& prefab : live.prefabs) {
+    if (missing == 0) {
+      break;
+    }
+    find(prefab->attributes);
+  }
+  for (const auto& object : live.objects) {
+    if (missing == 0) {
+      break;
+    }
+    find(object->attributes);
+  }
+  auto load = [&](auto& attributes) {
+    for (auto& [name, value] : attributes) {
+      if (auto* texture = std::get_if<Texture>(&value)) {
+        auto& id = textures[texture->path];
+        if (!id) {
+          id = LoadTexture(texture->Path()).id;
+        }
+        texture->id = *id;
+      }
+    }
+  };
+
+  // The file's prefabs, as the live ones objects must point at
+  std::unordered_map<const AttributeTemplate*,
+                     std::shared_ptr<AttributeTemplate>>
+      prefabs;
+  for (std::size_t i = 0; i < file.prefabs.size(); i++) {
+    auto& prefab = file.prefabs[i];
+    auto it = live_prefabs.find(prefab->name);
+    if (prefab_changed[i]) {
+      load(prefab->attributes);
+      if (it == live_prefabs.end()) {
+        live.prefabs.push_back(prefab);
+        it = live_prefabs.emplace(prefab->name, live.prefabs.size() - 1).first;
+      } else {
+        DetachPrefab(live, it->second).attributes =
+            std::move(prefab->attributes);
+      }
+      simulation.SetPrefab(live, it->second);
+    }
+    prefabs.emplace(prefab.get(), live.prefabs[it->second]);
+  }
+  auto take = [&](std::size_t index) {
+    auto& object = file.objects[index];
+    load(object->attributes);
+    if (object->prefab) {
+      object->prefab = prefabs.at(object->prefab.get());
+    }
+    return std::move(object);
+  };
+
+  auto edits = diff.removed.size() + diff.added + diff.changed.size();
+  bool reset =
+      diff.reordered || edits * kResetFraction > file.objects.size();
+  if (diff.removed.empty() && diff.added == 0 && !diff.reordered) {
+    // Every object is where it was
+    for (auto index : diff.changed) {
+      live.objects[index] = take(index);
+      if (!reset) {
+        simulation.SetObject(live, index);
+      }
+    }
+    if (reset) {
+      simulation.Reset(live);
+    }
+    return;
+  }
+  std::vector<std::shared_ptr<Object>> objects;
+  objects.reserve(file.objects.size());
+  auto changed = diff.changed.begin();
+  for (std::size_t i = 0; i < file.objects.size(); i++) {
+    auto source = diff.sources[i];
+    bool is_changed = changed != diff.changed.end() && *changed == i;
+    if (is_changed) {
+      changed++;
+    }
+    objects.push_back(source != SceneDiff::kNew && !is_changed
+                          ? std::move(live.objects[source])
+                          : take(i));
+  }
+  live.objects = std::move(objects);
+
+  if (reset) {
+    simulation.Reset(live);
+    return;
+  }
+  // Erased last first, so the indices before stay valid; then inserted first
+  // first, at their final indices, which the objects before already have
+  for (auto removed = diff.removed.rbegin(); removed != diff.removed.rend();
+       removed++) {
+    simulation.EraseObject(*removed);
+  }
+  for (std::size_t i = 0; i < diff.sources.size();) {
+    if (diff.sources[i] != SceneDiff::kNew) {
+      i++;
+      continue;
+    }
+    auto first = i;
+    while (i < diff.sources.size() && diff.sources[i] == SceneDiff::kNew) {
+      i++;
+    }
+    simulation.InsertObjects(live, first, i - first);
+  }
+  for (auto index : diff.changed) {
+    simulation.SetObject(live, index);
+  }
+}
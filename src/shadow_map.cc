@@ -0,0 +1,153 @@
+#include "shadow_map.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+
+namespace {
+constexpr float kTwoPi = 2.0F * std::numbers::pi_v<float>;
+constexpr std::array<glm::vec2, 4> kUnitQuad = {
+    glm::vec2(-0.5F, -0.5F), glm::vec2(0.5F, -0.5F), glm::vec2(0.5F, 0.5F),
+    glm::vec2(-0.5F, 0.5F)};
+
+// Occluders further away cannot shadow anything the light reaches
+float Reach(const LightProxy& light) {
+  return std::min(LightReach(light), ShadowMaps::kNoOccluder);
+}
+
+void Combine(std::size_t& hash, float value) {
+  hash ^= std::bit_cast<std::uint32_t>(value) + 0x9E3779B9U + (hash << 6U) +
+          (hash >> 2U);
+}
+
+float Angle(glm::vec2 direction) {
+  return std::atan2(direction.y, direction.x);
+}
+
+// Writes the distance along each direction from the light (at the origin) to
+// the segment from `a` to `b`, where nearer than what the row holds.
+void Trace(glm::vec2 a, glm::vec2 b, std::span<float> row) {
+  auto resolution = static_cast<float>(row.size());
+  float start = Angle(a);
+  float sweep = Angle(b) - start;
+  if (sweep > std::numbers::pi_v<float>) {
+    sweep -= kTwoPi;
+  } else if (sweep < -std::numbers::pi_v<float>) {
+    sweep += kTwoPi;
+  }
+  if (sweep < 0.0F) {
+    start += sweep;
+    sweep = -sweep;
+  }
+  // Direction k points at the angle of texel k's centre
+  auto texel = [&](float angle) {
+    return (angle + std::numbers::pi_v<float>) / kTwoPi * resolution - 0.5F;
+  };
+  auto first = static_cast<long>(std::ceil(texel(start)));
+  auto last = static_cast<long>(std::floor(texel(start + sweep)));
+  glm::vec2 edge = b - a;
+  for (auto k = first; k <= last; k++) {
+    float angle = (static_cast<float>(k) + 0.5F) / resolution * kTwoPi -
+                  std::numbers::pi_v<float>;
+    glm::vec2 direction(std::cos(angle), std::sin(angle));
+    float denominator = direction.x * edge.y - direction.y * edge.x;
+    if (std::abs(denominator) < 1e-8F) {
+      continue;
+    }
+    float distance = (a.x * edge.y - a.y * edge.x) / denominator;
+    auto& texel_distance =
+        row[static_cast<std::size_t>((k % static_cast<long>(row.size()) +
+                                      static_cast<long>(row.size())) %
+                                     static_cast<long>(row.size()))];
+    if (distance >= 0.0F) {
+      texel_distance = std::min(texel_distance, distance);
+    }
+  }
+}
+}  // namespace
+
+ShadowMaps::ShadowMaps(std::size_t refresh_limit)
+    : refresh_limit_(refresh_limit),
+      atlas_(kMaxLights * kResolution, kNoOccluder) {}
+
+bool ShadowMaps::Update(std::span<const LightProxy> lights,
+                        std::span<const OccluderProxy> occluders,
+                        const glm::mat4& view_projection) {
+  quads_.clear();
+  for (const auto& occluder : occluders) {
+    Quad quad{};
+    auto transform = view_projection * occluder.model;
+    for (std::size_t c = 0; c < kUnitQuad.size(); c++) {
+      auto clip = transform * glm::vec4(kUnitQuad[c], 0.0F, 1.0F);
+      quad.corners[c] = glm::vec2(clip) / clip.w * 0.5F + 0.5F;
+    }
+    quad.min = glm::min(glm::min(quad.corners[0], quad.corners[1]),
+                        glm::min(quad.corners[2], quad.corners[3]));
+    quad.max = glm::max(glm::max(quad.corners[0], quad.corners[1]),
+                        glm::max(quad.corners[2], quad.corners[3]));
+    quads_.push_back(quad);
+  }
+
+  rows_.resize(std::min(lights.size(), kMaxLights));
+  std::size_t refreshed = 0;
+  for (std::size_t n = 0; n < rows_.size(); n++) {
+    auto index = (next_ + n) % rows_.size();
+    const auto& light = lights[index];
+    if (light.type != 1) {
+      continue;
+    }
+    auto signature = Signature(light);
+    auto& row = rows_[index];
+    if (row.drawn && row.signature == signature) {
+      continue;
+    }
+    if (refreshed == refresh_limit_) {
+      next_ = index;
+      return refreshed > 0;
+    }
+    Draw(index, light);
+    row = {.signature = signature, .drawn = true};
+    refreshed++;
+  }
+  return refreshed > 0;
+}
+
+std::size_t ShadowMaps::Signature(const LightProxy& light) const {
+  std::size_t hash = 0;
+  Combine(hash, light.position.x);
+  Combine(hash, light.position.y);
+  Combine(hash, light.intensity);
+  Combine(hash, light.falloff);
+  glm::vec2 center(light.position);
+  float reach = Reach(light);
+  for (const auto& quad : quads_) {
+    auto nearest = glm::clamp(center, quad.min, quad.max);
+    if (glm::length(nearest - center) > reach) {
+      continue;
+    }
+    for (auto corner : quad.corners) {
+      Combine(hash, corner.x);
+      Combine(hash, corner.y);
+    }
+  }
+  return hash;
+}
+
+void ShadowMaps::Draw(std::size_t row, const LightProxy& light) {
+  std::span<float> distances(atlas_.data() + (row * kResolution), kResolution);
+  std::ranges::fill(distances, kNoOccluder);
+  glm::vec2 center(light.position);
+  float reach = Reach(light);
+  for (const auto& quad : quads_) {
+    auto nearest = glm::clamp(center, quad.min, quad.max);
+    if (glm::length(nearest - center) > reach) {
+      continue;
+    }
+    for (std::size_t c = 0; c < quad.corners.size(); c++) {
+      Trace(quad.corners[c] - center,
+            quad.corners[(c + 1) % quad.corners.size()] - center, distances);
+    }
+  }
+}
@@ -0,0 +1,180 @@
+#include "simulation.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "memory_report.h"
+
+namespace {
+// Ticks further behind than this are dropped rather than caught up on
+constexpr int kMaxLateTicks = 4;
+}  // namespace
+
+Simulation::Simulation(std::chrono::nanoseconds timestep)
+    : timestep_(timestep),
+      worker_([this](const std::stop_token& stop) { Run(stop); }) {}
+
+void Simulation::Reset(const Scene& scene) {
+  // A snapshot: only the object and prefab pointers are copied
+  Push(ResetCommand{.scene = scene});
+}
+
+void Simulation::SetObject(const Scene& scene, std::size_t index) {
+  Push(SetObjectCommand{.index = index, .object = scene.objects[index]});
+}
+
+void Simulation::InsertObjects(const Scene& scene, std::size_t first,
+                               std::size_t count) {
+  if (count == 0) {
+    return;
+  }
+  auto begin = scene.objects.begin() + static_cast<std::ptrdiff_t>(first);
+  Push(InsertCommand{
+      .first = first,
+      .objects = {begin, begin + static_cast<std::ptrdiff_t>(count)}});
+}
+
+void Simulation::EraseObject(std::size_t index) {
+  Push(EraseCommand{.index = index});
+}
+
+void Simulation::Reorder(std::vector<std::size_t> positions) {
+  Push(ReorderCommand{.positions = std::move(positions)});
+}
+
+void Simulation::SetPrefab(const Scene& scene, std::size_t index) {
+  SetPrefabCommand command{.index = index, .prefab = scene.prefabs[index],
+                           .users = {}};
+  for (std::size_t i = 0; i < scene.objects.size(); i++) {
+    if (scene.objects[i]->prefab == command.prefab) {
+      command.users.emplace_back(i, scene.objects[i]);
+    }
+  }
+  Push(std::move(command));
+}
+
+const RenderState& Simulation::Acquire() {
+  if ((shared_.load(std::memory_order_relaxed) & kFresh) != 0) {
+    front_ = shared_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+  }
+  return states_[front_];
+}
+
+void Simulation::Push(Command command) {
+  // Only ever held to append or to take the whole queue
+  std::scoped_lock lock(mutex_);
+  commands_.push_back(std::move(command));
+}
+
+void Simulation::Run(const std::stop_token& stop) {
+  auto next = std::chrono::steady_clock::now();
+  std::vector<Command> commands;
+  while (!stop.stop_requested()) {
+    {
+      std::scoped_lock lock(mutex_);
+      commands.swap(commands_);
+    }
+    for (auto& command : commands) {
+      Apply(command);
+    }
+    if (!commands.empty()) {
+      proxies_.Sync(scene_);
+      Publish();
+      MeasureMemory();
+    }
+    commands.clear();
+
+    next += timestep_;
+    auto now = std::chrono::steady_clock::now();
+    if (now - next > kMaxLateTicks * timestep_) {
+      next = now;
+    }
+    std::this_thread::sleep_until(next);
+  }
+}
+
+void Simulation::Apply(Command& command) {
+  auto& objects = scene_.objects;
+  auto& prefabs = scene_.prefabs;
+  // Replaced and inserted objects are new to the proxies, which recompile
+  // them on Sync. So are a prefab's users, which DetachPrefab replaced.
+  if (auto* reset = std::get_if<ResetCommand>(&command)) {
+    scene_ = std::move(reset->scene);
+  } else if (auto* insert = std::get_if<InsertCommand>(&command)) {
+    auto first = std::min(insert->first, objects.size());
+    objects.insert(objects.begin() + static_cast<std::ptrdiff_t>(first),
+                   std::make_move_iterator(insert->objects.begin()),
+                   std::make_move_iterator(insert->objects.end()));
+  } else if (auto* set = std::get_if<SetObjectCommand>(&command)) {
+    if (set->index < objects.size()) {
+      objects[set->index] = std::move(set->object);
+    }
+  } else if (auto* erase = std::get_if<EraseCommand>(&command)) {
+    if (erase->index < objects.size()) {
+      objects.erase(objects.begin() + static_cast<std::ptrdiff_t>(erase->index));
+    }
+  } else if (auto* reorder = std::get_if<ReorderCommand>(&command)) {
+    if (reorder->positions.size() == objects.size()) {
+      ReorderObjects(objects, reorder->positions);
+      proxies_.TouchOrder();
+    }
+  } else if (auto* prefab = std::get_if<SetPrefabCommand>(&command)) {
+    if (prefab->index < prefabs.size()) {
+      prefabs[prefab->index] = std::move(prefab->prefab);
+    } else {
+      prefabs.push_back(std::move(prefab->prefab));
+    }
+    // Users the editor has streamed in but not inserted yet come with the
+    // insert
+    for (auto& [index, user] : prefab->users) {
+      if (index < objects.size()) {
+        objects[index] = std::move(user);
+      }
+    }
+  }
+}
+
+void Simulation::Publish() {
+  for (auto& stale : stale_) {
+    stale.Merge(proxies_.LastChanges());
+  }
+  auto& state = states_[back_];
+  auto& stale = stale_[back_];
+  auto update = [](auto& target, auto source, RenderProxies::Range range) {
+    target.resize(source.size());
+    range.end = std::min(range.end, source.size());
+    if (!range.Empty()) {
+      std::copy(source.begin() + static_cast<std::ptrdiff_t>(range.begin),
+                source.begin() + static_cast<std::ptrdiff_t>(range.end),
+                target.begin() + static_cast<std::ptrdiff_t>(range.begin));
+    }
+  };
+  update(state.sprites, proxies_.Sprites(), stale.sprites);
+  update(state.lights, proxies_.Lights(), stale.lights);
+  update(state.occluders, proxies_.Occluders(), stale.occluders);
+  update(state.emitters, proxies_.Emitters(), stale.emitters);
+  stale = {};
+  back_ = shared_.exchange(back_ | kFresh, std::memory_order_acq_rel) &
+          kIndexMask;
+}
+
+void Simulation::MeasureMemory() {
+  std::size_t bytes =
+      scene_.objects.capacity() * sizeof(scene_.objects.front()) +
+      scene_.prefabs.capacity() * sizeof(scene_.prefabs.front());
+  for (const auto& object : scene_.objects) {
+    // Already replaced or erased by an edit whose command is still queued
+    if (object.use_count() == 1) {
+      bytes += ObjectBytes(*object);
+    }
+  }
+  bytes += proxies_.MemoryBytes();
+  for (const auto& state : states_) {
+    bytes += state.sprites.capacity() * sizeof(SpriteProxy) +
+             state.lights.capacity() * sizeof(LightProxy) +
+             state.occluders.capacity() * sizeof(OccluderProxy) +
+             state.emitters.capacity() * sizeof(EmitterProxy);
+  }
+  memory_bytes_.store(bytes, std::memory_order_relaxed);
+}
@@ -0,0 +1,250 @@
+#include "static_batch.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "helpers.h"
+
+namespace {
+// The sprite quad's two triangles, as corner and texture coordinate, in the
+// vertex layout of the sprite vertex array
+constexpr std::array<glm::vec2, 6> kCorners = {
+    glm::vec2(0.5F, 0.5F),   glm::vec2(0.5F, -0.5F), glm::vec2(-0.5F, 0.5F),
+    glm::vec2(0.5F, -0.5F),  glm::vec2(-0.5F, -0.5F), glm::vec2(-0.5F, 0.5F)};
+// Position, texture coordinates, animation (as the constant attributes
+// Renderer gives unbatched sprites) and atlas rectangle
+constexpr int kVertexFloats = 15;
+
+std::uint64_t ChunkKey(const SpriteProxy& sprite) {
+  auto cell = [](float coordinate) {
+    return static_cast<std::uint32_t>(static_cast<std::int32_t>(
+        std::floor(coordinate / StaticBatches::kChunkSize)));
+  };
+  return (std::uint64_t{cell(sprite.model[3].x)} << 32U) |
+         cell(sprite.model[3].y);
+}
+
+bool SameTile(const SpriteProxy& a, const SpriteProxy& b) {
+  return a.model == b.model && a.color_texture == b.color_texture &&
+         a.normal_texture == b.normal_texture && a.animation == b.animation;
+}
+}  // namespace
+
+StaticBatches::~StaticBatches() { Clear(); }
+
+void StaticBatches::Clear() {
+  for (auto& [key, chunk] : chunks_) {
+    Release(chunk);
+  }
+  chunks_.clear();
+  stats_ = {};
+}
+
+void StaticBatches::Update(std::span<const SpriteProxy> sprites,
+                           const TextureAtlas* atlas) {
+  auto atlas_generation = atlas != nullptr ? atlas->Generation() + 1 : 0;
+  for (auto& [key, chunk] : chunks_) {
+    chunk.incoming.clear();
+  }
+  for (const auto& sprite : sprites) {
+    if (Batched(sprite)) {
+      chunks_[ChunkKey(sprite)].incoming.push_back(sprite);
+    }
+  }
+  stats_.rebuilt = 0;
+  stats_.sprites = 0;
+  for (auto chunk = chunks_.begin(); chunk != chunks_.end();) {
+    auto& [key, current] = *chunk;
+    if (current.incoming.empty()) {
+      Release(current);
+      chunk = chunks_.erase(chunk);
+      continue;
+    }
+    if (!std::ranges::equal(current.sprites, current.incoming, SameTile) ||
+        current.atlas_generation != atlas_generation) {
+      current.sprites.swap(current.incoming);
+      current.atlas_generation = atlas_generation;
+      Build(current, atlas);
+      stats_.rebuilt++;
+    }
+    stats_.sprites += current.sprites.size();
+    chunk++;
+  }
+  stats_.chunks = chunks_.size();
+}
+
+void StaticBatches::Build(Chunk& chunk, const TextureAtlas* atlas) {
+  entries_.clear();
+  for (const auto& sprite : chunk.sprites) {
+    entries_.push_back(
+        atlas != nullptr
+            ? atlas->Find(sprite.color_texture, sprite.normal_texture)
+            : nullptr);
+  }
+  auto layer = [&](std::uint32_t index) {
+    return entries_[index] != nullptr ? entries_[index]->layer : -1;
+  };
+  // Packed sprites by page, the rest by textures, and of sprites on the same
+  // layer, later first: drawn with GL_LESS, the first one drawn stays on
+  // top, as with unbatched sprites
+  order_.resize(chunk.sprites.size());
+  std::iota(order_.begin(), order_.end(), 0U);
+  std::ranges::sort(order_, [&](std::uint32_t a, std::uint32_t b) {
+    if (layer(a) != layer(b)) {
+      return layer(a) < layer(b);
+    }
+    if (layer(a) >= 0) {
+      return a > b;
+    }
+    const auto& first = chunk.sprites[a];
+    const auto& second = chunk.sprites[b];
+    if (first.color_texture != second.color_texture) {
+      return first.color_texture < second.color_texture;
+    }
+    if (first.normal_texture != second.normal_texture) {
+      return first.normal_texture < second.normal_texture;
+    }
+    return a > b;
+  });
+
+  vertices_.clear();
+  chunk.groups.clear();
+  chunk.low = glm::vec3(INFINITY);
+  chunk.high = glm::vec3(-INFINITY);
+  for (auto index : order_) {
+    const auto& sprite = chunk.sprites[index];
+    const auto* entry = entries_[index];
+    bool same_group =
+        !chunk.groups.empty() && chunk.groups.back().layer == layer(index) &&
+        (entry != nullptr ||
+         (chunk.groups.back().color_texture == sprite.color_texture &&
+          chunk.groups.back().normal_texture == sprite.normal_texture));
+    if (!same_group) {
+      chunk.groups.push_back(
+          {.layer = layer(index),
+           .color_texture = sprite.color_texture,
+           .normal_texture = sprite.normal_texture,
+           .first_vertex =
+               static_cast<int>(vertices_.size() / kVertexFloats),
+           .vertex_count = 0});
+    }
+    const auto& animation = sprite.animation;
+    auto rect = entry != nullptr ? entry->rect
+                                 : glm::vec4(0.0F, 0.0F, 1.0F, 1.0F);
+    for (auto corner : kCorners) {
+      glm::vec3 position(sprite.model * glm::vec4(corner, 0.0F, 1.0F));
+      auto coordinates = corner + 0.5F;
+      vertices_.insert(
+          vertices_.end(),
+          {position.x, position.y, position.z, coordinates.x, coordinates.y,
+           animation.grid.x, animation.grid.y, animation.frames,
+           animation.rate, static_cast<float>(animation.mode),
+           animation.start, rect.x, rect.y, rect.z, rect.w});
+      chunk.low = glm::min(chunk.low, position);
+      chunk.high = glm::max(chunk.high, position);
+    }
+    chunk.groups.back().vertex_count += static_cast<int>(kCorners.size());
+  }
+
+  if (chunk.vertex_array == 0) {
+    glGenVertexArrays(1, &chunk.vertex_array);
+    glGenBuffers(1, &chunk.vertex_buffer);
+    glBindVertexArray(chunk.vertex_array);
+    glBindBuffer(GL_ARRAY_BUFFER, chunk.vertex_buffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
+                          kVertexFloats * sizeof(float), nullptr);
+    glEnableVertexAttribArray(0);
+    // Texture coordinates, animation, timing and atlas rectangle
+    constexpr std::array<std::pair<int, int>, 4> kAttributes = {
+        {{2, 3}, {4, 5}, {2, 9}, {4, 11}}};
+    for (int i = 0; i < static_cast<int>(kAttributes.size()); i++) {
+      auto [size, offset] = kAttributes[i];
+      glVertexAttribPointer(i + 1, size, GL_FLOAT, GL_FALSE,
+                            kVertexFloats * sizeof(float),
+                            reinterpret_cast<void*>(offset * sizeof(float)));
+      glEnableVertexAttribArray(i + 1);
+    }
+    glBindVertexArray(0);
+  }
+  auto bytes = vertices_.size() * sizeof(float);
+  glBindBuffer(GL_ARRAY_BUFFER, chunk.vertex_buffer);
+  glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(bytes),
+               vertices_.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  buffer_bytes[chunk.vertex_buffer] = bytes;
+}
+
+void StaticBatches::Release(Chunk& chunk) {
+  if (chunk.vertex_array == 0) {
+    return;
+  }
+  buffer_bytes.erase(chunk.vertex_buffer);
+  glDeleteVertexArrays(1, &chunk.vertex_array);
+  glDeleteBuffers(1, &chunk.vertex_buffer);
+  chunk.vertex_array = 0;
+  chunk.vertex_buffer = 0;
+}
+
+bool StaticBatches::Visible(const Chunk& chunk,
+                            const glm::mat4& view_projection) const {
+  glm::vec2 low(INFINITY);
+  glm::vec2 high(-INFINITY);
+  for (int corner = 0; corner < 8; corner++) {
+    glm::vec3 point((corner & 1) != 0 ? chunk.high.x : chunk.low.x,
+                    (corner & 2) != 0 ? chunk.high.y : chunk.low.y,
+                    (corner & 4) != 0 ? chunk.high.z : chunk.low.z);
+    glm::vec2 ndc(view_projection * glm::vec4(point, 1.0F));
+    low = glm::min(low, ndc);
+    high = glm::max(high, ndc);
+  }
+  return low.x <= 1.0F && high.x >= -1.0F && low.y <= 1.0F && high.y >= -1.0F;
+}
+
+void StaticBatches::Draw(const glm::mat4& view_projection, unsigned int shader,
+                         unsigned int SpriteProxy::*texture) {
+  stats_.drawn = 0;
+  stats_.draw_calls = 0;
+  // The vertices are already in world space
+  glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE,
+                     glm::value_ptr(glm::mat4(1.0F)));
+  auto layer_location = glGetUniformLocation(shader, "atlas_layer");
+  for (const auto& [key, chunk] : chunks_) {
+    if (!Visible(chunk, view_projection)) {
+      continue;
+    }
+    stats_.drawn++;
+    glBindVertexArray(chunk.vertex_array);
+    for (const auto& group : chunk.groups) {
+      if (group.layer >= 0) {
+        glUniform1i(layer_location, group.layer);
+        glDrawArrays(GL_TRIANGLES, group.first_vertex, group.vertex_count);
+        stats_.draw_calls++;
+        continue;
+      }
+      glUniform1i(layer_location, -1);
+      // The group's textures, as a sprite of it would have them
+      SpriteProxy textures{};
+      textures.color_texture = group.color_texture;
+      textures.normal_texture = group.normal_texture;
+      if (textures.*texture == SpriteProxy::kMissingTexture) {
+        continue;
+      }
+      // Without a color texture, the pass's own texture's alpha
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_2D,
+                    group.color_texture != SpriteProxy::kMissingTexture
+                        ? group.color_texture
+                        : textures.*texture);
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, textures.*texture);
+      glDrawArrays(GL_TRIANGLES, group.first_vertex, group.vertex_count);
+      stats_.draw_calls++;
+    }
+  }
+}
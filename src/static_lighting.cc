@@ -0,0 +1,232 @@
+#include "static_lighting.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+
+#include "texture.h"
+
+namespace {
+constexpr std::array<char, 4> kMagic = {'V', 'B', 'L', 'M'};
+constexpr std::uint32_t kVersion = 1;
+
+struct FileHeader {
+  std::array<char, 4> magic;
+  std::uint32_t version;
+  std::uint64_t signature;
+  std::int32_t width;
+  std::int32_t height;
+};
+
+void Combine(std::uint64_t& hash, float value) {
+  hash ^= std::bit_cast<std::uint32_t>(value) + 0x9E3779B97F4A7C15ULL +
+          (hash << 6U) + (hash >> 2U);
+}
+
+void Combine(std::uint64_t& hash, std::string_view text) {
+  // FNV-1a, which unlike std::hash is the same on every platform
+  std::uint64_t value = 0xCBF29CE484222325ULL;
+  for (char c : text) {
+    value = (value ^ static_cast<unsigned char>(c)) * 0x100000001B3ULL;
+  }
+  hash ^= value + 0x9E3779B97F4A7C15ULL + (hash << 6U) + (hash >> 2U);
+}
+
+void Combine(std::uint64_t& hash, const glm::mat4& matrix) {
+  for (int column = 0; column < 4; column++) {
+    for (int row = 0; row < 4; row++) {
+      Combine(hash, matrix[column][row]);
+    }
+  }
+}
+
+bool SameBake(const SpriteProxy& a, const SpriteProxy& b) {
+  // The color texture's alpha cuts out the baked normals
+  return a.model == b.model && a.normal_texture == b.normal_texture &&
+         a.color_texture == b.color_texture &&
+         a.is_transparent == b.is_transparent;
+}
+
+bool SameBake(const LightProxy& a, const LightProxy& b) {
+  return a.position == b.position && a.type == b.type && a.color == b.color &&
+         a.intensity == b.intensity && a.falloff == b.falloff &&
+         a.volumetric_intensity == b.volumetric_intensity;
+}
+
+// Compares the baked and the new items in order, calling `cover` on both
+// versions of every item that differs.
+template <typename T, typename Cover>
+void Compare(std::span<const T> baked, std::span<const T> current,
+             const Cover& cover) {
+  for (std::size_t i = 0; i < std::max(baked.size(), current.size()); i++) {
+    if (i < baked.size() && i < current.size() &&
+        SameBake(baked[i], current[i])) {
+      continue;
+    }
+    if (i < baked.size()) {
+      cover(baked[i]);
+    }
+    if (i < current.size()) {
+      cover(current[i]);
+    }
+  }
+}
+}  // namespace
+
+StaticLighting::Region StaticLighting::Update(
+    std::span<const SpriteProxy> sprites, std::span<const LightProxy> lights,
+    const glm::mat4& view_projection, glm::vec3 clear_color, glm::ivec2 size) {
+  incoming_sprites_.clear();
+  std::ranges::copy_if(sprites, std::back_inserter(incoming_sprites_),
+                       &SpriteProxy::is_static);
+  incoming_lights_.clear();
+  std::ranges::copy_if(lights, std::back_inserter(incoming_lights_),
+                       &LightProxy::is_static);
+
+  Region region{.first = size, .last = {0, 0}};
+  if (size != size_ || view_projection != view_projection_ ||
+      clear_color != clear_color_) {
+    region = {.first = {0, 0}, .last = size};
+    size_ = size;
+    view_projection_ = view_projection;
+    clear_color_ = clear_color;
+  } else {
+    auto cover = [&](const auto& item) { Include(region, Cover(item)); };
+    Compare<SpriteProxy>(sprites_, incoming_sprites_, cover);
+    Compare<LightProxy>(lights_, incoming_lights_, cover);
+  }
+  sprites_.swap(incoming_sprites_);
+  lights_.swap(incoming_lights_);
+  return region;
+}
+
+std::uint64_t StaticLighting::Signature() const {
+  std::uint64_t hash = 0;
+  Combine(hash, static_cast<float>(size_.x));
+  Combine(hash, static_cast<float>(size_.y));
+  Combine(hash, view_projection_);
+  for (int c = 0; c < 3; c++) {
+    Combine(hash, clear_color_[c]);
+  }
+  for (const auto& sprite : sprites_) {
+    Combine(hash, sprite.model);
+    Combine(hash, sprite.is_transparent ? 1.0F : 0.0F);
+    // The normals are baked, cut out by the color's alpha
+    Combine(hash, TexturePath(sprite.color_path));
+    Combine(hash, TexturePath(sprite.normal_path));
+  }
+  for (const auto& light : lights_) {
+    Combine(hash, static_cast<float>(light.type));
+    for (int c = 0; c < 3; c++) {
+      Combine(hash, light.position[c]);
+      Combine(hash, light.color[c]);
+    }
+    Combine(hash, light.intensity);
+    Combine(hash, light.falloff);
+    Combine(hash, light.volumetric_intensity);
+  }
+  return hash;
+}
+
+StaticLighting::Region StaticLighting::Cover(const SpriteProxy& sprite) const {
+  auto transform = view_projection_ * sprite.model;
+  glm::vec2 low(INFINITY);
+  glm::vec2 high(-INFINITY);
+  for (float x : {-0.5F, 0.5F}) {
+    for (float y : {-0.5F, 0.5F}) {
+      glm::vec2 ndc(transform * glm::vec4(x, y, 0.0F, 1.0F));
+      auto pixel = (ndc * 0.5F + 0.5F) * glm::vec2(size_);
+      low = glm::min(low, pixel);
+      high = glm::max(high, pixel);
+    }
+  }
+  // A pixel either side, for pixel centres on the edge
+  low = glm::clamp(low - 1.0F, glm::vec2(0.0F), glm::vec2(size_));
+  high = glm::clamp(high + 1.0F, glm::vec2(0.0F), glm::vec2(size_));
+  return {.first = {static_cast<int>(low.x), static_cast<int>(low.y)},
+          .last = {static_cast<int>(std::ceil(high.x)),
+                   static_cast<int>(std::ceil(high.y))}};
+}
+
+StaticLighting::Region StaticLighting::Cover(const LightProxy& light) const {
+  float reach = light.type == 1 ? LightReach(light) : INFINITY;
+  glm::vec2 center(light.position);
+  auto low = glm::clamp((center - reach) * glm::vec2(size_), glm::vec2(0.0F),
+                        glm::vec2(size_));
+  auto high = glm::clamp((center + reach) * glm::vec2(size_), glm::vec2(0.0F),
+                         glm::vec2(size_));
+  return {.first = {static_cast<int>(low.x), static_cast<int>(low.y)},
+          .last = {static_cast<int>(std::ceil(high.x)),
+                   static_cast<int>(std::ceil(high.y))}};
+}
+
+void StaticLighting::Include(Region& region, Region added) const {
+  if (added.Empty()) {
+    return;
+  }
+  region.first = glm::min(region.first, added.first);
+  region.last = glm::max(region.last, added.last);
+}
+
+std::string LightmapPath(std::string_view scene_path) {
+  return std::string(scene_path) + ".lightmap";
+}
+
+LightmapFile LoadLightmap(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + path);
+  }
+  FileHeader header{};
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!file || header.magic != kMagic) {
+    throw std::runtime_error("Not a lightmap: " + path);
+  }
+  if (header.version != kVersion) {
+    throw std::runtime_error("Unsupported lightmap version: " +
+                             std::to_string(header.version));
+  }
+  if (header.width <= 0 || header.height <= 0) {
+    throw std::runtime_error("Lightmap has no pixels: " + path);
+  }
+  LightmapFile lightmap{.signature = header.signature,
+                        .size = {header.width, header.height},
+                        .diffuse = {},
+                        .volumetric = {}};
+  auto floats = static_cast<std::size_t>(header.width) *
+                static_cast<std::size_t>(header.height) * 4;
+  for (auto* plane : {&lightmap.diffuse, &lightmap.volumetric}) {
+    plane->resize(floats);
+    file.read(reinterpret_cast<char*>(plane->data()),
+              static_cast<std::streamsize>(floats * sizeof(float)));
+  }
+  if (!file) {
+    throw std::runtime_error("Lightmap is truncated: " + path);
+  }
+  return lightmap;
+}
+
+void SaveLightmap(const std::string& path, const LightmapFile& lightmap) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + path);
+  }
+  FileHeader header{.magic = kMagic,
+                    .version = kVersion,
+                    .signature = lightmap.signature,
+                    .width = lightmap.size.x,
+                    .height = lightmap.size.y};
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (const auto* plane : {&lightmap.diffuse, &lightmap.volumetric}) {
+    file.write(reinterpret_cast<const char*>(plane->data()),
+               static_cast<std::streamsize>(plane->size() * sizeof(float)));
+  }
+  if (!file) {
+    throw std::runtime_error("Failed to write lightmap: " + path);
+  }
+}
@@ -0,0 +1,92 @@
+#include "texture.h"
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "asset_pack.h"
+#include "helpers.h"
+
+namespace {
+struct TexturePaths {
+  std::mutex mutex;
+  // A deque, so the strings (and views of them) never move
+  std::deque<std::string> paths{std::string()};
+  std::unordered_map<std::string_view, std::uint32_t> handles{{"", 0U}};
+};
+
+TexturePaths& Paths() {
+  static TexturePaths paths;
+  return paths;
+}
+}  // namespace
+
+std::uint32_t InternTexturePath(std::string_view path) {
+  auto& paths = Paths();
+  std::scoped_lock lock(paths.mutex);
+  if (auto it = paths.handles.find(path); it != paths.handles.end()) {
+    return it->second;
+  }
+  auto handle = static_cast<std::uint32_t>(paths.paths.size());
+  paths.handles.emplace(paths.paths.emplace_back(path), handle);
+  return handle;
+}
+
+const std::string& TexturePath(std::uint32_t handle) {
+  auto& paths = Paths();
+  std::scoped_lock lock(paths.mutex);
+  return paths.paths.at(handle);
+}
+
+std::size_t TexturePathBytes() {
+  auto& paths = Paths();
+  std::scoped_lock lock(paths.mutex);
+  std::size_t bytes = 0;
+  for (const auto& path : paths.paths) {
+    bytes += sizeof(std::string) + path.capacity() + 1;
+  }
+  // Roughly a node and a bucket per entry
+  return bytes + paths.handles.size() *
+                     (sizeof(std::pair<std::string_view, std::uint32_t>) +
+                      3 * sizeof(void*));
+}
+
+Texture LoadTexture(std::string_view path) {
+  int w;
+  int h;
+  int nr_channels;
+  auto handle = InternTexturePath(path);
+  auto asset = FindAsset(path);
+  if (!asset) {
+    return {.id = 0U, .path = handle};
+  }
+  auto* data = stbi_load_from_memory(
+      reinterpret_cast<const stbi_uc*>(asset->Data()),
+      static_cast<int>(asset->Size()), &w, &h, &nr_channels, 0);
+  if (data) {
+    auto texture = CreateTextureObject(
+        {.width = w, .height = h, .channels = nr_channels, .data = data});
+    stbi_image_free(data);
+    return {.id = texture, .path = handle};
+  }
+  stbi_image_free(data);
+  return {.id = 0U, .path = handle};
+}
+
+std::size_t TextureFileBytes(const std::string& path) {
+  int w;
+  int h;
+  int nr_channels;
+  auto asset = FindAsset(path);
+  if (!asset ||
+      stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(asset->Data()),
+                            static_cast<int>(asset->Size()), &w, &h,
+                            &nr_channels) == 0) {
+    return 0;
+  }
+  return static_cast<std::size_t>(w) * static_cast<std::size_t>(h) *
+         static_cast<std::size_t>(nr_channels);
+}
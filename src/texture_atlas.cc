@@ -0,0 +1,182 @@
+#include "texture_atlas.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "helpers.h"
+
+namespace {
+// Texels repeated around each packed texture
+constexpr int kBorder = 1;
+
+struct Candidate {
+  std::uint64_t key;
+  unsigned int color_texture;
+  unsigned int normal_texture;
+  glm::ivec2 size;
+};
+
+glm::ivec2 TextureSize(unsigned int texture) {
+  glm::ivec2 size(0);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &size.x);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &size.y);
+  return size;
+}
+
+// Copies the texture, as RGBA8 with its border, to `position` on `layer` of
+// the array.
+void CopyToArray(unsigned int texture, glm::ivec2 size, unsigned int array,
+                 glm::ivec2 position, int layer,
+                 std::vector<std::uint32_t>& pixels,
+                 std::vector<std::uint32_t>& bordered) {
+  pixels.resize(static_cast<std::size_t>(size.x) *
+                static_cast<std::size_t>(size.y));
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  glm::ivec2 outer = size + 2 * kBorder;
+  bordered.resize(static_cast<std::size_t>(outer.x) *
+                  static_cast<std::size_t>(outer.y));
+  for (int y = 0; y < outer.y; y++) {
+    auto row = std::clamp(y - kBorder, 0, size.y - 1);
+    for (int x = 0; x < outer.x; x++) {
+      auto column = std::clamp(x - kBorder, 0, size.x - 1);
+      bordered[static_cast<std::size_t>(y * outer.x + x)] =
+          pixels[static_cast<std::size_t>(row * size.x + column)];
+    }
+  }
+  glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, position.x, position.y, layer,
+                  outer.x, outer.y, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                  bordered.data());
+}
+}  // namespace
+
+TextureAtlas::~TextureAtlas() { Release(); }
+
+bool TextureAtlas::Update(std::span<const SpriteProxy> sprites) {
+  bool added = false;
+  for (const auto& sprite : sprites) {
+    if (pairs_.try_emplace(Key(sprite.color_texture, sprite.normal_texture))
+            .second) {
+      added = true;
+    }
+  }
+  if (added) {
+    Pack();
+  }
+  return added;
+}
+
+const TextureAtlas::Entry* TextureAtlas::Find(
+    unsigned int color_texture, unsigned int normal_texture) const {
+  auto pair = pairs_.find(Key(color_texture, normal_texture));
+  if (pair == pairs_.end() || !pair->second) {
+    return nullptr;
+  }
+  return &*pair->second;
+}
+
+void TextureAtlas::Pack() {
+  Release();
+  std::vector<Candidate> candidates;
+  for (auto& [key, entry] : pairs_) {
+    entry.reset();
+    auto color = static_cast<unsigned int>(key >> 32U);
+    auto normal = static_cast<unsigned int>(key);
+    if (color == 0 || normal == 0 || color == SpriteProxy::kMissingTexture ||
+        normal == SpriteProxy::kMissingTexture) {
+      continue;
+    }
+    auto size = TextureSize(color);
+    if (size != TextureSize(normal) || size.x <= 0 || size.y <= 0 ||
+        glm::any(glm::greaterThan(size + 2 * kBorder, glm::ivec2(kPageSize)))) {
+      continue;
+    }
+    candidates.push_back({.key = key,
+                          .color_texture = color,
+                          .normal_texture = normal,
+                          .size = size});
+  }
+  // Tallest first, onto shelves
+  std::ranges::sort(candidates, [](const Candidate& a, const Candidate& b) {
+    if (a.size.y != b.size.y) {
+      return a.size.y > b.size.y;
+    }
+    if (a.size.x != b.size.x) {
+      return a.size.x > b.size.x;
+    }
+    return a.key < b.key;
+  });
+  std::vector<std::pair<const Candidate*, glm::ivec3>> placed;
+  glm::ivec2 cursor(0);
+  int shelf_height = 0;
+  int page = 0;
+  for (const auto& candidate : candidates) {
+    auto outer = candidate.size + 2 * kBorder;
+    if (cursor.x + outer.x > kPageSize) {
+      cursor = {0, cursor.y + shelf_height};
+      shelf_height = 0;
+    }
+    if (cursor.y + outer.y > kPageSize) {
+      cursor = {0, 0};
+      shelf_height = 0;
+      page++;
+    }
+    if (page >= kMaxPages) {
+      break;
+    }
+    placed.emplace_back(&candidate, glm::ivec3(cursor, page));
+    cursor.x += outer.x;
+    shelf_height = std::max(shelf_height, outer.y);
+  }
+  generation_++;
+  if (placed.empty()) {
+    return;
+  }
+
+  pages_ = placed.back().second.z + 1;
+  auto page_bytes = static_cast<std::size_t>(kPageSize) * kPageSize * 4;
+  for (auto* array : {&color_array_, &normal_array_}) {
+    glGenTextures(1, array);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, *array);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, kPageSize, kPageSize,
+                 pages_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    texture_bytes[*array] = page_bytes * static_cast<std::size_t>(pages_);
+  }
+  std::vector<std::uint32_t> pixels;
+  std::vector<std::uint32_t> bordered;
+  for (const auto& [candidate, place] : placed) {
+    glm::ivec2 position(place);
+    CopyToArray(candidate->color_texture, candidate->size, color_array_,
+                position, place.z, pixels, bordered);
+    CopyToArray(candidate->normal_texture, candidate->size, normal_array_,
+                position, place.z, pixels, bordered);
+    auto page_size = static_cast<float>(kPageSize);
+    pairs_[candidate->key] = Entry{
+        .rect = glm::vec4(glm::vec2(position + kBorder) / page_size,
+                          glm::vec2(candidate->size) / page_size),
+        .layer = place.z};
+  }
+  packed_ = placed.size();
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TextureAtlas::Release() {
+  for (auto* array : {&color_array_, &normal_array_}) {
+    if (*array != 0) {
+      texture_bytes.erase(*array);
+      glDeleteTextures(1, array);
+      *array = 0;
+    }
+  }
+  packed_ = 0;
+  pages_ = 0;
+}
@@ -7,12 +7,20 @@
 #include <pugixml.hpp>
 #include <iostream>
 
+#include "asset_pack.h"
+
 namespace {
   std::vector<std::pair<std::string, std::string>> tutorial_text;
 
 std::vector<std::pair<std::string, std::string>> LoadTutorial() {
   pugi::xml_document doc;
-  pugi::xml_parse_result result = doc.load_file("tutorial.xml");
+  // The saved copy wins over the packed one
+  auto asset = FindAsset("tutorial.xml", true);
+  if (!asset) {
+    std::cerr << "Failed to load tutorial: tutorial.xml not found" << std::endl;
+    return {};
+  }
+  pugi::xml_parse_result result = doc.load_buffer(asset->Data(), asset->Size());
   if (!result) {
     std::cerr << "Failed to load tutorial: " << result.description() << std::endl;
     return {};
@@ -48,7 +56,8 @@ bool show_editor = false;
 }
 
 
-void TutorialWindow(bool& show, Scene& scene) {
+void TutorialWindow(bool& show,
+                    const std::function<void(std::string_view)>& load_scene) {
   if (!show) {
     return;
   }
@@ -94,7 +103,7 @@ void TutorialWindow(bool& show, Scene& scene) {
       ImGui::SeparatorText("Test Scene!");
       ImGui::TextWrapped("Or, try a test scene! Click the button below to load it.");
       if (ImGui::Button("Load Test Scene")) {
-        scene = LoadScene("tutorial_scene.xml");
+        load_scene("tutorial_scene.xml");
       }
       ImGui::SeparatorText("Tasks:");
       ImGui::TextWrapped(
@@ -0,0 +1,275 @@
+// Checks that edits recorded in a scene journal replay to the scene they were
+// made on, and that the journal recovers from what a crash or a save can leave
+// behind: a truncated last entry, a journal whose base file was replaced, and
+// compaction into a newly saved scene, or a reload that replaces unsaved
+// edits. Edits made while the scene streams in must follow its objects back
+// into file order.
+//
+//   vibrant_journal_test
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "journal.h"
+#include "scene.h"
+#include "scene_compare.h"
+#include "scene_generator.h"
+
+namespace {
+namespace fs = std::filesystem;
+
+void Expect(bool condition, const std::string& message) {
+  if (!condition) {
+    throw std::runtime_error(message);
+  }
+}
+
+// LoadScene replays the scene's journal
+void ExpectReplay(const std::string& path, const Scene& expected,
+                  const std::string& what) {
+  auto difference = CompareScenes(expected, LoadScene(path, false));
+  Expect(difference.empty(), std::format("{}: {}", what, difference));
+}
+
+// Journals tell their base file by size and modification time, and saves in
+// a test follow each other within one file system timestamp tick. Dated a
+// second after the file it replaces, as a save made by hand would be.
+void SaveLater(const Scene& scene, const std::string& path) {
+  auto previous = fs::last_write_time(path);
+  SaveScene(scene, path);
+  fs::last_write_time(path, previous + std::chrono::seconds(1));
+}
+
+Scene BaseScene() {
+  auto scene = GenerateScene(100);
+  auto lamp = std::make_shared<AttributeTemplate>(AttributeTemplate{
+      .name = "Lamp",
+      .attributes = {{"light.type", 1}, {"light.intensity", 0.5F}}});
+  scene.prefabs = {lamp};
+  for (std::size_t i = 0; i < scene.objects.size(); i += 8) {
+    scene.objects[i]->prefab = lamp;
+  }
+  return scene;
+}
+
+// Makes one edit of every kind to `scene`, recording each in `journal` the way
+// the editor does.
+void EditScene(Scene& scene, Journal& journal) {
+  auto& renamed = Detach(scene.objects[3]);
+  renamed.name = "renamed";
+  journal.SetName(3, renamed.name);
+
+  auto& edited = Detach(scene.objects[5]);
+  edited.attributes[0].second = glm::vec2(-1.0F, 2.0F);
+  journal.SetAttribute(5, 0, edited.attributes[0].first,
+                       edited.attributes[0].second);
+  edited.attributes.emplace_back("extra", 7);
+  journal.SetAttribute(5, edited.attributes.size() - 1, "extra", 7);
+  edited.attributes.erase(edited.attributes.begin() + 1);
+  journal.RemoveAttribute(5, 1);
+  edited.tags.push_back("edited");
+  journal.SetTag(5, edited.tags.size() - 1, "edited");
+  edited.tags.erase(edited.tags.begin());
+  journal.RemoveTag(5, 0);
+
+  auto added = std::make_shared<Object>(Object{
+      .name = "added",
+      .tags = {"static"},
+      .attributes = {{"tint", glm::vec4(0.1F, 0.2F, 0.3F, 0.4F)}},
+      .prefab = scene.prefabs[0]});
+  scene.objects.insert(scene.objects.begin() + 2, added);
+  journal.AddObject(2, *added);
+  journal.SetPrefab(2, 0);
+  scene.objects.erase(scene.objects.begin() + 10);
+  journal.RemoveObject(10);
+  Detach(scene.objects[16]).prefab = nullptr;
+  journal.SetPrefab(16, std::nullopt);
+
+  auto tile = std::make_shared<AttributeTemplate>(AttributeTemplate{
+      .name = "Tile", .attributes = {{"animation.frames", 4}}});
+  scene.prefabs.push_back(tile);
+  journal.AddPrefab(1, *tile);
+  auto& lamp = DetachPrefab(scene, 0);
+  lamp.attributes[1].second = 2.0F;
+  journal.SetPrefabAttribute(0, 1, lamp.attributes[1].first, 2.0F);
+  lamp.attributes.erase(lamp.attributes.begin());
+  journal.RemovePrefabAttribute(0, 0);
+  journal.Flush();
+}
+
+void CheckReplay(const std::string& path) {
+  SaveScene(BaseScene(), path);
+  auto expected = LoadScene(path, false);
+  Journal journal(path);
+  EditScene(expected, journal);
+  ExpectReplay(path, expected, "replay");
+}
+
+// A crash mid-append leaves part of an entry, which must be cut off before
+// anything is appended after it.
+void CheckTruncatedEntry(const std::string& path) {
+  SaveScene(BaseScene(), path);
+  auto expected = LoadScene(path, false);
+  auto journal_path = JournalPath(path);
+  {
+    Journal journal(path);
+    EditScene(expected, journal);
+    journal.SetName(0, "lost in the crash");
+    journal.Flush();
+  }
+  auto size = fs::file_size(journal_path);
+  fs::resize_file(journal_path, size - 3);
+  ExpectReplay(path, expected, "replay up to the truncated entry");
+  Expect(fs::exists(journal_path + ".bad"),
+         "truncated journal not kept as .bad");
+  Expect(fs::file_size(journal_path) < size - 3,
+         "truncated entry not cut off");
+
+  Journal journal(path);
+  Detach(expected.objects[1]).name = "after the crash";
+  journal.SetName(1, "after the crash");
+  journal.Flush();
+  ExpectReplay(path, expected, "edit appended after the truncated entry");
+}
+
+// A journal left behind when its base file was replaced has already been
+// folded into it, so new edits must start a journal of their own.
+void CheckStaleJournal(const std::string& path) {
+  SaveScene(BaseScene(), path);
+  auto expected = LoadScene(path, false);
+  {
+    Journal journal(path);
+    EditScene(expected, journal);
+  }
+  SaveLater(expected, path);
+  ExpectReplay(path, expected, "stale journal replayed");
+
+  Journal journal(path);
+  Detach(expected.objects[0]).name = "after the save";
+  journal.SetName(0, "after the save");
+  journal.Flush();
+  ExpectReplay(path, expected, "edit appended to a stale journal");
+}
+
+// Saving folds the journal into the scene; only edits made while the save
+// runs are left in it.
+void CheckCompaction(const std::string& path) {
+  SaveScene(BaseScene(), path);
+  auto expected = LoadScene(path, false);
+  Journal journal(path);
+  EditScene(expected, journal);
+
+  auto snapshot = expected;
+  journal.BeginCompaction(path);
+  Detach(expected.objects[4]).name = "during the save";
+  journal.SetName(4, "during the save");
+  SaveLater(snapshot, path);
+  journal.EndCompaction(true);
+  ExpectReplay(path, expected, "edit made during compaction");
+
+  journal.BeginCompaction(path);
+  SaveLater(expected, path);
+  journal.EndCompaction(true);
+  Expect(journal.Size() == 0, "journal not empty after compaction");
+  Expect(!fs::exists(JournalPath(path)),
+         "journal file left behind by compaction");
+  ExpectReplay(path, expected, "compacted scene");
+}
+
+// A reload of a file another tool changed replaces the unsaved edits, which
+// are kept aside instead of being replayed onto it.
+void CheckSetAside(const std::string& path) {
+  SaveScene(BaseScene(), path);
+  auto expected = LoadScene(path, false);
+  Journal journal(path);
+  auto edited = expected;
+  EditScene(edited, journal);
+  journal.SetName(0, "not flushed");
+  journal.SetAside();
+  Expect(journal.Size() == 0, "journal not empty after setting it aside");
+  Expect(!fs::exists(JournalPath(path)), "journal file left in place");
+  Expect(fs::exists(JournalPath(path) + ".bad"),
+         "journal not kept as .bad");
+  ExpectReplay(path, expected, "journal set aside");
+}
+
+// The stream hands out objects nearest first, with the journal left by an
+// earlier session already replayed, and edits made meanwhile address them in
+// that order.
+void CheckStream(const std::string& path) {
+  SaveScene(BaseScene(), path);
+  {
+    auto previous = LoadScene(path, false);
+    Journal journal(path);
+    EditScene(previous, journal);
+  }
+  std::vector<SceneChunk> chunks;
+  ReadSceneChunks(path, glm::vec2(20.0F, 20.0F), 16, [&](SceneChunk&& chunk) {
+    chunks.push_back(std::move(chunk));
+    return true;
+  });
+
+  Scene scene;
+  Journal journal;
+  journal.BeginStream();
+  std::vector<std::size_t> file_order;
+  for (auto& chunk : chunks) {
+    std::ranges::move(chunk.prefabs, std::back_inserter(scene.prefabs));
+    std::ranges::move(chunk.objects, std::back_inserter(scene.objects));
+    file_order.insert(file_order.end(), chunk.indices.begin(),
+                      chunk.indices.end());
+    if (&chunk == &chunks.back()) {
+      break;
+    }
+    auto middle = scene.objects.size() / 2;
+    Detach(scene.objects[middle]).name += " while streaming";
+    journal.SetName(middle, scene.objects[middle]->name);
+    scene.objects.erase(scene.objects.begin() + 1);
+    journal.RemoveObject(1);
+    auto added = std::make_shared<Object>();
+    added->name = "added while streaming";
+    scene.objects.push_back(added);
+    journal.AddObject(scene.objects.size() - 1, *added);
+  }
+  ReorderObjects(scene.objects, journal.EndStream(path, std::move(file_order)));
+  Detach(scene.objects[0]).name = "after the stream";
+  journal.SetName(0, "after the stream");
+  journal.Flush();
+  ExpectReplay(path, scene, "edits made while streaming");
+}
+}  // namespace
+
+int main() {
+  auto directory = fs::temp_directory_path() / "vibrant_journal_test";
+  int status = EXIT_SUCCESS;
+  try {
+    std::pair<const char*, void (*)(const std::string&)> checks[] = {
+        {"replay", CheckReplay},
+        {"truncated entry", CheckTruncatedEntry},
+        {"stale journal", CheckStaleJournal},
+        {"compaction", CheckCompaction},
+        {"set aside", CheckSetAside},
+        {"stream", CheckStream}};
+    for (const auto& [name, check] : checks) {
+      // A fresh directory each time, so no journal carries over
+      fs::remove_all(directory);
+      fs::create_directories(directory);
+      check((directory / "scene.vbscene").string());
+      std::print("{} passed\n", name);
+    }
+  } catch (const std::exception& e) {
+    std::print(stderr, "{}\n", e.what());
+    status = EXIT_FAILURE;
+  }
+  fs::remove_all(directory);
+  return status;
+}
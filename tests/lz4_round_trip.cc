@@ -0,0 +1,125 @@
+// Checks the asset pack's LZ4 block codec: random, highly repetitive and tiny
+// inputs must decompress to what was compressed, and truncated or corrupt
+// blocks must throw rather than read or write out of bounds.
+//
+//   vibrant_lz4_test
+#include <cstddef>
+#include <cstdlib>
+#include <format>
+#include <print>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "asset_pack.h"
+
+namespace {
+using Bytes = std::vector<std::byte>;
+
+void Expect(bool condition, const std::string& message) {
+  if (!condition) {
+    throw std::runtime_error(message);
+  }
+}
+
+bool Throws(std::span<const std::byte> block, std::size_t size) {
+  Bytes target(size);
+  try {
+    Lz4Decompress(block, target);
+  } catch (const std::runtime_error&) {
+    return true;
+  }
+  return false;
+}
+
+// Returns the compressed size
+std::size_t CheckRoundTrip(const Bytes& source, const std::string& what) {
+  auto block = Lz4Compress(source);
+  Bytes target(source.size());
+  Lz4Decompress(block, target);
+  Expect(target == source, std::format("{} did not round trip", what));
+  return block.size();
+}
+
+Bytes Random(std::size_t size, std::mt19937& random) {
+  Bytes bytes(size);
+  for (auto& byte : bytes) {
+    byte = static_cast<std::byte>(random());
+  }
+  return bytes;
+}
+
+void CheckRandom() {
+  std::mt19937 random(1);
+  for (std::size_t size : {0, 1, 2, 3, 4, 5, 11, 12, 13, 16, 255, 4096,
+                           100000}) {
+    CheckRoundTrip(Random(size, random), std::format("{} random bytes", size));
+  }
+}
+
+void CheckRepetitive() {
+  std::mt19937 random(2);
+  // Long runs need matches that overlap their own output and lengths that
+  // continue past the token's nibble
+  for (std::size_t size : {4, 12, 13, 20, 270, 70000}) {
+    Bytes zeros(size, std::byte{0});
+    auto stored = CheckRoundTrip(zeros, std::format("{} zeros", size));
+    Expect(size < 1000 || stored < size / 50,
+           std::format("{} zeros compressed to {} bytes", size, stored));
+  }
+  Bytes pattern;
+  for (std::size_t i = 0; i < 50000; i++) {
+    pattern.push_back(static_cast<std::byte>("abc"[i % 3]));
+  }
+  CheckRoundTrip(pattern, "a repeated pattern");
+  // The second copy is past the largest offset a match can reach
+  auto block = Random(40000, random);
+  Bytes far = block;
+  far.resize(block.size() + 30000, std::byte{7});
+  far.insert(far.end(), block.begin(), block.end());
+  CheckRoundTrip(far, "data repeated beyond the offset limit");
+}
+
+void CheckCorrupt() {
+  std::mt19937 random(3);
+  Bytes source(3000, std::byte{1});
+  auto noise = Random(3000, random);
+  source.insert(source.end(), noise.begin(), noise.end());
+  auto block = Lz4Compress(source);
+  for (std::size_t size = 0; size < block.size(); size++) {
+    Expect(Throws(std::span(block).first(size), source.size()),
+           std::format("block truncated to {} bytes decompressed", size));
+  }
+  Expect(Throws(block, source.size() - 1), "block decompressed short");
+  Expect(Throws(block, source.size() + 1), "block decompressed long");
+
+  // One literal, then a match of four bytes at the given offset
+  auto match = [](std::byte offset) {
+    return Bytes{std::byte{0x10}, std::byte{'a'}, offset, std::byte{0}};
+  };
+  Expect(!Throws(match(std::byte{1}), 5), "valid hand-written block rejected");
+  Expect(Throws(match(std::byte{0}), 5), "zero offset accepted");
+  Expect(Throws(match(std::byte{2}), 5), "offset before the output accepted");
+  Expect(Throws(match(std::byte{1}), 4), "match past the output accepted");
+  // Fifteen literals whose length continues past the end of the block
+  Expect(Throws(Bytes{std::byte{0xF0}}, 15), "truncated length accepted");
+  // Literals that run past the end of the block
+  Expect(Throws(Bytes{std::byte{0x30}, std::byte{'a'}}, 3),
+         "truncated literals accepted");
+}
+}  // namespace
+
+int main() {
+  try {
+    CheckRandom();
+    CheckRepetitive();
+    CheckCorrupt();
+  } catch (const std::exception& e) {
+    std::print(stderr, "{}\n", e.what());
+    return EXIT_FAILURE;
+  }
+  std::print("LZ4 blocks round trip\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include "scene_compare.h"
+
+#include <format>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "texture.h"
+
+namespace {
+using Attributes = std::vector<std::pair<std::string, AttributeData>>;
+
+// Texture ids are not compared: conversions do not load textures.
+bool SameValue(const AttributeData& a, const AttributeData& b) {
+  if (a.index() != b.index()) {
+    return false;
+  }
+  return std::visit(
+      [&](const auto& value) {
+        using T = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<T, Texture>) {
+          return value.Path() == std::get<Texture>(b).Path();
+        } else {
+          return value == std::get<T>(b);
+        }
+      },
+      a);
+}
+
+// Empty if they are the same, otherwise what differs
+std::string CompareAttributes(const Attributes& a, const Attributes& b) {
+  if (a.size() != b.size()) {
+    return std::format("{} attributes instead of {}", b.size(), a.size());
+  }
+  for (std::size_t i = 0; i < a.size(); i++) {
+    if (a[i].first != b[i].first) {
+      return std::format("attribute {} is {} instead of {}", i, b[i].first,
+                         a[i].first);
+    }
+    if (!SameValue(a[i].second, b[i].second)) {
+      return std::format("attribute {} has another value", a[i].first);
+    }
+  }
+  return {};
+}
+
+}  // namespace
+
+std::string CompareScenes(const Scene& a, const Scene& b) {
+  if (a.prefabs.size() != b.prefabs.size()) {
+    return std::format("{} prefabs instead of {}", b.prefabs.size(),
+                       a.prefabs.size());
+  }
+  for (std::size_t i = 0; i < a.prefabs.size(); i++) {
+    if (a.prefabs[i]->name != b.prefabs[i]->name) {
+      return std::format("prefab {} is {} instead of {}", i,
+                         b.prefabs[i]->name, a.prefabs[i]->name);
+    }
+    auto difference =
+        CompareAttributes(a.prefabs[i]->attributes, b.prefabs[i]->attributes);
+    if (!difference.empty()) {
+      return std::format("prefab {}: {}", a.prefabs[i]->name, difference);
+    }
+  }
+  if (a.objects.size() != b.objects.size()) {
+    return std::format("{} objects instead of {}", b.objects.size(),
+                       a.objects.size());
+  }
+  for (std::size_t i = 0; i < a.objects.size(); i++) {
+    const auto& expected = *a.objects[i];
+    const auto& actual = *b.objects[i];
+    std::string difference;
+    if (expected.name != actual.name) {
+      difference = std::format("named {} instead of {}", actual.name,
+                               expected.name);
+    } else if (expected.tags != actual.tags) {
+      difference = "has other tags";
+    } else if (!expected.prefab != !actual.prefab ||
+               (expected.prefab &&
+                expected.prefab->name != actual.prefab->name)) {
+      difference = "has another prefab";
+    } else {
+      difference = CompareAttributes(expected.attributes, actual.attributes);
+    }
+    if (!difference.empty()) {
+      return std::format("object {}: {}", i, difference);
+    }
+  }
+  return {};
+}
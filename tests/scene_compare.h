@@ -0,0 +1,12 @@
+#ifndef SCENE_COMPARE_H
+#define SCENE_COMPARE_H
+#include <string>
+
+#include "scene.h"
+
+// Empty if `b` has the same objects, attributes, tags and prefabs as `a`,
+// otherwise a description of the first difference. Textures are compared by
+// path, as tests do not load them.
+std::string CompareScenes(const Scene& a, const Scene& b);
+
+#endif  // SCENE_COMPARE_H
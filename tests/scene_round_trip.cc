@@ -0,0 +1,91 @@
+// Checks that scenes survive conversion between the scene formats: a scene
+// read from XML, converted to .vbscene and back to XML must load with the
+// same objects, attributes, tags and prefabs at every step. Run on the given
+// XML scenes, and on a generated one with prefabs and every attribute type.
+//
+//   vibrant_scene_test [scene.xml]...
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "scene.h"
+#include "scene_compare.h"
+#include "scene_generator.h"
+#include "texture.h"
+
+namespace {
+// Prefabs, overrides and every attribute type on top of the benchmark scene
+Scene SampleScene() {
+  auto scene = GenerateScene(1000);
+  auto lamp = std::make_shared<AttributeTemplate>(AttributeTemplate{
+      .name = "Lamp",
+      .attributes = {{"light.type", 1},
+                     {"light.intensity", 0.1F},
+                     {"light.color", glm::vec3(1.0F, 0.5F, 0.25F)}}});
+  auto tile = std::make_shared<AttributeTemplate>(AttributeTemplate{
+      .name = "Tile",
+      .attributes = {
+          {"texture.color",
+           Texture{.id = 0, .path = InternTexturePath("assets/color.png")}},
+          {"animation.grid", glm::vec2(4.0F, 2.0F)}}});
+  scene.prefabs = {lamp, tile};
+  for (std::size_t i = 0; i < scene.objects.size(); i += 10) {
+    auto& object = *scene.objects[i];
+    object.prefab = i % 20 == 0 ? lamp : tile;
+    if (i % 30 == 0) {
+      object.attributes.emplace_back("light.intensity", 1.0F / 3.0F);
+    }
+  }
+  scene.objects.push_back(std::make_shared<Object>(Object{
+      .name = "",
+      .tags = {"static", "transparent"},
+      .attributes = {{"tint", glm::vec4(0.1F, 0.2F, 0.3F, 1e-7F)},
+                     {"count", -42}},
+      .prefab = nullptr}));
+  return scene;
+}
+
+// XML to .vbscene and back, compared with the scene first read
+void CheckRoundTrip(const std::string& xml,
+                    const std::filesystem::path& directory) {
+  auto expected = LoadScene(xml, false);
+  auto binary = (directory / "round_trip.vbscene").string();
+  auto back = (directory / "round_trip.xml").string();
+  ConvertScene(xml, binary);
+  auto difference = CompareScenes(expected, LoadScene(binary, false));
+  if (difference.empty()) {
+    ConvertScene(binary, back);
+    difference = CompareScenes(expected, LoadScene(back, false));
+  }
+  if (!difference.empty()) {
+    throw std::runtime_error(
+        std::format("{} did not round trip: {}", xml, difference));
+  }
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  auto directory = std::filesystem::temp_directory_path() / "vibrant_test";
+  std::filesystem::create_directories(directory);
+  int status = EXIT_SUCCESS;
+  try {
+    auto sample = (directory / "sample.xml").string();
+    SaveScene(SampleScene(), sample);
+    std::vector<std::string> scenes = {sample};
+    scenes.insert(scenes.end(), argv + 1, argv + argc);
+    for (const auto& scene : scenes) {
+      CheckRoundTrip(scene, directory);
+      std::print("{} round trips\n", scene);
+    }
+  } catch (const std::exception& e) {
+    std::print(stderr, "{}\n", e.what());
+    status = EXIT_FAILURE;
+  }
+  std::filesystem::remove_all(directory);
+  return status;
+}
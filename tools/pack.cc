@@ -0,0 +1,61 @@
+// Packs the editor's assets into one file for installs, read in place by
+// MountAssetPack (see asset_pack.h). Directories are packed recursively;
+// entries are named by their paths as given, so run it from the directory
+// the editor runs in.
+//
+//   vibrant_pack [--lz4] <output.vbpack> <file or directory>...
+//
+// With --lz4, entries that shrink are stored LZ4-compressed; they then cost a
+// decompression instead of being read straight from the mapping.
+#include <cstdlib>
+#include <filesystem>
+#include <print>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "asset_pack.h"
+
+namespace {
+constexpr std::string_view kUsage =
+    "Usage: vibrant_pack [--lz4] <output.vbpack> <file or directory>...";
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  bool compress = false;
+  std::vector<std::string_view> arguments;
+  for (int i = 1; i < argc; i++) {
+    if (std::string_view(argv[i]) == "--lz4") {
+      compress = true;
+    } else {
+      arguments.emplace_back(argv[i]);
+    }
+  }
+  if (arguments.size() < 2) {
+    std::print(stderr, "{}\n", kUsage);
+    return EXIT_FAILURE;
+  }
+  try {
+    std::vector<std::string> paths;
+    for (auto input : std::span(arguments).subspan(1)) {
+      if (!std::filesystem::is_directory(input)) {
+        paths.emplace_back(input);
+        continue;
+      }
+      for (const auto& entry :
+           std::filesystem::recursive_directory_iterator(input)) {
+        if (entry.is_regular_file()) {
+          paths.push_back(entry.path().generic_string());
+        }
+      }
+    }
+    SaveAssetPack(arguments.front(), paths, compress);
+    std::print("Packed {} files into {}\n", paths.size(), arguments.front());
+  } catch (const std::exception& e) {
+    std::print(stderr, "Packing failed: {}\n", e.what());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}